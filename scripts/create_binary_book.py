@@ -5,8 +5,33 @@ import struct
 从 opening_book.json 文件生成 opening_book.bin 文件
 opening_book.json 文件从以下 git 项目中获取:
 https://github.com/quantumknight/minixiangqi_c
+
+opening_book.bin 格式 (版本 1, 小端序), 与 src/opening_book.h 一致:
+  头部:   magic (8 字节), version, position_count, move_count, reserved (均为 uint32)
+  局面表: 按 hash_key 升序排列的 (hash_key uint64, first_move uint32, move_count uint16, reserved uint16)
+  着法表: 每个局面的着法连续存放 (from_sq uint8, to_sq uint8, weight uint16)
 '''
 
+BOOK_MAGIC = b'XQBOOK\0\0'
+BOOK_VERSION = 1
+MAX_WEIGHT = 0xFFFF
+MAX_MOVES_PER_POSITION = 0xFFFF
+
+
+def read_book(book_data):
+    # hash_key -> {(from_sq, to_sq): weight}; repeated moves add up their weights
+    book = {}
+    for hash_key_str, moves in book_data.items():
+        hash_key = int(hash_key_str) & 0xFFFFFFFFFFFFFFFF
+        position = book.setdefault(hash_key, {})
+        for move in moves:
+            # Move is in the format [[r1, c1], [r2, c2]], optionally followed by a weight
+            from_sq = move[0][0] * 9 + move[0][1]
+            to_sq = move[1][0] * 9 + move[1][1]
+            weight = int(move[2]) if len(move) > 2 else 1
+            position[(from_sq, to_sq)] = position.get((from_sq, to_sq), 0) + weight
+    return book
+
 
 def create_binary_opening_book(json_path, bin_path):
     try:
@@ -16,19 +41,24 @@ def create_binary_opening_book(json_path, bin_path):
         print(f"Error: {json_path} not found.")
         return
 
+    book = read_book(book_data)
+    positions = []
+    moves = []
+    for hash_key in sorted(book):
+        position_moves = sorted(book[hash_key].items(), key=lambda item: -item[1])[:MAX_MOVES_PER_POSITION]
+        positions.append((hash_key, len(moves), len(position_moves)))
+        for (from_sq, to_sq), weight in position_moves:
+            moves.append((from_sq, to_sq, max(1, min(weight, MAX_WEIGHT))))
+
     with open(bin_path, 'wb') as f:
-        for hash_key_str, moves in book_data.items():
-            hash_key = int(hash_key_str)
-            for move in moves:
-                # Assuming move is in the format [[r1, c1], [r2, c2]]
-                from_sq = move[0][0] * 9 + move[0][1]
-                to_sq = move[1][0] * 9 + move[1][1]
-                # Pack hash_key (uint64), from_sq (int), and to_sq (int)
-                # Using 'Qii' for unsigned long long, int, int
-                packed_data = struct.pack('Qii', hash_key, from_sq, to_sq)
-                f.write(packed_data)
-
-    print(f"Successfully created binary opening book at {bin_path}")
+        f.write(struct.pack('<8sIIII', BOOK_MAGIC, BOOK_VERSION, len(positions), len(moves), 0))
+        for hash_key, first_move, move_count in positions:
+            f.write(struct.pack('<QIHH', hash_key, first_move, move_count, 0))
+        for from_sq, to_sq, weight in moves:
+            f.write(struct.pack('<BBH', from_sq, to_sq, weight))
+
+    print(f"Successfully created binary opening book at {bin_path}: "
+          f"{len(positions)} positions, {len(moves)} moves")
 
 
 if __name__ == "__main__":
@@ -0,0 +1,196 @@
+import array
+import ctypes
+import os
+
+'''
+libxiangqi.so 的 ctypes 封装 (C API 见 src/xiangqi_api.h, 用 make lib 构建)
+
+批量函数直接写入调用方提供的缓冲区 (numpy 数组、bytearray 等任何可写的
+C 连续缓冲区), 不做逐局面的复制和序列化; 未提供缓冲区时, 若安装了 numpy
+则返回 numpy 数组, 否则返回 bytearray / array.array.
+
+示例:
+    from scripts.xiangqi_lib import Xiangqi
+    xq = Xiangqi()
+    board = xq.board()
+    board.play('h2e2')
+    masks, valid = xq.legal_masks([board.fen()])
+'''
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+API_VERSION = 1
+SQUARES = 90
+MOVE_SPACE = SQUARES * SQUARES
+PLANES = 14
+NO_MOVE = -1
+
+DEFAULT_LIBRARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'bin', 'libxiangqi.so')
+
+
+def _declare(lib):
+    c_board = ctypes.c_void_p
+    c_fens = ctypes.POINTER(ctypes.c_char_p)
+    signatures = {
+        'xq_api_version': (ctypes.c_int, []),
+        'xq_init': (None, []),
+        'xq_board_new': (c_board, [ctypes.c_char_p]),
+        'xq_board_clone': (c_board, [c_board]),
+        'xq_board_free': (None, [c_board]),
+        'xq_board_set_fen': (ctypes.c_int, [c_board, ctypes.c_char_p]),
+        'xq_board_get_fen': (ctypes.c_int, [c_board, ctypes.c_char_p, ctypes.c_size_t]),
+        'xq_board_side_to_move': (ctypes.c_int, [c_board]),
+        'xq_board_hash': (ctypes.c_uint64, [c_board]),
+        'xq_board_piece_at': (ctypes.c_int, [c_board, ctypes.c_int]),
+        'xq_board_in_check': (ctypes.c_int, [c_board]),
+        'xq_legal_moves': (ctypes.c_int, [c_board, ctypes.POINTER(ctypes.c_int), ctypes.c_int]),
+        'xq_make_move': (ctypes.c_int, [c_board, ctypes.c_int]),
+        'xq_parse_move': (ctypes.c_int, [ctypes.c_char_p]),
+        'xq_move_to_string': (None, [ctypes.c_int, ctypes.c_char_p]),
+        'xq_evaluate': (ctypes.c_int, [c_board]),
+        'xq_search': (ctypes.c_int, [c_board, ctypes.c_int, ctypes.c_long, ctypes.c_uint64,
+                                     ctypes.POINTER(ctypes.c_int)]),
+        'xq_new_game': (None, []),
+        'xq_batch_legal_masks': (ctypes.c_size_t, [c_fens, ctypes.c_size_t, ctypes.c_void_p]),
+        'xq_batch_evaluate': (ctypes.c_size_t, [c_fens, ctypes.c_size_t, ctypes.c_void_p]),
+        'xq_batch_planes': (ctypes.c_size_t, [c_fens, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+
+def _buffer_address(buffer, nbytes):
+    # Any writable C-contiguous buffer of at least nbytes, passed without copying
+    view = memoryview(buffer)
+    if view.readonly or not view.c_contiguous or view.nbytes < nbytes:
+        raise ValueError(f'need a writable C-contiguous buffer of {nbytes} bytes')
+    if numpy is not None and isinstance(buffer, numpy.ndarray):
+        return buffer.ctypes.data
+    return ctypes.addressof(ctypes.c_char.from_buffer(view.cast('B')))
+
+
+def _new_buffer(shape, typecode, numpy_type):
+    count = 1
+    for n in shape:
+        count *= n
+    if numpy is not None:
+        return numpy.zeros(shape, dtype=numpy_type)
+    if typecode == 'B':
+        return bytearray(count)
+    return array.array(typecode, bytes(count * array.array(typecode).itemsize))
+
+
+class Board:
+    def __init__(self, lib, handle):
+        self._lib = lib
+        self._handle = handle
+
+    def __del__(self):
+        if self._handle:
+            self._lib.xq_board_free(self._handle)
+            self._handle = None
+
+    def copy(self):
+        handle = self._lib.xq_board_clone(self._handle)
+        if not handle:
+            raise MemoryError('cannot copy the board')
+        return Board(self._lib, handle)
+
+    def fen(self):
+        buffer = ctypes.create_string_buffer(128)
+        self._lib.xq_board_get_fen(self._handle, buffer, len(buffer))
+        return buffer.value.decode()
+
+    def set_fen(self, fen):
+        if self._lib.xq_board_set_fen(self._handle, fen.encode()) != 0:
+            raise ValueError(f'invalid FEN: {fen}')
+
+    def side_to_move(self):
+        return self._lib.xq_board_side_to_move(self._handle)
+
+    def hash(self):
+        return self._lib.xq_board_hash(self._handle)
+
+    def piece_at(self, sq):
+        return self._lib.xq_board_piece_at(self._handle, sq)
+
+    def in_check(self):
+        return bool(self._lib.xq_board_in_check(self._handle))
+
+    def legal_moves(self):
+        moves = (ctypes.c_int * 256)()
+        count = self._lib.xq_legal_moves(self._handle, moves, len(moves))
+        return list(moves[:min(count, len(moves))])
+
+    def play(self, move):
+        # A move code (from_sq * 90 + to_sq) or a coordinate move such as 'h2e2'
+        code = self._lib.xq_parse_move(move.encode()) if isinstance(move, str) else move
+        if code == NO_MOVE or self._lib.xq_make_move(self._handle, code) != 0:
+            raise ValueError(f'illegal move: {move}')
+
+    def evaluate(self):
+        return self._lib.xq_evaluate(self._handle)
+
+    def search(self, depth=0, movetime_ms=0, nodes=0):
+        # Returns (move code or NO_MOVE, score for the side to move)
+        score = ctypes.c_int(0)
+        move = self._lib.xq_search(self._handle, depth, movetime_ms, nodes, ctypes.byref(score))
+        return move, score.value
+
+
+class Xiangqi:
+    def __init__(self, path=DEFAULT_LIBRARY):
+        self._lib = ctypes.CDLL(path)
+        _declare(self._lib)
+        version = self._lib.xq_api_version()
+        if version != API_VERSION:
+            raise RuntimeError(f'{path} has API version {version}, expected {API_VERSION}')
+        self._lib.xq_init()
+
+    def board(self, fen=None):
+        handle = self._lib.xq_board_new(fen.encode() if fen else None)
+        if not handle:
+            raise ValueError(f'invalid FEN: {fen}')
+        return Board(self._lib, handle)
+
+    def move_to_string(self, move):
+        text = ctypes.create_string_buffer(5)
+        self._lib.xq_move_to_string(move, text)
+        return text.value.decode()
+
+    def new_game(self):
+        self._lib.xq_new_game()
+
+    @staticmethod
+    def _fen_array(fens):
+        return (ctypes.c_char_p * len(fens))(*[fen.encode() for fen in fens])
+
+    # Batches return (buffer, number of valid FENs); rows of invalid FENs are zero
+
+    def legal_masks(self, fens, out=None):
+        # count x 8100 bytes, 1 for legal moves (index from_sq * 90 + to_sq)
+        out = _new_buffer((len(fens), MOVE_SPACE), 'B', 'uint8') if out is None else out
+        address = _buffer_address(out, len(fens) * MOVE_SPACE)
+        valid = self._lib.xq_batch_legal_masks(self._fen_array(fens), len(fens), address)
+        return out, valid
+
+    def evaluate(self, fens, out=None):
+        # count int32 static evaluations for the side to move
+        out = _new_buffer((len(fens),), 'i', 'int32') if out is None else out
+        address = _buffer_address(out, len(fens) * 4)
+        valid = self._lib.xq_batch_evaluate(self._fen_array(fens), len(fens), address)
+        return out, valid
+
+    def planes(self, fens, out=None, sides=None):
+        # count x 14 x 90 bytes: Red K A B N R C P, then Black; sides: count int8, 1 Red or -1 Black to move
+        out = _new_buffer((len(fens), PLANES, SQUARES), 'B', 'uint8') if out is None else out
+        sides = _new_buffer((len(fens),), 'b', 'int8') if sides is None else sides
+        address = _buffer_address(out, len(fens) * PLANES * SQUARES)
+        sides_address = _buffer_address(sides, len(fens))
+        valid = self._lib.xq_batch_planes(self._fen_array(fens), len(fens), address, sides_address)
+        return out, sides, valid
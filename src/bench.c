@@ -0,0 +1,95 @@
+#include "bench.h"
+#include "checks.h"
+#include "bitboard.h"
+#include "move.h"
+#include "endgame.h"
+#include "engine.h"
+#include "timeman.h"
+#include "tt.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_DEPTH 8
+
+// Representative positions: openings, middlegames and endgames
+static const char* BENCH_POSITIONS[] = {
+    // Openings
+    "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",
+    "r1bakabr1/9/1cn4cn/p1p1p1p1p/9/6P2/P1P1P3P/1C2C1N2/9/RNBAKAB1R w - - 0 1",
+    "r1bakab2/9/nR2c1n1r/p1p1p1p1p/6c2/6P1P/P1P1P4/N1C3C2/9/2BAKABNR b - - 0 1",
+    "3akab2/r2n1r3/1c2b1nc1/p1p1p3p/1C4p2/2PN5/P3P1P1P/3C2N2/9/R1BAKABR1 b - - 0 1",
+    "rn1akab1r/9/4b1n2/p1C1p3p/2c3p2/4P1P2/P6cP/6C2/2R6/1NBAKABNR b - - 0 1",
+    // Middlegames
+    "2bakab2/9/2n1c1n2/p3p3p/2p3p2/9/P1P3P1P/2N1C1N2/4A4/2BAK1B2 w - - 0 1",
+    "r2akab2/8r/2R1bnn2/3Cp3p/2p6/6P1P/P1P1c4/N3B4/4A4/2B1KA1NR b - - 0 1",
+    "3akab2/1r1n5/4b4/p1p6/4prp2/2P6/P1C1P1c1P/6N2/9/R1BAKABR1 b - - 0 1",
+    "3akabr1/1n7/4b4/p3pC2p/2c3P2/4r4/P6cP/N3B1N2/4R4/2BAKA1R1 b - - 0 1",
+    "1r2kab2/3ra4/4b1n2/1CR1p3p/2p6/P3n1P1P/2P3c2/N3B1N2/5K3/2B2A2R b - - 0 1",
+    "4kabC1/4a1r2/4b4/p1R5r/2n1p3c/9/2R3p2/4B4/9/2BAKAN2 b - - 0 1",
+    // Endgames
+    "4ka3/4a4/4b4/4R3p/9/4P4/2P5P/3rB4/4K4/5c1N1 b - - 0 1",
+    "3akab2/1n7/4PC3/p7p/9/8P/c7r/4B4/2N1A4/2B1KA3 b - - 0 1",
+    "4kab2/9/3a5/2n1C4/p7r/9/3N3c1/3A5/3K5/9 b - - 0 1",
+    "3k1a3/4a4/4b4/9/5R3/3rP4/2P5P/4B1N2/4K4/c8 b - - 0 1",
+    "3k5/4a4/4ba3/9/9/9/9/4B4/4A4/3AK1R2 w - - 0 1",
+    "4kab2/4a4/4b4/3N5/9/9/9/4B4/4A4/4KA3 w - - 0 1",
+};
+
+#define BENCH_POSITION_COUNT (int)(sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]))
+
+int run_bench(int argc, char* argv[]) {
+    if (argc > 2 && strcmp(argv[2], "check") == 0) {
+        return run_checks(argc, argv);
+    }
+
+    int depth = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_DEPTH;
+    if (depth < 1 || depth >= MAX_PLY) {
+        printf("Usage: xiangqi bench [depth]\n       xiangqi bench check [names...]\n");
+        return 1;
+    }
+
+    Board board;
+    init_board(&board, NULL);
+    init_move_generator();
+    init_endgames();
+    init_tt();
+
+    // Single-threaded, book-free and silent, so that the node count only
+    // depends on the search itself
+    set_search_threads(1);
+    set_use_opening_book(false);
+    set_search_output(SEARCH_OUTPUT_NONE);
+
+    uint64_t total_nodes = 0;
+    long total_time = 0;
+    for (int i = 0; i < BENCH_POSITION_COUNT; ++i) {
+        init_board(&board, BENCH_POSITIONS[i]);
+        init_tt();
+        clear_history_table();
+
+        SearchLimits limits = {0};
+        limits.depth = depth;
+        long start = now_ms();
+        Move best_move = search_position(&board, &limits);
+        long elapsed = now_ms() - start;
+
+        SearchStats stats;
+        get_search_stats(&stats);
+        total_nodes += stats.nodes;
+        total_time += elapsed;
+
+        char move_str[5];
+        move_to_string(best_move, move_str);
+        printf("Position %2d/%d: bestmove %s, %llu nodes, %ld ms\n",
+               i + 1, BENCH_POSITION_COUNT, move_str, (unsigned long long)stats.nodes, elapsed);
+    }
+
+    printf("===========================\n");
+    printf("Depth           : %d\n", depth);
+    printf("Total time (ms) : %ld\n", total_time);
+    printf("Nodes searched  : %llu\n", (unsigned long long)total_nodes);
+    printf("Nodes/second    : %llu\n", (unsigned long long)(total_nodes * 1000 / (total_time > 0 ? total_time : 1)));
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Fixed performance workload: "xiangqi bench [depth]".
+// Searches a built-in set of positions to a fixed depth, each with a fresh
+// transposition table and history, and prints the total node count (a
+// deterministic signature of the search) together with the time and NPS.
+// "xiangqi bench check [names...]" runs the self-checks of checks.h.
+// Returns the process exit code.
+int run_bench(int argc, char* argv[]);
+
+#endif // BENCH_H
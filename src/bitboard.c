@@ -83,17 +83,19 @@ void init_bitboard_masks()
     }
 }
 
-static void set_piece(Board *board, Piece piece_type, int sq)
+void set_piece(Board *board, Piece piece_type, int sq)
 {
     U128 mask = SQUARE_MASKS[sq];
     int player = (piece_type > 0) ? PLAYER_R : PLAYER_B;
     int r = sq / 9;
     int c = sq % 9;
+    int bb_idx = get_piece_to_bb_index(piece_type);
 
     board->board[sq] = piece_type;
-    board->piece_bitboards[get_piece_to_bb_index(piece_type)] |= mask;
+    board->piece_bitboards[bb_idx] |= mask;
     board->color_bitboards[get_player_bb_idx(player)] |= mask;
     board->hash_key ^= zobrist_keys[get_piece_to_zobrist_idx(piece_type)][r][c];
+    board->material_key += material_key_unit(bb_idx);
 }
 
 void parse_fen(Board *board, const char *fen)
@@ -136,7 +138,7 @@ void parse_fen(Board *board, const char *fen)
 
     // 3. Parse player to move
     p++; // skip space
-    board->player_to_move = (*p == 'w') ? PLAYER_R : PLAYER_B;
+    board->player_to_move = (*p == 'w' || *p == 'r') ? PLAYER_R : PLAYER_B; // UCCI GUIs may send 'r' for Red
     if (board->player_to_move == PLAYER_B)
     {
         board->hash_key ^= zobrist_player;
@@ -211,8 +213,10 @@ Piece move_piece(Board *board, int from_sq, int to_sq)
         board->hash_key ^= zobrist_keys[captured_z_idx][r_to][c_to];
 
         int captured_player = (captured_piece > 0) ? PLAYER_R : PLAYER_B;
-        board->piece_bitboards[get_piece_to_bb_index(captured_piece)] &= CLEAR_MASKS[to_sq];
+        int captured_bb_idx = get_piece_to_bb_index(captured_piece);
+        board->piece_bitboards[captured_bb_idx] &= CLEAR_MASKS[to_sq];
         board->color_bitboards[get_player_bb_idx(captured_player)] &= CLEAR_MASKS[to_sq];
+        board->material_key -= material_key_unit(captured_bb_idx);
     }
 
     // 5. Switch player and update hash
@@ -253,8 +257,10 @@ void unmove_piece(Board *board, int from_sq, int to_sq, Piece captured_piece)
     if (captured_piece != EMPTY)
     {
         int captured_player = (captured_piece > 0) ? PLAYER_R : PLAYER_B;
-        board->piece_bitboards[get_piece_to_bb_index(captured_piece)] |= SQUARE_MASKS[to_sq];
+        int captured_bb_idx = get_piece_to_bb_index(captured_piece);
+        board->piece_bitboards[captured_bb_idx] |= SQUARE_MASKS[to_sq];
         board->color_bitboards[get_player_bb_idx(captured_player)] |= SQUARE_MASKS[to_sq];
+        board->material_key += material_key_unit(captured_bb_idx);
 
         int captured_z_idx = get_piece_to_zobrist_idx(captured_piece);
         board->hash_key ^= zobrist_keys[captured_z_idx][r_to][c_to];
@@ -303,3 +309,14 @@ void copy_board(const Board *src, Board *dest)
 {
     memcpy(dest, src, sizeof(Board));
 }
+
+void trim_history(Board *board, int keep)
+{
+    int count = board->history_ply + 1; // history[history_ply] is the current position
+    if (count <= keep)
+    {
+        return;
+    }
+    memmove(board->history, board->history + (count - keep), keep * sizeof(uint64_t));
+    board->history_ply = keep - 1;
+}
@@ -38,6 +38,7 @@ typedef struct {
 
     int player_to_move;
     uint64_t hash_key;
+    uint64_t material_key; // Piece counts per type, see material_count
 
     // History of hash keys for repetition detection
     uint64_t history[MAX_HISTORY];
@@ -54,6 +55,10 @@ void print_board(const Board* board);
 Piece move_piece(Board* board, int from_sq, int to_sq);
 void unmove_piece(Board* board, int from_sq, int to_sq, Piece captured_piece);
 
+// Puts a piece on an empty square, updating the bitboards and the hash key.
+// Used to set up positions piece by piece, e.g. by the tablebase generator.
+void set_piece(Board* board, Piece piece_type, int sq);
+
 
 // --- New functions to match Python implementation ---
 
@@ -63,6 +68,10 @@ void to_fen(const Board* board, char* fen_string);
 // Creates a copy of the board state.
 void copy_board(const Board* src, Board* dest);
 
+// Drops all but the most recent keep positions from the repetition history,
+// so that long games leave room for the search below MAX_HISTORY.
+void trim_history(Board* board, int keep);
+
 // Returns a bitboard of all occupied squares.
 static inline U128 get_occupied_bitboard(const Board* board) {
     return board->color_bitboards[0] | board->color_bitboards[1];
@@ -73,6 +82,20 @@ static inline Piece get_piece_on_square(const Board* board, int sq) {
     return board->board[sq];
 }
 
+// --- Material Key ---
+// The material key holds the count of each piece type in MATERIAL_KEY_BITS
+// bits at the type's bitboard index. It is kept up to date by set_piece and
+// by captures, so positions with the same material share one key.
+#define MATERIAL_KEY_BITS 4
+
+static inline uint64_t material_key_unit(int bb_index) {
+    return (uint64_t)1 << (MATERIAL_KEY_BITS * bb_index);
+}
+
+static inline int material_count(uint64_t material_key, int bb_index) {
+    return (int)(material_key >> (MATERIAL_KEY_BITS * bb_index)) & ((1 << MATERIAL_KEY_BITS) - 1);
+}
+
 // Gets the player for a given piece.
 static inline int get_player(Piece p) {
     return (p > 0) ? PLAYER_R : PLAYER_B;
@@ -0,0 +1,433 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "book_builder.h"
+#include "bitboard.h"
+#include "move.h"
+#include "opening_book.h"
+#include "game_records.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BUILDER_MAX_THREADS 256
+#define BUILDER_MAX_FILES 1024
+
+// Records are distributed over shards by the top bits of the position key, so
+// that every shard can be sorted and aggregated on its own, and the shards
+// concatenated in order are sorted by key
+#define BUILDER_SHARD_BITS 8
+#define BUILDER_SHARDS (1 << BUILDER_SHARD_BITS)
+
+#define BUILDER_DEFAULT_MAX_PLY 40
+#define BUILDER_DEFAULT_MIN_GAMES 3
+#define BUILDER_DEFAULT_MIN_SCORE 0
+
+// One move played in one game
+typedef struct {
+    uint64_t hash_key;
+    uint8_t from_sq;
+    uint8_t to_sq;
+    uint8_t points;     // Game result for the side that played the move: 2 win, 1 draw, 0 loss
+} MoveRecord;
+
+typedef struct {
+    MoveRecord* records;
+    size_t count;
+    size_t capacity;
+} RecordList;
+
+// Book data of one shard, with move indices relative to the shard
+typedef struct {
+    BookPosition* positions;
+    BookMove* moves;
+    size_t position_count;
+    size_t move_count;
+} ShardOutput;
+
+typedef struct {
+    const char* paths[BUILDER_MAX_FILES];
+    int file_count;
+    const char* out_path;
+    int threads;
+    int max_ply;        // Plies of each game entered into the book
+    int min_games;      // A move needs to be played in this many games...
+    int min_score;      // ...and score at least this percentage for its side
+} BuilderConfig;
+
+typedef struct {
+    int id;
+    RecordList shards[BUILDER_SHARDS];
+    uint64_t games;
+    uint64_t skipped_games;     // Without a result, or with an illegal or malformed move
+} Worker;
+
+static BuilderConfig config;
+static GameFile files[BUILDER_MAX_FILES];
+static Worker* workers;
+static ShardOutput shard_outputs[BUILDER_SHARDS];
+static Board start_board;
+
+static bool append_record(RecordList* list, const MoveRecord* record) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        MoveRecord* records = (MoveRecord*)realloc(list->records, capacity * sizeof(MoveRecord));
+        if (!records) {
+            return false;
+        }
+        list->records = records;
+        list->capacity = capacity;
+    }
+    list->records[list->count++] = *record;
+    return true;
+}
+
+// --- Parsing and replay ---
+
+// Replays one game line [line, end) and records its first max_ply moves.
+// Games without a result are skipped, and so are games with an illegal or
+// malformed move; the plies before such a move are kept.
+static void process_game(Worker* worker, const char* line, const char* end) {
+    bool comment;
+    int red_points = game_line_result(line, end, &comment);
+    if (comment) {
+        return;
+    }
+    if (red_points == GAME_NO_RESULT) {
+        worker->skipped_games++;
+        return;
+    }
+
+    char token[GAME_TOKEN_LENGTH];
+    const char* cursor = line;
+    Board board;
+    copy_board(&start_board, &board);
+    for (int ply = 0; ply < config.max_ply && next_game_token(&cursor, end, token); ) {
+        if (parse_game_result(token) != GAME_NO_RESULT) {
+            continue;
+        }
+        Move move = parse_move_string(token);
+        MoveRecord record = {
+            .hash_key = board.hash_key,
+            .from_sq = (uint8_t)move.from_sq,
+            .to_sq = (uint8_t)move.to_sq,
+            .points = (uint8_t)(board.player_to_move == PLAYER_R ? red_points : 2 - red_points),
+        };
+        if ((move.from_sq == 0 && move.to_sq == 0) || !play_if_legal(&board, move)) {
+            worker->skipped_games++;
+            return;
+        }
+        if (!append_record(&worker->shards[record.hash_key >> (64 - BUILDER_SHARD_BITS)], &record)) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        ply++;
+    }
+    worker->games++;
+}
+
+static void* replay_games(void* arg) {
+    Worker* worker = (Worker*)arg;
+    for (int f = 0; f < config.file_count; ++f) {
+        const GameFile* file = &files[f];
+        if (file->size == 0) continue;
+        // Each file is split into one range of lines per worker
+        const char* p = file->data + game_file_range_start(file, worker->id, config.threads);
+        const char* range_end = file->data + game_file_range_start(file, worker->id + 1, config.threads);
+        while (p < range_end) {
+            const char* newline = memchr(p, '\n', file->data + file->size - p);
+            const char* line_end = newline ? newline : file->data + file->size;
+            process_game(worker, p, line_end);
+            p = line_end + 1;
+        }
+    }
+    return NULL;
+}
+
+// --- Aggregation ---
+
+static int compare_records(const void* a, const void* b) {
+    const MoveRecord* x = (const MoveRecord*)a;
+    const MoveRecord* y = (const MoveRecord*)b;
+    if (x->hash_key != y->hash_key) return (x->hash_key > y->hash_key) - (x->hash_key < y->hash_key);
+    if (x->from_sq != y->from_sq) return x->from_sq - y->from_sq;
+    return x->to_sq - y->to_sq;
+}
+
+static bool keep_move(uint64_t games, uint64_t points) {
+    return games >= (uint64_t)config.min_games && points * 50 >= (uint64_t)config.min_score * games;
+}
+
+// Turns the sorted records of one shard into book positions and moves. The
+// weight of a move is the points it scored, so that frequent and successful
+// moves are played most; weights are scaled down per position to fit 16 bits.
+static bool aggregate_shard(const MoveRecord* records, size_t count, ShardOutput* output) {
+    // Upper bounds, trimmed by pruning
+    output->positions = (BookPosition*)malloc((count ? count : 1) * sizeof(BookPosition));
+    output->moves = (BookMove*)malloc((count ? count : 1) * sizeof(BookMove));
+    if (!output->positions || !output->moves) {
+        return false;
+    }
+
+    size_t i = 0;
+    while (i < count) {
+        uint64_t hash_key = records[i].hash_key;
+        size_t first_move = output->move_count;
+        uint64_t points[MAX_MOVES]; // Replayed moves are legal, so a position has at most MAX_MOVES
+        uint64_t max_points = 0;
+
+        while (i < count && records[i].hash_key == hash_key) {
+            size_t j = i;
+            uint64_t move_points = 0;
+            while (j < count && records[j].hash_key == hash_key && records[j].from_sq == records[i].from_sq
+                   && records[j].to_sq == records[i].to_sq) {
+                move_points += records[j].points;
+                j++;
+            }
+            size_t index = output->move_count - first_move;
+            if (keep_move(j - i, move_points) && index < MAX_MOVES) {
+                output->moves[output->move_count].from_sq = records[i].from_sq;
+                output->moves[output->move_count].to_sq = records[i].to_sq;
+                output->move_count++;
+                points[index] = move_points;
+                if (move_points > max_points) max_points = move_points;
+            }
+            i = j;
+        }
+
+        size_t move_count = output->move_count - first_move;
+        if (move_count == 0) {
+            continue;
+        }
+        for (size_t m = 0; m < move_count; ++m) {
+            uint64_t weight = (max_points > UINT16_MAX) ? points[m] * UINT16_MAX / max_points : points[m];
+            output->moves[first_move + m].weight = (uint16_t)(weight > 0 ? weight : 1); // Lost every game: still a book move
+        }
+        BookPosition* position = &output->positions[output->position_count++];
+        position->hash_key = hash_key;
+        position->first_move = (uint32_t)first_move;
+        position->move_count = (uint16_t)move_count;
+        position->reserved = 0;
+    }
+    return true;
+}
+
+// Sorts and aggregates the shards id, id + threads, ... of all workers
+static void* aggregate_shards(void* arg) {
+    int id = ((Worker*)arg)->id;
+    for (int s = id; s < BUILDER_SHARDS; s += config.threads) {
+        size_t count = 0;
+        for (int w = 0; w < config.threads; ++w) {
+            count += workers[w].shards[s].count;
+        }
+        MoveRecord* records = (MoveRecord*)malloc((count ? count : 1) * sizeof(MoveRecord));
+        if (!records) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        size_t offset = 0;
+        for (int w = 0; w < config.threads; ++w) {
+            RecordList* list = &workers[w].shards[s];
+            if (list->count > 0) {
+                memcpy(records + offset, list->records, list->count * sizeof(MoveRecord));
+            }
+            offset += list->count;
+            free(list->records);
+            list->records = NULL;
+        }
+
+        qsort(records, count, sizeof(MoveRecord), compare_records);
+        if (!aggregate_shard(records, count, &shard_outputs[s])) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        free(records);
+    }
+    return NULL;
+}
+
+// Runs one phase on all workers; worker 0 runs on the calling thread
+static void run_workers(void* (*phase)(void*)) {
+    pthread_t threads[BUILDER_MAX_THREADS];
+    bool started[BUILDER_MAX_THREADS] = {false};
+    for (int i = 1; i < config.threads; ++i) {
+        started[i] = (pthread_create(&threads[i], NULL, phase, &workers[i]) == 0);
+    }
+    phase(&workers[0]);
+    for (int i = 1; i < config.threads; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            phase(&workers[i]);
+        }
+    }
+}
+
+// --- Output ---
+
+static bool write_book(const char* path, size_t* position_total, size_t* move_total) {
+    size_t positions = 0;
+    size_t moves = 0;
+    for (int s = 0; s < BUILDER_SHARDS; ++s) {
+        positions += shard_outputs[s].position_count;
+        moves += shard_outputs[s].move_count;
+    }
+    *position_total = positions;
+    *move_total = moves;
+    if (positions > UINT32_MAX || moves > UINT32_MAX) {
+        printf("Book too large: %zu positions, %zu moves.\n", positions, moves);
+        return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Could not open %s for writing.\n", path);
+        return false;
+    }
+    BookHeader header = {0};
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.position_count = (uint32_t)positions;
+    header.move_count = (uint32_t)moves;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // Move indices become global: each shard's moves follow those of the previous shards
+    size_t move_offset = 0;
+    for (int s = 0; s < BUILDER_SHARDS && ok; ++s) {
+        ShardOutput* output = &shard_outputs[s];
+        for (size_t i = 0; i < output->position_count; ++i) {
+            output->positions[i].first_move += (uint32_t)move_offset;
+        }
+        ok = fwrite(output->positions, sizeof(BookPosition), output->position_count, file) == output->position_count;
+        move_offset += output->move_count;
+    }
+    for (int s = 0; s < BUILDER_SHARDS && ok; ++s) {
+        ShardOutput* output = &shard_outputs[s];
+        ok = fwrite(output->moves, sizeof(BookMove), output->move_count, file) == output->move_count;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        printf("Failed to write the opening book to %s.\n", path);
+    }
+    return ok;
+}
+
+// --- Command line ---
+
+static void print_usage() {
+    printf("Usage: xiangqi book [options] <game files...>\n"
+           "  Game files hold one game per line: coordinate moves from the start position\n"
+           "  (e.g. h2e2 h9g7) and a result (1-0, 0-1 or 1/2-1/2); lines starting with # are skipped.\n"
+           "  -out <file>          Book file to write (default %s)\n"
+           "  -threads <n>         Worker threads (default: all cores)\n"
+           "  -maxply <n>          Plies of each game entered into the book (default %d)\n"
+           "  -mingames <n>        Keep moves played in at least n games (default %d)\n"
+           "  -minscore <percent>  Keep moves scoring at least this for their side (default %d)\n",
+           DEFAULT_BOOK_PATH, BUILDER_DEFAULT_MAX_PLY, BUILDER_DEFAULT_MIN_GAMES, BUILDER_DEFAULT_MIN_SCORE);
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int run_book_builder(int argc, char* argv[]) {
+    config = (BuilderConfig){
+        .out_path = DEFAULT_BOOK_PATH,
+        .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+        .max_ply = BUILDER_DEFAULT_MAX_PLY,
+        .min_games = BUILDER_DEFAULT_MIN_GAMES,
+        .min_score = BUILDER_DEFAULT_MIN_SCORE,
+    };
+
+    for (int i = 2; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-out") == 0 && remaining >= 1) {
+            config.out_path = argv[++i];
+        } else if (strcmp(option, "-threads") == 0 && remaining >= 1) {
+            config.threads = atoi(argv[++i]);
+        } else if (strcmp(option, "-maxply") == 0 && remaining >= 1) {
+            config.max_ply = atoi(argv[++i]);
+        } else if (strcmp(option, "-mingames") == 0 && remaining >= 1) {
+            config.min_games = atoi(argv[++i]);
+        } else if (strcmp(option, "-minscore") == 0 && remaining >= 1) {
+            config.min_score = atoi(argv[++i]);
+        } else if (option[0] != '-' && config.file_count < BUILDER_MAX_FILES) {
+            config.paths[config.file_count++] = option;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (config.file_count == 0 || config.max_ply < 1) {
+        print_usage();
+        return 1;
+    }
+    if (config.max_ply > MAX_HISTORY - 1) config.max_ply = MAX_HISTORY - 1; // Replay keeps the whole game history
+    if (config.threads < 1) config.threads = 1;
+    if (config.threads > BUILDER_MAX_THREADS) config.threads = BUILDER_MAX_THREADS;
+
+    // Shared tables are initialized before any worker starts
+    init_board(&start_board, NULL);
+    init_move_generator();
+
+    size_t input_bytes = 0;
+    for (int f = 0; f < config.file_count; ++f) {
+        if (!map_game_file(config.paths[f], &files[f])) {
+            return 1;
+        }
+        input_bytes += files[f].size;
+    }
+
+    workers = (Worker*)calloc(config.threads, sizeof(Worker));
+    if (!workers) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < config.threads; ++i) {
+        workers[i].id = i;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    run_workers(replay_games);
+    uint64_t games = 0, skipped_games = 0, records = 0;
+    for (int i = 0; i < config.threads; ++i) {
+        games += workers[i].games;
+        skipped_games += workers[i].skipped_games;
+        for (int s = 0; s < BUILDER_SHARDS; ++s) {
+            records += workers[i].shards[s].count;
+        }
+    }
+    double replay_time = elapsed_seconds(&start);
+
+    run_workers(aggregate_shards);
+
+    size_t positions, moves;
+    bool ok = write_book(config.out_path, &positions, &moves);
+    double total_time = elapsed_seconds(&start);
+
+    printf("Games: %llu (%llu skipped), %.1f MB read\n", (unsigned long long)games,
+           (unsigned long long)skipped_games, input_bytes / (1024.0 * 1024.0));
+    printf("Replayed positions: %llu in %.2fs (%.0f positions/s, %d threads)\n", (unsigned long long)records,
+           replay_time, replay_time > 0 ? records / replay_time : 0.0, config.threads);
+    if (ok) {
+        printf("Book %s: %zu positions, %zu moves, built in %.2fs\n", config.out_path, positions, moves, total_time);
+    }
+
+    for (int s = 0; s < BUILDER_SHARDS; ++s) {
+        free(shard_outputs[s].positions);
+        free(shard_outputs[s].moves);
+    }
+    for (int f = 0; f < config.file_count; ++f) {
+        unmap_game_file(&files[f]);
+    }
+    free(workers);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef BOOK_BUILDER_H
+#define BOOK_BUILDER_H
+
+// Opening book builder: "xiangqi book [options] <game files...>".
+// Streams game records (one game per line: coordinate moves such as "h2e2"
+// from the start position, and a result "1-0", "0-1" or "1/2-1/2"), replays
+// the first plies of every game, aggregates per-position move statistics in
+// parallel shards and writes the binary book format (see opening_book.h).
+// Returns the process exit code.
+int run_book_builder(int argc, char* argv[]);
+
+#endif // BOOK_BUILDER_H
@@ -0,0 +1,833 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "checks.h"
+#include "bitboard.h"
+#include "move.h"
+#include "engine.h"
+#include "tt.h"
+#include "opening_book.h"
+#include "book_builder.h"
+#include "tablebase.h"
+#include "tablebase_gen.h"
+#include "endgame.h"
+#include "game_db.h"
+#include "game_db_builder.h"
+#include "position_codec.h"
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Checks run on positions reached by random legal moves from the start
+// position; the generator is reseeded before every check, so each check
+// sees the same positions on every run
+#define CHECK_SEED 0x5851F42D4C957F2DULL
+#define CHECK_POSITIONS 64
+#define CHECK_MAX_PLIES 160
+
+// Files and directories written by the checks are created from this
+// template and removed
+#define CHECK_TEMP_TEMPLATE "/tmp/xiangqi_check_XXXXXX"
+#define CHECK_PATH_SIZE 512
+
+typedef struct {
+    const char* name;
+    bool (*run)();
+} Check;
+
+// --- Positions ---
+
+static uint64_t random_state;
+
+static uint64_t next_random() {
+    uint64_t z = (random_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Plays up to plies random legal moves from the start position, fewer if a
+// side runs out of legal moves
+static void random_position(Board* board, int plies) {
+    init_board(board, NULL);
+    for (int ply = 0; ply < plies; ++ply) {
+        MoveList moves;
+        generate_legal_moves(board, &moves);
+        if (moves.count == 0) {
+            break;
+        }
+        Move move = moves.moves[next_random() % moves.count];
+        move_piece(board, move.from_sq, move.to_sq);
+        if (board->history_ply >= MAX_HISTORY / 2) {
+            trim_history(board, MAX_HISTORY / 4);
+        }
+    }
+}
+
+// Position i of CHECK_POSITIONS, from the opening to the endgame
+static void check_position(Board* board, int i) {
+    random_position(board, i * CHECK_MAX_PLIES / CHECK_POSITIONS);
+}
+
+static bool is_legal_move(Board* board, Move move) {
+    MoveList moves;
+    generate_legal_moves(board, &moves);
+    for (int i = 0; i < moves.count; ++i) {
+        if (is_same_move(moves.moves[i], move)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Creates an empty temporary file and stores its name in path
+static bool make_temp_file(char path[sizeof(CHECK_TEMP_TEMPLATE)]) {
+    strcpy(path, CHECK_TEMP_TEMPLATE);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("  cannot create a temporary file\n");
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+// Creates an empty temporary directory and stores its name in path
+static bool make_temp_dir(char path[sizeof(CHECK_TEMP_TEMPLATE)]) {
+    strcpy(path, CHECK_TEMP_TEMPLATE);
+    if (mkdtemp(path) == NULL) {
+        printf("  cannot create a temporary directory\n");
+        return false;
+    }
+    return true;
+}
+
+// Removes a directory and the files in it
+static void remove_temp_dir(const char* dir) {
+    DIR* directory = opendir(dir);
+    if (directory) {
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                char path[CHECK_PATH_SIZE];
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(directory);
+    }
+    rmdir(dir);
+}
+
+// Returns true if both files exist and hold the same bytes
+static bool same_file_contents(const char* path_a, const char* path_b) {
+    FILE* a = fopen(path_a, "rb");
+    FILE* b = fopen(path_b, "rb");
+    bool same = a != NULL && b != NULL;
+    while (same) {
+        int ca = fgetc(a);
+        int cb = fgetc(b);
+        same = ca == cb;
+        if (ca == EOF) {
+            break;
+        }
+    }
+    if (a) fclose(a);
+    if (b) fclose(b);
+    return same;
+}
+
+// Returns true if every file of dir_a is in dir_b with the same bytes, and
+// both hold as many files
+static bool same_dir_contents(const char* dir_a, const char* dir_b) {
+    int files[2] = {0, 0};
+    bool same = true;
+    const char* dirs[2] = { dir_a, dir_b };
+    for (int d = 0; d < 2; ++d) {
+        DIR* directory = opendir(dirs[d]);
+        if (!directory) {
+            return false;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(directory)) != NULL) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            files[d]++;
+            if (d == 0) {
+                char path_a[CHECK_PATH_SIZE], path_b[CHECK_PATH_SIZE];
+                snprintf(path_a, sizeof(path_a), "%s/%s", dir_a, entry->d_name);
+                snprintf(path_b, sizeof(path_b), "%s/%s", dir_b, entry->d_name);
+                same = same && same_file_contents(path_a, path_b);
+            }
+        }
+        closedir(directory);
+    }
+    return same && files[0] == files[1];
+}
+
+// Runs a subcommand in a child process with its output discarded, so that
+// its global state stays out of this process. argv is NULL-terminated.
+// Returns true if it exits with status 0.
+static bool run_subcommand(int (*run)(int, char*[]), char* argv[]) {
+    int argc = 0;
+    while (argv[argc] != NULL) {
+        ++argc;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!freopen("/dev/null", "w", stdout)) {
+            _exit(1);
+        }
+        int code = run(argc, argv);
+        fflush(stdout);
+        _exit(code);
+    }
+    int status;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// --- Node Limit ---
+// A search stopped by its node limit before the first iteration completes
+// must still return a legal move
+
+static bool check_node_limit() {
+    bool ok = true;
+    for (int i = 0; i < CHECK_POSITIONS; ++i) {
+        Board board;
+        check_position(&board, i);
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        if (moves.count == 0) {
+            continue;
+        }
+        SearchLimits limits = {0};
+        limits.nodes = 1;
+        Move best_move = search_position(&board, &limits);
+        if (!is_legal_move(&board, best_move)) {
+            printf("  position %d: no legal move with a limit of 1 node\n", i);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// --- Transposition Table Files ---
+// A saved table loads and maps back with every entry intact. Files whose
+// header does not match their size, e.g. a huge bucket count, are rejected
+// before the current table is touched.
+
+#define TT_CHECK_SIZE_MB 1
+#define TT_CHECK_DEPTH 6
+#define TT_CHECK_KEYS 16
+
+// Offset of bucket_count in the file header: magic, version, bucket_size
+#define TT_FILE_BUCKET_COUNT_OFFSET 16
+
+typedef struct {
+    uint64_t keys[TT_CHECK_KEYS];
+    TTEntry entries[TT_CHECK_KEYS];
+    bool hits[TT_CHECK_KEYS];
+} TTSnapshot;
+
+static void take_tt_snapshot(TTSnapshot* snapshot, const uint64_t* keys) {
+    for (int i = 0; i < TT_CHECK_KEYS; ++i) {
+        snapshot->keys[i] = keys[i];
+        snapshot->hits[i] = probe_tt(keys[i], &snapshot->entries[i]);
+    }
+}
+
+static bool same_tt_snapshot(const TTSnapshot* a, const TTSnapshot* b) {
+    for (int i = 0; i < TT_CHECK_KEYS; ++i) {
+        const TTEntry* x = &a->entries[i];
+        const TTEntry* y = &b->entries[i];
+        if (a->hits[i] != b->hits[i]) {
+            return false;
+        }
+        if (a->hits[i] && (!is_same_move(x->best_move, y->best_move) || x->score != y->score
+                           || x->eval != y->eval || x->depth != y->depth || x->flag != y->flag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the first bytes of a table file with another bucket count
+static bool write_bad_header(const char* source, const char* path, uint64_t bucket_count) {
+    unsigned char header[64];
+    FILE* in = fopen(source, "rb");
+    bool ok = in != NULL && fread(header, sizeof(header), 1, in) == 1;
+    if (in) fclose(in);
+    memcpy(header + TT_FILE_BUCKET_COUNT_OFFSET, &bucket_count, sizeof(bucket_count));
+    FILE* out = ok ? fopen(path, "wb") : NULL;
+    ok = out != NULL && fwrite(header, sizeof(header), 1, out) == 1;
+    if (out) ok = (fclose(out) == 0) && ok;
+    return ok;
+}
+
+static bool check_tt_files() {
+    char saved[sizeof(CHECK_TEMP_TEMPLATE)], bad[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_file(saved)) {
+        return false;
+    }
+    if (!make_temp_file(bad)) {
+        unlink(saved);
+        return false;
+    }
+
+    // Fill a small table with the results of a few searches
+    resize_tt(TT_CHECK_SIZE_MB);
+    uint64_t keys[TT_CHECK_KEYS];
+    for (int i = 0; i < TT_CHECK_KEYS; ++i) {
+        Board board;
+        check_position(&board, i * CHECK_POSITIONS / TT_CHECK_KEYS);
+        SearchLimits limits = {0};
+        limits.depth = TT_CHECK_DEPTH;
+        search_position(&board, &limits);
+        keys[i] = board.hash_key;
+    }
+    TTSnapshot before, after;
+    take_tt_snapshot(&before, keys);
+
+    bool ok = true;
+    if (!save_tt(saved)) {
+        printf("  save_tt failed\n");
+        ok = false;
+    }
+    init_tt();
+    if (ok && (!load_tt(saved) || (take_tt_snapshot(&after, keys), !same_tt_snapshot(&before, &after)))) {
+        printf("  loaded table differs from the saved one\n");
+        ok = false;
+    }
+
+    // Rejected headers keep the loaded table
+    uint64_t bad_counts[] = { (1ULL << 58) + 1, 0 };
+    for (int i = 0; ok && i < (int)(sizeof(bad_counts) / sizeof(bad_counts[0])); ++i) {
+        if (!write_bad_header(saved, bad, bad_counts[i])) {
+            printf("  cannot write %s\n", bad);
+            ok = false;
+        } else if (load_tt(bad) || (take_tt_snapshot(&after, keys), !same_tt_snapshot(&before, &after))) {
+            printf("  header with %llu buckets not rejected\n", (unsigned long long)bad_counts[i]);
+            ok = false;
+        }
+    }
+
+    if (ok && (!map_tt_file(saved, TT_CHECK_SIZE_MB) || (take_tt_snapshot(&after, keys), !same_tt_snapshot(&before, &after)))) {
+        printf("  mapped table differs from the saved one\n");
+        ok = false;
+    }
+
+    resize_tt(TT_DEFAULT_SIZE_MB); // Back to a memory table
+    unlink(saved);
+    unlink(bad);
+    return ok;
+}
+
+// --- Opening Book ---
+// Every position of a book written sorted by key is found by the binary
+// search with its move; other positions are not. A book whose positions are
+// out of order is rejected.
+
+typedef struct {
+    uint64_t hash_key;
+    Move move;
+} BookCheckEntry;
+
+static int compare_book_entries(const void* a, const void* b) {
+    uint64_t x = ((const BookCheckEntry*)a)->hash_key;
+    uint64_t y = ((const BookCheckEntry*)b)->hash_key;
+    return (x > y) - (x < y);
+}
+
+static bool write_check_book(const char* path, const BookCheckEntry* entries, int count) {
+    BookHeader header = {0};
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.position_count = (uint32_t)count;
+    header.move_count = (uint32_t)count;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < count; ++i) {
+        BookPosition position = { entries[i].hash_key, (uint32_t)i, 1, 0 };
+        ok = fwrite(&position, sizeof(position), 1, file) == 1;
+    }
+    for (int i = 0; ok && i < count; ++i) {
+        BookMove move = { (uint8_t)entries[i].move.from_sq, (uint8_t)entries[i].move.to_sq, 1 };
+        ok = fwrite(&move, sizeof(move), 1, file) == 1;
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+static bool check_opening_book() {
+    char path[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_file(path)) {
+        return false;
+    }
+
+    // One random legal move per position, keys sorted and unique; the odd
+    // positions are left out of the book
+    BookCheckEntry entries[CHECK_POSITIONS];
+    Board boards[CHECK_POSITIONS];
+    Move moves[CHECK_POSITIONS];
+    int count = 0;
+    for (int i = 0; i < CHECK_POSITIONS; ++i) {
+        check_position(&boards[i], i);
+        MoveList legal_moves;
+        generate_legal_moves(&boards[i], &legal_moves);
+        moves[i] = legal_moves.count > 0 ? legal_moves.moves[next_random() % legal_moves.count] : (Move){0, 0};
+        if (i % 2 == 0 && legal_moves.count > 0) {
+            entries[count++] = (BookCheckEntry){ boards[i].hash_key, moves[i] };
+        }
+    }
+    qsort(entries, count, sizeof(entries[0]), compare_book_entries);
+    int unique = 0;
+    for (int i = 0; i < count; ++i) {
+        if (unique == 0 || entries[i].hash_key != entries[unique - 1].hash_key) {
+            entries[unique++] = entries[i];
+        }
+    }
+    count = unique;
+
+    bool ok = write_check_book(path, entries, count) && load_opening_book(path);
+    if (!ok) {
+        printf("  cannot write or load %s\n", path);
+    }
+    for (int i = 0; ok && i < CHECK_POSITIONS; ++i) {
+        BookCheckEntry key = { boards[i].hash_key, {0, 0} };
+        const BookCheckEntry* entry = bsearch(&key, entries, count, sizeof(entries[0]), compare_book_entries);
+        Move expected = entry ? entry->move : (Move){0, 0};
+        Move move = query_opening_book(&boards[i]);
+        if (!is_same_move(move, expected)) {
+            printf("  position %d: book move differs\n", i);
+            ok = false;
+        }
+    }
+
+    // Two positions swapped
+    if (ok && count >= 2) {
+        BookCheckEntry first = entries[0];
+        entries[0] = entries[1];
+        entries[1] = first;
+        if (!write_check_book(path, entries, count) || load_opening_book(path)) {
+            printf("  unsorted book not rejected\n");
+            ok = false;
+        }
+    }
+
+    close_opening_book();
+    unlink(path);
+    return ok;
+}
+
+// --- Book Builder ---
+// The book built from the same games is identical byte for byte whatever
+// the number of worker threads.
+
+#define BOOKBUILD_GAMES 400
+#define BOOKBUILD_MAX_PLIES 30
+#define BOOKBUILD_BRANCHING 3   // Moves picked among the first few, so that games share positions
+
+static bool write_check_games(const char* path) {
+    static const char* RESULTS[] = { "1-0", "0-1", "1/2-1/2" };
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    for (int game = 0; game < BOOKBUILD_GAMES; ++game) {
+        Board board;
+        init_board(&board, NULL);
+        int plies = 1 + (int)(next_random() % BOOKBUILD_MAX_PLIES);
+        for (int ply = 0; ply < plies; ++ply) {
+            MoveList moves;
+            generate_legal_moves(&board, &moves);
+            if (moves.count == 0) {
+                break;
+            }
+            int choices = moves.count < BOOKBUILD_BRANCHING ? moves.count : BOOKBUILD_BRANCHING;
+            Move move = moves.moves[next_random() % choices];
+            char move_str[5];
+            move_to_string(move, move_str);
+            fprintf(file, "%s ", move_str);
+            move_piece(&board, move.from_sq, move.to_sq);
+        }
+        fprintf(file, "%s\n", RESULTS[next_random() % 3]);
+    }
+    return fclose(file) == 0;
+}
+
+static bool check_book_builder() {
+    char games[sizeof(CHECK_TEMP_TEMPLATE)], book_1[sizeof(CHECK_TEMP_TEMPLATE)], book_n[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_file(games)) {
+        return false;
+    }
+    bool ok = make_temp_file(book_1);
+    if (ok && !make_temp_file(book_n)) {
+        unlink(book_1);
+        ok = false;
+    }
+    if (!ok) {
+        unlink(games);
+        return false;
+    }
+
+    ok = write_check_games(games);
+    char* argv_1[] = { "xiangqi", "book", "-threads", "1", "-mingames", "1", "-out", book_1, games, NULL };
+    char* argv_n[] = { "xiangqi", "book", "-threads", "4", "-mingames", "1", "-out", book_n, games, NULL };
+    if (!ok || !run_subcommand(run_book_builder, argv_1) || !run_subcommand(run_book_builder, argv_n)) {
+        printf("  book builder failed\n");
+        ok = false;
+    } else if (!same_file_contents(book_1, book_n)) {
+        printf("  books built with 1 and 4 threads differ\n");
+        ok = false;
+    }
+
+    unlink(games);
+    unlink(book_1);
+    unlink(book_n);
+    return ok;
+}
+
+// --- Game Database ---
+// The database built from the games of the book builder check is identical
+// byte for byte whatever the number of worker threads, and lists every game
+// at the start position.
+
+static bool check_game_db() {
+    char games[sizeof(CHECK_TEMP_TEMPLATE)], db_1[sizeof(CHECK_TEMP_TEMPLATE)], db_n[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_file(games)) {
+        return false;
+    }
+    bool ok = make_temp_file(db_1);
+    if (ok && !make_temp_file(db_n)) {
+        unlink(db_1);
+        ok = false;
+    }
+    if (!ok) {
+        unlink(games);
+        return false;
+    }
+
+    ok = write_check_games(games);
+    char* argv_1[] = { "xiangqi", "gamedb", "build", "-threads", "1", "-out", db_1, games, NULL };
+    char* argv_n[] = { "xiangqi", "gamedb", "build", "-threads", "4", "-out", db_n, games, NULL };
+    if (!ok || !run_subcommand(run_game_db, argv_1) || !run_subcommand(run_game_db, argv_n)) {
+        printf("  game database builder failed\n");
+        ok = false;
+    } else if (!same_file_contents(db_1, db_n)) {
+        printf("  databases built with 1 and 4 threads differ\n");
+        ok = false;
+    } else {
+        Board board;
+        init_board(&board, NULL);
+        const GameDBPosition* position = open_game_db(db_1) ? find_game_db_position(board.hash_key) : NULL;
+        if (position == NULL || position->game_count != BOOKBUILD_GAMES) {
+            printf("  start position not found in every game\n");
+            ok = false;
+        }
+        close_game_db();
+    }
+
+    unlink(games);
+    unlink(db_1);
+    unlink(db_n);
+    return ok;
+}
+
+// --- Tablebases ---
+// Tables generated with 1 and 4 threads are identical, and every value in
+// them agrees with the values of its children: a win in n plies has a move
+// to a loss in n-1 and none to a shorter one, a loss in n has only moves to
+// wins in at most n-1, a side without moves loses in 0.
+
+static const char* TB_CHECK_MATERIALS[] = { "KRk", "KNk", "KCk" };
+#define TB_CHECK_MATERIAL_COUNT (int)(sizeof(TB_CHECK_MATERIALS) / sizeof(TB_CHECK_MATERIALS[0]))
+#define TB_MAX_CHECK_MATERIALS 8
+
+// Value of a position from the values of its children, as a retrograde
+// analysis must have found it; TB_VALUE_INVALID if a child has no value
+static uint8_t value_from_children(Board* board) {
+    MoveList moves;
+    generate_legal_moves(board, &moves);
+    if (moves.count == 0) {
+        return tb_loss_value(0);
+    }
+    int win_dtm = INT_MAX;
+    int loss_dtm = 0;
+    bool draw = false;
+    for (int i = 0; i < moves.count; ++i) {
+        Move move = moves.moves[i];
+        Piece captured = move_piece(board, move.from_sq, move.to_sq);
+        uint8_t value = probe_tablebase_value(board);
+        unmove_piece(board, move.from_sq, move.to_sq, captured);
+        if (value == TB_VALUE_INVALID) {
+            return TB_VALUE_INVALID;
+        }
+        if (tb_value_is_loss(value)) {
+            if (tb_value_dtm(value) + 1 < win_dtm) win_dtm = tb_value_dtm(value) + 1;
+        } else if (tb_value_is_win(value)) {
+            if (tb_value_dtm(value) + 1 > loss_dtm) loss_dtm = tb_value_dtm(value) + 1;
+        } else {
+            draw = true;
+        }
+    }
+    if (win_dtm != INT_MAX) {
+        return tb_win_value(win_dtm);
+    }
+    return draw ? TB_VALUE_DRAW : tb_loss_value(loss_dtm);
+}
+
+static bool check_table_values(const char* name) {
+    TBMaterial material;
+    bool flipped;
+    tb_parse_material(name, &material);
+    material = tb_canonical_material(&material, &flipped);
+    const TBTable* table = tb_find_table(&material);
+    if (table == NULL) {
+        printf("  %s: table not loaded\n", name);
+        return false;
+    }
+    for (uint64_t index = 0; index < 2 * table->layout.positions; ++index) {
+        // Impossible positions, the side not to move in check, are never
+        // probed and have no value in the file
+        Board board;
+        if (!tb_set_position(&table->layout, index, &board) || is_king_in_check(&board, -board.player_to_move)) {
+            continue;
+        }
+        uint8_t value = probe_tablebase_value(&board);
+        if (value != value_from_children(&board)) {
+            char fen[128];
+            to_fen(&board, fen);
+            printf("  %s: value %d of %s disagrees with its children\n", name, value, fen);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Generates the tables of materials (and those they capture down to) into dir
+static bool generate_tablebases(const char* dir, const char* threads, const char* const* materials, int count) {
+    char* argv[6 + TB_MAX_CHECK_MATERIALS + 1] = { "xiangqi", "tbgen", "-dir", (char*)dir, "-threads", (char*)threads };
+    for (int i = 0; i < count && i < TB_MAX_CHECK_MATERIALS; ++i) {
+        argv[6 + i] = (char*)materials[i];
+    }
+    if (!run_subcommand(run_tablebase_generator, argv)) {
+        printf("  tablebase generator failed\n");
+        return false;
+    }
+    return true;
+}
+
+static bool check_tablebases() {
+    char dir_1[sizeof(CHECK_TEMP_TEMPLATE)], dir_n[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_dir(dir_1)) {
+        return false;
+    }
+    if (!make_temp_dir(dir_n)) {
+        remove_temp_dir(dir_1);
+        return false;
+    }
+
+    bool ok = generate_tablebases(dir_1, "1", TB_CHECK_MATERIALS, TB_CHECK_MATERIAL_COUNT)
+              && generate_tablebases(dir_n, "4", TB_CHECK_MATERIALS, TB_CHECK_MATERIAL_COUNT);
+    if (!ok) {
+        // Reported by generate_tablebases
+    } else if (!same_dir_contents(dir_1, dir_n)) {
+        printf("  tables generated with 1 and 4 threads differ\n");
+        ok = false;
+    } else if (load_tablebases(dir_1) == 0) {
+        ok = false;
+    }
+    for (int i = 0; ok && i < TB_CHECK_MATERIAL_COUNT; ++i) {
+        ok = check_table_values(TB_CHECK_MATERIALS[i]);
+    }
+
+    close_tablebases();
+    remove_temp_dir(dir_1);
+    remove_temp_dir(dir_n);
+    return ok;
+}
+
+// --- Endgame Recognizers ---
+// No position an endgame recognizer calls a certain draw is won or lost in
+// the tablebases.
+
+static const char* RECOGNIZER_MATERIALS[] = { "KCk", "KCBk", "KPk", "KAkb", "KBBkaa" };
+#define RECOGNIZER_MATERIAL_COUNT (int)(sizeof(RECOGNIZER_MATERIALS) / sizeof(RECOGNIZER_MATERIALS[0]))
+
+// Returns the number of positions of the table recognized as draws, or -1
+// if one of them is not a draw
+static int check_recognized_draws(const char* name) {
+    TBMaterial material;
+    bool flipped;
+    tb_parse_material(name, &material);
+    material = tb_canonical_material(&material, &flipped);
+    const TBTable* table = tb_find_table(&material);
+    if (table == NULL) {
+        printf("  %s: table not loaded\n", name);
+        return -1;
+    }
+    int draws = 0;
+    for (uint64_t index = 0; index < 2 * table->layout.positions; ++index) {
+        Board board;
+        if (!tb_set_position(&table->layout, index, &board) || is_king_in_check(&board, -board.player_to_move)
+            || !endgame_is_draw(&board)) {
+            continue;
+        }
+        uint8_t value = probe_tablebase_value(&board);
+        if (value != TB_VALUE_DRAW) {
+            char fen[128];
+            to_fen(&board, fen);
+            printf("  %s: %s is recognized as a draw, value %d\n", name, fen, value);
+            return -1;
+        }
+        draws++;
+    }
+    return draws;
+}
+
+static bool check_recognizers() {
+    char dir[sizeof(CHECK_TEMP_TEMPLATE)];
+    if (!make_temp_dir(dir)) {
+        return false;
+    }
+    bool ok = generate_tablebases(dir, "4", RECOGNIZER_MATERIALS, RECOGNIZER_MATERIAL_COUNT)
+              && load_tablebases(dir) > 0;
+    for (int i = 0; ok && i < RECOGNIZER_MATERIAL_COUNT; ++i) {
+        int draws = check_recognized_draws(RECOGNIZER_MATERIALS[i]);
+        if (draws == 0) {
+            printf("  %s: no position recognized\n", RECOGNIZER_MATERIALS[i]);
+        }
+        ok = draws > 0;
+    }
+    close_tablebases();
+    remove_temp_dir(dir);
+    return ok;
+}
+
+// --- Position Codec ---
+// Both encodings decode to the position encoded, with the same hash and
+// material keys. Huffman encodings decode back to back and are rejected
+// when truncated.
+
+// Same pieces, side to move and keys; the history is not encoded
+static bool same_position(const Board* a, const Board* b) {
+    return memcmp(a->piece_bitboards, b->piece_bitboards, sizeof(a->piece_bitboards)) == 0
+           && memcmp(a->color_bitboards, b->color_bitboards, sizeof(a->color_bitboards)) == 0
+           && memcmp(a->board, b->board, sizeof(a->board)) == 0 && a->player_to_move == b->player_to_move
+           && a->hash_key == b->hash_key && a->material_key == b->material_key;
+}
+
+static bool check_codec() {
+    uint8_t previous[HUFFMAN_POSITION_MAX_SIZE];
+    int previous_size = 0;
+    Board previous_board;
+    for (int i = 0; i < CHECK_POSITIONS; ++i) {
+        Board board, decoded;
+        check_position(&board, i);
+
+        PackedPosition packed;
+        if (!encode_position(&board, &packed) || !decode_position(&packed, &decoded)
+            || !same_position(&board, &decoded)) {
+            printf("  position %d: packed encoding does not round-trip\n", i);
+            return false;
+        }
+
+        // Encoded after the previous position, which must decode first
+        uint8_t data[2 * HUFFMAN_POSITION_MAX_SIZE];
+        memcpy(data, previous, previous_size);
+        int size = encode_position_huffman(&board, data + previous_size);
+        int read = (size > 0 && previous_size > 0)
+                   ? decode_position_huffman(data, previous_size + size, &decoded) : previous_size;
+        if (size <= 0 || read != previous_size || (previous_size > 0 && !same_position(&previous_board, &decoded))
+            || decode_position_huffman(data + read, size, &decoded) != size || !same_position(&board, &decoded)) {
+            printf("  position %d: Huffman encoding does not round-trip\n", i);
+            return false;
+        }
+        if (decode_position_huffman(data + read, size - 1, &decoded) != -1) {
+            printf("  position %d: truncated Huffman encoding not rejected\n", i);
+            return false;
+        }
+        memcpy(previous, data + read, size);
+        previous_size = size;
+        previous_board = board;
+    }
+    return true;
+}
+
+// --- Command Line ---
+
+static const Check CHECKS[] = {
+    {"nodelimit", check_node_limit},
+    {"ttfile", check_tt_files},
+    {"book", check_opening_book},
+    {"bookbuild", check_book_builder},
+    {"gamedb", check_game_db},
+    {"tablebase", check_tablebases},
+    {"recognizer", check_recognizers},
+    {"codec", check_codec},
+};
+
+#define CHECK_COUNT (int)(sizeof(CHECKS) / sizeof(CHECKS[0]))
+
+static bool is_selected(const char* name, int argc, char* argv[]) {
+    if (argc <= 3) {
+        return true;
+    }
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int run_checks(int argc, char* argv[]) {
+    for (int i = 3; i < argc; ++i) {
+        bool known = false;
+        for (int c = 0; c < CHECK_COUNT; ++c) {
+            known = known || strcmp(argv[i], CHECKS[c].name) == 0;
+        }
+        if (!known) {
+            printf("Usage: xiangqi bench check [names...]\n  Checks:");
+            for (int c = 0; c < CHECK_COUNT; ++c) {
+                printf(" %s", CHECKS[c].name);
+            }
+            printf("\n");
+            return 1;
+        }
+    }
+
+    Board board;
+    init_board(&board, NULL);
+    init_move_generator();
+    init_endgames();
+    init_tt();
+    set_search_threads(1);
+    set_use_opening_book(false);
+    set_search_output(SEARCH_OUTPUT_NONE);
+
+    int failed = 0;
+    for (int c = 0; c < CHECK_COUNT; ++c) {
+        if (!is_selected(CHECKS[c].name, argc, argv)) {
+            continue;
+        }
+        random_state = CHECK_SEED;
+        init_tt();
+        clear_history_table();
+        bool ok = CHECKS[c].run();
+        printf("Check %-12s: %s\n", CHECKS[c].name, ok ? "ok" : "FAILED");
+        fflush(stdout);
+        failed += ok ? 0 : 1;
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#ifndef CHECKS_H
+#define CHECKS_H
+
+// Self-checks: "xiangqi bench check [names...]", run by "make bench" after
+// the node signature. Each check drives one part of the engine end to end
+// and compares the outcome with what must hold, e.g. that a search stopped
+// by a 1-node limit still returns a legal move. Runs every check, or the
+// named ones, and prints one line per check.
+// Returns the process exit code: 1 if any check fails.
+int run_checks(int argc, char* argv[]);
+
+#endif // CHECKS_H
@@ -17,6 +17,9 @@ typedef enum {
 #define MATE_VALUE 10000
 #define DRAW_VALUE 0
 
+// Scores beyond this bound are mate scores
+#define MATE_THRESHOLD (MATE_VALUE - 100)
+
 // --- Piece Base Values ---
 // Note: These values might be better placed in evaluate.c/h, 
 // but we mirror the Python structure for now.
@@ -0,0 +1,584 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "datagen.h"
+#include "bitboard.h"
+#include "move.h"
+#include "engine.h"
+#include "endgame.h"
+#include "tt.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(DataRecord) == 48, "DataRecord must stay 48 bytes");
+
+#define DATAGEN_DEFAULT_PATH "training_data.bin"
+#define DATAGEN_MAX_WORKERS 256
+#define DATAGEN_MAX_FILES 1024
+
+#define DATAGEN_DEFAULT_GAMES 1000
+#define DATAGEN_DEFAULT_NODES 5000
+#define DATAGEN_DEFAULT_RANDOM_PLIES 8
+#define DATAGEN_DEFAULT_MAX_PLIES 400
+#define DATAGEN_DEFAULT_HASH_MB 16
+#define DATAGEN_MAX_PLIES 2000
+
+// A game is adjudicated once the search score stays beyond this bound, in
+// favor of the same side, for this many plies in a row
+#define DATAGEN_RESIGN_SCORE 2500
+#define DATAGEN_RESIGN_PLIES 8
+
+// Scores are stored in 16 bits
+#define DATAGEN_MAX_SCORE 30000
+
+// Workers write whole records in chunks no larger than PIPE_BUF, which are
+// atomic on pipes; files are opened for appending, so chunks of several
+// workers never interleave
+#define DATAGEN_CHUNK_RECORDS (PIPE_BUF / sizeof(DataRecord))
+
+// Each worker skips positions it has already recorded recently; the set is
+// cleared when three quarters full
+#define DATAGEN_SEEN_BITS 20
+
+typedef struct {
+    const char* out_path;   // "-" for standard output
+    int workers;
+    uint64_t games;
+    uint64_t nodes;
+    int random_plies;
+    int max_plies;
+    int hash_mb;
+    uint64_t seed;
+} DatagenConfig;
+
+// Totals of one worker, sent to the parent process when it is done
+typedef struct {
+    uint64_t games;
+    uint64_t positions;
+    uint64_t duplicates;
+    uint64_t results[3];    // Red wins, draws, Black wins
+    uint64_t plies;
+    bool failed;            // Output could not be written
+} WorkerStats;
+
+typedef struct {
+    uint64_t* keys;
+    size_t mask;
+    size_t count;
+} KeySet;
+
+static DatagenConfig config;
+
+// --- Random Numbers ---
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// --- Key Sets ---
+
+static bool init_key_set(KeySet* set, int bits) {
+    set->keys = (uint64_t*)calloc((size_t)1 << bits, sizeof(uint64_t));
+    set->mask = ((size_t)1 << bits) - 1;
+    set->count = 0;
+    return set->keys != NULL;
+}
+
+// Adds a key; returns false if it was already present. Key 0 marks free slots
+// and is never stored.
+static bool insert_key(KeySet* set, uint64_t key) {
+    if (key == 0) {
+        return true;
+    }
+    size_t i = (size_t)key & set->mask;
+    while (set->keys[i] != 0) {
+        if (set->keys[i] == key) {
+            return false;
+        }
+        i = (i + 1) & set->mask;
+    }
+    set->keys[i] = key;
+    set->count++;
+    return true;
+}
+
+// Doubles the table, for sets that must remember every key
+static bool grow_key_set(KeySet* set) {
+    KeySet grown;
+    size_t bits = 0;
+    while (((size_t)1 << bits) <= set->mask) bits++;
+    if (!init_key_set(&grown, (int)bits + 1)) {
+        return false;
+    }
+    for (size_t i = 0; i <= set->mask; ++i) {
+        insert_key(&grown, set->keys[i]);
+    }
+    free(set->keys);
+    *set = grown;
+    return true;
+}
+
+// --- Output ---
+
+// Writes all bytes, retrying after interrupts and partial writes
+static bool write_all(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static int open_output(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        return STDOUT_FILENO;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+// --- Records ---
+
+static uint16_t pack_move(Move move) {
+    return (uint16_t)(move.from_sq << 7 | move.to_sq);
+}
+
+// Returns false for a board the record cannot hold
+static bool fill_record(const Board* board, int score, int ply, Move best_move, DataRecord* record) {
+    memset(record, 0, sizeof(*record));
+    record->hash_key = board->hash_key;
+    if (!encode_position(board, &record->position)) {
+        return false;
+    }
+    if (score > DATAGEN_MAX_SCORE) score = DATAGEN_MAX_SCORE;
+    if (score < -DATAGEN_MAX_SCORE) score = -DATAGEN_MAX_SCORE;
+    record->score = (int16_t)score;
+    record->ply = (uint16_t)ply;
+    record->best_move = pack_move(best_move);
+    record->side_to_move = (int8_t)board->player_to_move;
+    return true;
+}
+
+// --- Self-Play ---
+
+typedef struct {
+    int fd;
+    DataRecord chunk[DATAGEN_CHUNK_RECORDS];
+    size_t chunk_count;
+    DataRecord game_records[DATAGEN_MAX_PLIES];
+    KeySet seen;
+    WorkerStats stats;
+} Worker;
+
+static bool flush_chunk(Worker* worker) {
+    if (worker->chunk_count > 0
+        && !write_all(worker->fd, worker->chunk, worker->chunk_count * sizeof(DataRecord))) {
+        worker->stats.failed = true;
+        return false;
+    }
+    worker->chunk_count = 0;
+    return true;
+}
+
+// The board keeps a bounded repetition history; games track repetitions themselves
+static void play_move(Board* board, Move move) {
+    move_piece(board, move.from_sq, move.to_sq);
+    if (board->history_ply >= MAX_HISTORY / 2) {
+        trim_history(board, MAX_HISTORY / 4);
+    }
+}
+
+// Plays one game and appends its recorded positions. Returns false if the
+// output failed.
+static bool play_game(Worker* worker, uint64_t game_index) {
+    // Every game has its own random sequence, whichever worker plays it
+    uint64_t random_state = config.seed ^ (game_index * 0xD1B54A32D192ED03ULL);
+
+    Board board;
+    init_board(&board, NULL);
+    init_tt();
+    clear_history_table();
+
+    static uint64_t keys[DATAGEN_MAX_PLIES + 1];
+    int record_count = 0;
+    int ply = 0;
+    int result;                 // For Red: 1 win, 0 draw, -1 loss
+    int resign_plies = 0;
+    int resign_sign = 0;
+    SearchLimits limits = { .nodes = config.nodes };
+
+    for (;;) {
+        // In Xiangqi a side without legal moves loses, whether mated or stalemated
+        MoveList legal_moves;
+        generate_legal_moves(&board, &legal_moves);
+        if (legal_moves.count == 0) {
+            result = -board.player_to_move;
+            break;
+        }
+
+        // Threefold repetition is a draw; perpetual check and chase rules are not modeled
+        keys[ply] = board.hash_key;
+        int repetitions = 0;
+        for (int i = ply - 2; i >= 0; i -= 2) {
+            if (keys[i] == board.hash_key) repetitions++;
+        }
+        if (repetitions >= 2 || ply >= config.max_plies || endgame_is_draw(&board)) {
+            result = 0;
+            break;
+        }
+
+        // Random opening moves are not recorded
+        if (ply < config.random_plies) {
+            play_move(&board, legal_moves.moves[splitmix64(&random_state) % legal_moves.count]);
+            ply++;
+            continue;
+        }
+
+        Move move = search_position(&board, &limits);
+        int score, depth;
+        get_search_result(&score, &depth);
+
+        // Without a completed iteration (a node budget too small for depth 1)
+        // the move is only a fallback and the score no search score: play the
+        // move, but neither adjudicate nor record the position
+        bool has_score = (depth > 0 && (move.from_sq != 0 || move.to_sq != 0));
+        if (move.from_sq == 0 && move.to_sq == 0) {
+            move = legal_moves.moves[0];
+        }
+
+        if (has_score && (score > MATE_THRESHOLD || score < -MATE_THRESHOLD)) {
+            result = (score > 0) ? board.player_to_move : -board.player_to_move;
+            break;
+        }
+        int red_score = has_score ? score * board.player_to_move : 0;
+        int sign = (red_score >= DATAGEN_RESIGN_SCORE) - (red_score <= -DATAGEN_RESIGN_SCORE);
+        resign_plies = (sign != 0 && sign == resign_sign) ? resign_plies + 1 : (sign != 0);
+        resign_sign = sign;
+        if (resign_plies >= DATAGEN_RESIGN_PLIES) {
+            result = sign;
+            break;
+        }
+
+        // Quiet positions only: the score of a position in check or before a
+        // capture depends on tactics a static evaluation cannot see
+        if (has_score && board.board[move.to_sq] == EMPTY && !is_king_in_check(&board, board.player_to_move)) {
+            if (insert_key(&worker->seen, board.hash_key)) {
+                record_count += fill_record(&board, score, ply, move, &worker->game_records[record_count]);
+            } else {
+                worker->stats.duplicates++;
+            }
+        }
+
+        play_move(&board, move);
+        ply++;
+    }
+
+    if (worker->seen.count > worker->seen.mask / 4 * 3) {
+        memset(worker->seen.keys, 0, (worker->seen.mask + 1) * sizeof(uint64_t));
+        worker->seen.count = 0;
+    }
+
+    worker->stats.games++;
+    worker->stats.plies += ply;
+    worker->stats.results[1 - result]++;
+    for (int i = 0; i < record_count; ++i) {
+        DataRecord* record = &worker->game_records[i];
+        record->result = (int8_t)(result * record->side_to_move);
+        worker->chunk[worker->chunk_count++] = *record;
+        if (worker->chunk_count == DATAGEN_CHUNK_RECORDS && !flush_chunk(worker)) {
+            return false;
+        }
+    }
+    worker->stats.positions += record_count;
+    return true;
+}
+
+// Body of one worker process: plays games id, id + workers, ...
+static WorkerStats run_worker(int id) {
+    static Worker worker;
+    memset(&worker.stats, 0, sizeof(worker.stats));
+    worker.chunk_count = 0;
+
+    worker.fd = open_output(config.out_path);
+    if (worker.fd < 0 || !init_key_set(&worker.seen, DATAGEN_SEEN_BITS)) {
+        worker.stats.failed = true;
+        return worker.stats;
+    }
+    resize_tt(config.hash_mb);
+
+    for (uint64_t game = id; game < config.games; game += config.workers) {
+        if (!play_game(&worker, game)) {
+            break;
+        }
+    }
+    flush_chunk(&worker);
+    if (worker.fd != STDOUT_FILENO) {
+        close(worker.fd);
+    }
+    return worker.stats;
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// --- Generation ---
+
+static void print_usage() {
+    printf("Usage: xiangqi datagen [options]\n"
+           "  Plays self-play games and appends the quiet positions of every game, with the\n"
+           "  search score and the game result, as %d-byte records (see src/datagen.h).\n"
+           "  -out <file>       Data file to append to, - for standard output (default %s)\n"
+           "  -workers <n>      Worker processes (default: all cores)\n"
+           "  -games <n>        Games to play (default %d)\n"
+           "  -nodes <n>        Nodes per move (default %d)\n"
+           "  -random <n>       Random opening plies (default %d)\n"
+           "  -maxply <n>       Plies before a game is drawn (default %d)\n"
+           "  -hash <mb>        Hash table size per worker (default %d)\n"
+           "  -seed <n>         Random seed (default: from the clock)\n"
+           "Usage: xiangqi datagen dedup [options] <files...>\n"
+           "  Copies the records of the files (- for standard input), dropping those whose\n"
+           "  position key was already seen.\n"
+           "  -out <file>       Data file to append to, - for standard output (default %s)\n",
+           (int)sizeof(DataRecord), DATAGEN_DEFAULT_PATH, DATAGEN_DEFAULT_GAMES, DATAGEN_DEFAULT_NODES,
+           DATAGEN_DEFAULT_RANDOM_PLIES, DATAGEN_DEFAULT_MAX_PLIES, DATAGEN_DEFAULT_HASH_MB,
+           DATAGEN_DEFAULT_PATH);
+}
+
+static int run_generate(int argc, char* argv[]) {
+    config = (DatagenConfig){
+        .out_path = DATAGEN_DEFAULT_PATH,
+        .workers = (int)sysconf(_SC_NPROCESSORS_ONLN),
+        .games = DATAGEN_DEFAULT_GAMES,
+        .nodes = DATAGEN_DEFAULT_NODES,
+        .random_plies = DATAGEN_DEFAULT_RANDOM_PLIES,
+        .max_plies = DATAGEN_DEFAULT_MAX_PLIES,
+        .hash_mb = DATAGEN_DEFAULT_HASH_MB,
+        .seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32),
+    };
+
+    for (int i = 2; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-out") == 0 && remaining >= 1) {
+            config.out_path = argv[++i];
+        } else if (strcmp(option, "-workers") == 0 && remaining >= 1) {
+            config.workers = atoi(argv[++i]);
+        } else if (strcmp(option, "-games") == 0 && remaining >= 1) {
+            config.games = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(option, "-nodes") == 0 && remaining >= 1) {
+            config.nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(option, "-random") == 0 && remaining >= 1) {
+            config.random_plies = atoi(argv[++i]);
+        } else if (strcmp(option, "-maxply") == 0 && remaining >= 1) {
+            config.max_plies = atoi(argv[++i]);
+        } else if (strcmp(option, "-hash") == 0 && remaining >= 1) {
+            config.hash_mb = atoi(argv[++i]);
+        } else if (strcmp(option, "-seed") == 0 && remaining >= 1) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (config.workers < 1) config.workers = 1;
+    if (config.workers > DATAGEN_MAX_WORKERS) config.workers = DATAGEN_MAX_WORKERS;
+    if ((uint64_t)config.workers > config.games) config.workers = (int)(config.games > 0 ? config.games : 1);
+    if (config.nodes < 1) config.nodes = 1;
+    if (config.random_plies < 0) config.random_plies = 0;
+    if (config.max_plies < 1 || config.max_plies > DATAGEN_MAX_PLIES) config.max_plies = DATAGEN_MAX_PLIES;
+    if (config.hash_mb < 1) config.hash_mb = 1;
+
+    // With the data on standard output, progress goes to standard error
+    FILE* log = (strcmp(config.out_path, "-") == 0) ? stderr : stdout;
+
+    // Shared tables are initialized before the workers are forked
+    Board start_board;
+    init_board(&start_board, NULL);
+    init_move_generator();
+    init_endgames();
+    set_search_output(SEARCH_OUTPUT_NONE);
+    set_use_opening_book(false);
+
+    fprintf(log, "Playing %llu games on %d workers, %llu nodes per move, seed %llu\n",
+            (unsigned long long)config.games, config.workers, (unsigned long long)config.nodes,
+            (unsigned long long)config.seed);
+    fflush(NULL);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The search is one global engine, so every worker is a process of its own
+    pid_t pids[DATAGEN_MAX_WORKERS];
+    int stats_pipes[DATAGEN_MAX_WORKERS];
+    int started = 0;
+    for (int i = 0; i < config.workers; ++i) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            WorkerStats stats = run_worker(i);
+            write_all(fds[1], &stats, sizeof(stats));
+            _exit(stats.failed ? 1 : 0);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            break;
+        }
+        pids[started] = pid;
+        stats_pipes[started++] = fds[0];
+    }
+
+    WorkerStats total = { 0 };
+    int failed_workers = config.workers - started;
+    for (int i = 0; i < started; ++i) {
+        WorkerStats stats;
+        ssize_t size = read(stats_pipes[i], &stats, sizeof(stats));
+        close(stats_pipes[i]);
+        waitpid(pids[i], NULL, 0);
+        if (size != (ssize_t)sizeof(stats) || stats.failed) {
+            failed_workers++;
+        }
+        if (size != (ssize_t)sizeof(stats)) {
+            continue;
+        }
+        total.games += stats.games;
+        total.positions += stats.positions;
+        total.duplicates += stats.duplicates;
+        total.plies += stats.plies;
+        for (int r = 0; r < 3; ++r) {
+            total.results[r] += stats.results[r];
+        }
+    }
+
+    double seconds = elapsed_seconds(&start);
+    fprintf(log, "Games:     %llu (Red wins %llu, draws %llu, Black wins %llu), %.1f plies on average\n",
+            (unsigned long long)total.games, (unsigned long long)total.results[0],
+            (unsigned long long)total.results[1], (unsigned long long)total.results[2],
+            total.games > 0 ? (double)total.plies / total.games : 0.0);
+    fprintf(log, "Positions: %llu written (%llu bytes), %llu repeated skipped\n",
+            (unsigned long long)total.positions, (unsigned long long)(total.positions * sizeof(DataRecord)),
+            (unsigned long long)total.duplicates);
+    fprintf(log, "Time:      %.1f s, %.0f positions/s\n", seconds,
+            seconds > 0 ? total.positions / seconds : 0.0);
+    if (failed_workers > 0) {
+        fprintf(stderr, "%d workers failed\n", failed_workers);
+        return 1;
+    }
+    return 0;
+}
+
+// --- Deduplication ---
+
+static int run_dedup(int argc, char* argv[]) {
+    const char* out_path = DATAGEN_DEFAULT_PATH;
+    const char* paths[DATAGEN_MAX_FILES];
+    int file_count = 0;
+
+    for (int i = 3; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-out") == 0 && remaining >= 1) {
+            out_path = argv[++i];
+        } else if ((option[0] != '-' || strcmp(option, "-") == 0) && file_count < DATAGEN_MAX_FILES) {
+            paths[file_count++] = option;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (file_count == 0) {
+        print_usage();
+        return 1;
+    }
+    FILE* log = (strcmp(out_path, "-") == 0) ? stderr : stdout;
+
+    int out_fd = open_output(out_path);
+    KeySet seen;
+    if (out_fd < 0 || !init_key_set(&seen, DATAGEN_SEEN_BITS)) {
+        return 1;
+    }
+
+    static DataRecord buffer[4096];
+    static DataRecord kept[4096];
+    uint64_t read_count = 0, kept_count = 0;
+    bool ok = true;
+    for (int f = 0; f < file_count && ok; ++f) {
+        FILE* in = (strcmp(paths[f], "-") == 0) ? stdin : fopen(paths[f], "rb");
+        if (!in) {
+            fprintf(stderr, "Cannot open %s\n", paths[f]);
+            ok = false;
+            break;
+        }
+        size_t count;
+        while ((count = fread(buffer, sizeof(DataRecord), 4096, in)) > 0) {
+            size_t kept_in_buffer = 0;
+            for (size_t i = 0; i < count; ++i) {
+                // Kept below half full, as every key must be remembered
+                if (seen.count >= seen.mask / 2 && !grow_key_set(&seen)) {
+                    fprintf(stderr, "Out of memory\n");
+                    ok = false;
+                    break;
+                }
+                if (insert_key(&seen, buffer[i].hash_key)) {
+                    kept[kept_in_buffer++] = buffer[i];
+                }
+            }
+            read_count += count;
+            kept_count += kept_in_buffer;
+            if (!ok || !write_all(out_fd, kept, kept_in_buffer * sizeof(DataRecord))) {
+                ok = false;
+                break;
+            }
+        }
+        // A trailing partial record, e.g. of a file still being written, is ignored
+        if (ok && !feof(in)) {
+            fprintf(stderr, "Cannot read %s\n", paths[f]);
+            ok = false;
+        }
+        if (in != stdin) {
+            fclose(in);
+        }
+    }
+    if (out_fd != STDOUT_FILENO) {
+        close(out_fd);
+    }
+    free(seen.keys);
+
+    fprintf(log, "Records: %llu read, %llu written, %llu duplicates dropped\n",
+            (unsigned long long)read_count, (unsigned long long)kept_count,
+            (unsigned long long)(read_count - kept_count));
+    return ok ? 0 : 1;
+}
+
+int run_datagen(int argc, char* argv[]) {
+    if (argc > 2 && strcmp(argv[2], "dedup") == 0) {
+        return run_dedup(argc, argv);
+    }
+    return run_generate(argc, argv);
+}
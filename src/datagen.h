@@ -0,0 +1,32 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include "position_codec.h"
+#include <stdint.h>
+
+// Training data generator:
+//   "xiangqi datagen [options]" plays self-play games from randomized
+//   openings with a fixed node budget per move, on several worker processes
+//   (the search is one global engine per process), and appends the quiet
+//   positions of every game with their search score and the game result.
+//   "xiangqi datagen dedup [options] <files...>" copies records, dropping
+//   those whose position was already seen.
+// Returns the process exit code.
+int run_datagen(int argc, char* argv[]);
+
+// Data files are a plain sequence of fixed-size little-endian records
+// without a header, so that files can be appended to, concatenated, split
+// at any record boundary and streamed. The board uses the packed encoding
+// of position_codec.h.
+typedef struct {
+    uint64_t hash_key;      // Zobrist key of the position, for deduplication
+    PackedPosition position;
+    int16_t score;          // Search score for the side to move
+    uint16_t ply;           // Plies since the start position
+    uint16_t best_move;     // from_sq * 128 + to_sq
+    int8_t result;          // Game result for the side to move: 1 win, 0 draw, -1 loss
+    int8_t side_to_move;    // 1 Red, -1 Black
+    uint8_t reserved[4];
+} DataRecord;
+
+#endif // DATAGEN_H
@@ -0,0 +1,177 @@
+#include "endgame.h"
+#include <stdio.h>
+#include <string.h>
+
+// Open addressing table of recognizers; a material key is never 0 since
+// both kings are always on the board
+#define ENDGAME_SLOTS 1024
+
+static EndgameEntry entries[ENDGAME_SLOTS];
+
+static const char PIECE_LETTERS[] = "KABNRCP"; // By piece type, R_KING .. R_PAWN
+
+// Guards and bishops a side may have besides its king
+static const char* DEFENDERS[] = {"", "A", "AA", "B", "BB", "AB", "AAB", "ABB", "AABB"};
+#define DEFENDER_SETS 9
+
+// --- Table ---
+
+static int slot_of(uint64_t material_key) {
+    return (int)((material_key * 0x9e3779b97f4a7c15ULL) >> 54) & (ENDGAME_SLOTS - 1);
+}
+
+const EndgameEntry* probe_endgame(uint64_t material_key) {
+    for (int slot = slot_of(material_key); entries[slot].material_key != 0; slot = (slot + 1) & (ENDGAME_SLOTS - 1)) {
+        if (entries[slot].material_key == material_key) {
+            return &entries[slot];
+        }
+    }
+    return NULL;
+}
+
+bool endgame_is_draw(const Board* board) {
+    const EndgameEntry* entry = probe_endgame(board->material_key);
+    return entry != NULL && entry->is_draw != NULL && entry->is_draw(board, entry->strong_side);
+}
+
+// Material key of one side's pieces, given as letters (e.g. "KCA")
+static uint64_t side_key(int player, const char* pieces) {
+    uint64_t key = 0;
+    for (const char* p = pieces; *p; ++p) {
+        Piece type = (Piece)(strchr(PIECE_LETTERS, *p) - PIECE_LETTERS + 1);
+        key += material_key_unit(get_piece_to_bb_index(player == PLAYER_R ? type : -type));
+    }
+    return key;
+}
+
+// Registers a recognizer for both colors of the stronger side; the first
+// recognizer of a material key is kept
+static void add_endgame(const char* strong, const char* weak,
+                        bool (*is_draw)(const Board*, int), int (*evaluate)(const Board*, int, int)) {
+    for (int side = 0; side < 2; ++side) {
+        int strong_side = (side == 0) ? PLAYER_R : PLAYER_B;
+        uint64_t key = side_key(strong_side, strong) + side_key(-strong_side, weak);
+        if (probe_endgame(key) != NULL) {
+            continue;
+        }
+        int slot = slot_of(key);
+        while (entries[slot].material_key != 0) {
+            slot = (slot + 1) & (ENDGAME_SLOTS - 1);
+        }
+        entries[slot] = (EndgameEntry){key, strong_side, is_draw, evaluate};
+    }
+}
+
+// --- Recognizers ---
+
+static bool always_draw(const Board* board, int strong_side) {
+    (void)board;
+    (void)strong_side;
+    return true;
+}
+
+static int draw_score(const Board* board, int strong_side, int score) {
+    (void)board;
+    (void)strong_side;
+    (void)score;
+    return DRAW_VALUE;
+}
+
+static int known_win(const Board* board, int strong_side, int score) {
+    (void)board;
+    return score + strong_side * ENDGAME_KNOWN_WIN;
+}
+
+// Scales down the advantage of the stronger side, not that of the weaker
+static int scale_advantage(int score, int strong_side, int factor) {
+    return (score * strong_side > 0) ? score * factor / ENDGAME_SCALE_NORMAL : score;
+}
+
+// Wins that take a mistake of the defender, e.g. horse vs. one bishop
+static int hard_to_win(const Board* board, int strong_side, int score) {
+    (void)board;
+    return scale_advantage(score, strong_side, ENDGAME_SCALE_NORMAL / 4);
+}
+
+// Wins that are very rare, e.g. horse vs. two guards
+static int nearly_drawn(const Board* board, int strong_side, int score) {
+    (void)board;
+    return scale_advantage(score, strong_side, ENDGAME_SCALE_NORMAL / 16);
+}
+
+// Rows between the stronger side's pawn and the opponent's back rank
+static int pawn_rows_to_go(const Board* board, int strong_side) {
+    U128 pawns = board->piece_bitboards[get_piece_to_bb_index(strong_side == PLAYER_R ? R_PAWN : B_PAWN)];
+    int row = get_lsb_index(pawns) / 9;
+    return (strong_side == PLAYER_R) ? row : 9 - row;
+}
+
+// Pawn vs. king: a pawn on the opponent's last two rows can only move
+// sideways or onto the back rank and never mates
+static bool low_pawn(const Board* board, int strong_side) {
+    return pawn_rows_to_go(board, strong_side) <= 1;
+}
+
+// Pawn vs. king: won unless the pawn is low; from the third row a win takes
+// the help of the defender
+static int evaluate_pawn(const Board* board, int strong_side, int score) {
+    if (pawn_rows_to_go(board, strong_side) == 2) {
+        return nearly_drawn(board, strong_side, score);
+    }
+    return known_win(board, strong_side, score);
+}
+
+// Results below were checked against generated tablebases up to five
+// pieces, counting a side without legal moves as lost, and otherwise follow
+// endgame theory (e.g. a rook does not beat full guards and bishops).
+void init_endgames() {
+    memset(entries, 0, sizeof(entries));
+    char strong[16], weak[16];
+
+    for (int d = 0; d < DEFENDER_SETS; ++d) {
+        snprintf(weak, sizeof(weak), "K%s", DEFENDERS[d]);
+
+        // Neither side has a piece that can cross the river
+        for (int s = 0; s < DEFENDER_SETS; ++s) {
+            snprintf(strong, sizeof(strong), "K%s", DEFENDERS[s]);
+            add_endgame(strong, weak, always_draw, NULL);
+        }
+
+        // A cannon without a guard as a screen cannot mate
+        add_endgame("KC", weak, d == 0 ? always_draw : NULL, draw_score);
+        add_endgame("KCB", weak, d == 0 ? always_draw : NULL, draw_score);
+        add_endgame("KCBB", weak, d == 0 ? always_draw : NULL, draw_score);
+
+        // A lone horse wins against one guard, rarely against more defenders
+        // and not against three or four
+        if (d <= 1) {
+            add_endgame("KN", weak, NULL, known_win);
+        } else if (d == 3) {
+            add_endgame("KN", weak, NULL, hard_to_win);
+        } else if (d <= 5) {
+            add_endgame("KN", weak, NULL, nearly_drawn);
+        } else {
+            add_endgame("KN", weak, NULL, draw_score);
+        }
+
+        // A lone pawn only beats a bare king
+        if (d == 0) {
+            add_endgame("KP", weak, low_pawn, evaluate_pawn);
+        } else {
+            add_endgame("KP", weak, NULL, nearly_drawn);
+        }
+
+        // A lone rook beats anything short of full guards and bishops
+        add_endgame("KR", weak, NULL, d == DEFENDER_SETS - 1 ? hard_to_win : known_win);
+    }
+
+    // A cannon with a guard as a screen beats a bare king
+    for (int s = 1; s < DEFENDER_SETS; ++s) {
+        if (DEFENDERS[s][0] == 'A') {
+            snprintf(strong, sizeof(strong), "KC%s", DEFENDERS[s]);
+            add_endgame(strong, "K", NULL, known_win);
+        }
+    }
+    add_endgame("KCA", "KA", NULL, known_win);
+    add_endgame("KCA", "KB", NULL, known_win);
+}
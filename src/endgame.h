@@ -0,0 +1,40 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "bitboard.h"
+#include <stdbool.h>
+
+// Endgame recognizers: knowledge about material balances the evaluation
+// cannot see, e.g. that a lone cannon cannot mate or that a rook beats two
+// guards. Recognizers are looked up by the board's material key.
+
+// Scale factors for the advantage of the stronger side
+#define ENDGAME_SCALE_NORMAL 64
+#define ENDGAME_SCALE_DRAW 0
+
+// Added for the stronger side in endgames it is known to win
+#define ENDGAME_KNOWN_WIN 1000
+
+// Recognizer of a material balance. strong_side is the player with the
+// winning chances (PLAYER_R or PLAYER_B).
+typedef struct {
+    uint64_t material_key;
+    int strong_side;
+    // Returns true if the position is a certain draw; NULL if it never is
+    bool (*is_draw)(const Board* board, int strong_side);
+    // Returns the evaluation of the position from Red's point of view, given
+    // the normal one; NULL to keep it
+    int (*evaluate)(const Board* board, int strong_side, int score);
+} EndgameEntry;
+
+// Builds the recognizer table; called once before searching
+void init_endgames();
+
+// Returns the recognizer of a material key, or NULL
+const EndgameEntry* probe_endgame(uint64_t material_key);
+
+// True if the material on the board can never win for either side in this
+// position. The search scores such positions as draws without searching.
+bool endgame_is_draw(const Board* board);
+
+#endif // ENDGAME_H
@@ -1,35 +1,351 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "engine.h"
 #include "evaluate.h"
+#include "endgame.h"
 #include "tt.h"
 #include "move.h"
 #include "opening_book.h"
+#include "tablebase.h"
+#include <pthread.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 
-// History table for move ordering
-int history_table[14][90];
+// Move ordering state of the main searcher
+static SearchContext search_context;
+
+// Set by stop_search(), possibly from another thread
+static atomic_bool stop_requested;
+
+// Background search started by search_async()
+static pthread_t search_thread;
+static Board async_board;
+static SearchLimits async_limits;
+static SearchDoneCallback async_on_done;
+static Move async_result;
+
+// Lazy SMP: helper threads search the same position with their own context
+// and share only the transposition table. Contexts are allocated on demand
+// by set_search_threads() and kept for the lifetime of the process.
+typedef struct {
+    SearchContext* ctx;
+    Board board;
+    int max_depth;
+    int id;
+    pthread_t thread;
+} HelperSearch;
+
+static HelperSearch helpers[MAX_SEARCH_THREADS - 1];
+static int helper_count = 0;
+static atomic_bool helpers_stop;                                // Set when the main search finishes
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER; // Guards published_stats
+
+static int output_mode = SEARCH_OUTPUT_TEXT;
+static long last_info_time; // Time of the last periodic progress line
+static bool use_opening_book = true;
+static bool book_opened = false; // The default book is opened by the first search that uses it
+static SearchStats last_search_stats;
+static int last_search_score;
+static int last_search_depth;
+
+void set_search_output(int mode) {
+    output_mode = mode;
+}
+
+void set_use_opening_book(bool enabled) {
+    use_opening_book = enabled;
+}
+
+bool set_opening_book(const char* path) {
+    book_opened = true;
+    return load_opening_book(path);
+}
+
+void get_search_stats(SearchStats* stats) {
+    *stats = last_search_stats;
+}
+
+void get_search_result(int* score, int* depth) {
+    *score = last_search_score;
+    *depth = last_search_depth;
+}
+
+static inline bool protocol_output() {
+    return output_mode == SEARCH_OUTPUT_UCCI || output_mode == SEARCH_OUTPUT_UCI;
+}
+
+SearchParams search_params = {
+    .rfp_max_depth = 3,
+    .rfp_margin = 90,
+    .futility_max_depth = 3,
+    .futility_base = 60,
+    .futility_margin = 110,
+    .razor_max_depth = 2,
+    .razor_base = 200,
+    .razor_margin = 150,
+    .singular_min_depth = 6,
+    .singular_margin = 2,
+    .probcut_min_depth = 5,
+    .probcut_margin = 200,
+    .probcut_reduction = 4,
+    .iid_mode = IID_MODE_REDUCTION,
+    .iid_min_depth = 4,
+    .lmr_base = 75,
+    .lmr_divisor = 225,
+    .lmr_history_divisor = 8192,
+    .delta_margin = 200,
+};
+
+// Name table for setting parameters at runtime (tuning, match parameter sets)
+static const struct {
+    const char* name;
+    int* value;
+} SEARCH_PARAM_TABLE[] = {
+    {"rfp_max_depth", &search_params.rfp_max_depth},
+    {"rfp_margin", &search_params.rfp_margin},
+    {"futility_max_depth", &search_params.futility_max_depth},
+    {"futility_base", &search_params.futility_base},
+    {"futility_margin", &search_params.futility_margin},
+    {"razor_max_depth", &search_params.razor_max_depth},
+    {"razor_base", &search_params.razor_base},
+    {"razor_margin", &search_params.razor_margin},
+    {"singular_min_depth", &search_params.singular_min_depth},
+    {"singular_margin", &search_params.singular_margin},
+    {"probcut_min_depth", &search_params.probcut_min_depth},
+    {"probcut_margin", &search_params.probcut_margin},
+    {"probcut_reduction", &search_params.probcut_reduction},
+    {"iid_mode", &search_params.iid_mode},
+    {"iid_min_depth", &search_params.iid_min_depth},
+    {"lmr_base", &search_params.lmr_base},
+    {"lmr_divisor", &search_params.lmr_divisor},
+    {"lmr_history_divisor", &search_params.lmr_history_divisor},
+    {"delta_margin", &search_params.delta_margin},
+};
+
+#define SEARCH_PARAM_COUNT (int)(sizeof(SEARCH_PARAM_TABLE) / sizeof(SEARCH_PARAM_TABLE[0]))
+
+bool set_search_param(const char* name, int value) {
+    for (int i = 0; i < SEARCH_PARAM_COUNT; ++i) {
+        if (strcmp(SEARCH_PARAM_TABLE[i].name, name) == 0) {
+            *SEARCH_PARAM_TABLE[i].value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_search_params() {
+    for (int i = 0; i < SEARCH_PARAM_COUNT; ++i) {
+        printf("%s %d\n", SEARCH_PARAM_TABLE[i].name, *SEARCH_PARAM_TABLE[i].value);
+    }
+}
+
+// Late move reduction table, indexed by [depth][move_index]
+static int lmr_table[MAX_PLY][MAX_MOVES];
+
+// Moves searched at a node before late move reductions may apply
+#define LMR_MIN_MOVES 3
+
+// Rebuilds the LMR table from the current parameters; the reduction grows
+// with the product of the logarithms of depth and move index.
+static void init_lmr_table() {
+    for (int depth = 1; depth < MAX_PLY; ++depth) {
+        for (int move_index = 1; move_index < MAX_MOVES; ++move_index) {
+            double reduction = search_params.lmr_base / 100.0
+                + log(depth) * log(move_index) / (search_params.lmr_divisor / 100.0);
+            lmr_table[depth][move_index] = (int)reduction;
+        }
+    }
+}
+
+// Move ordering scores; captures (MVV-LVA) always rank above these
+#define KILLER_1_SCORE 90000
+#define KILLER_2_SCORE 89000
+#define COUNTERMOVE_SCORE 88000
+
+// Score of a tablebase win at distance 0; below every mate score
+#define TB_WIN_SCORE (MATE_THRESHOLD - 1)
+
+// Scores beyond this bound are mate or tablebase scores, which static
+// pruning margins must not be applied to
+#define TB_WIN_THRESHOLD (TB_WIN_SCORE - MAX_PLY - TB_MAX_DTM)
 
 void clear_history_table() {
-    memset(history_table, 0, sizeof(history_table));
+    memset(&search_context, 0, sizeof(search_context));
+    for (int i = 0; i < helper_count; ++i) {
+        memset(helpers[i].ctx, 0, sizeof(SearchContext));
+        helpers[i].ctx->is_helper = true;
+    }
 }
 
-// Helper to score a move for move ordering
-static int score_move(Board* board, Move move) {
-    // Prioritize TT best move if available (not yet implemented here)
+int set_search_threads(int count) {
+    if (count < 1) count = 1;
+    if (count > MAX_SEARCH_THREADS) count = MAX_SEARCH_THREADS;
 
-    // MVV-LVA (Most Valuable Victim - Least Valuable Aggressor)
-    Piece captured_piece = board->board[move.to_sq];
-    if (captured_piece != EMPTY) {
-        Piece moving_piece = board->board[move.from_sq];
-        // Score = 1000 * abs(captured_value) - abs(moving_value)
-        return 1000 * get_piece_value(captured_piece) - get_piece_value(moving_piece);
+    for (int i = 0; i < count - 1; ++i) {
+        if (helpers[i].ctx == NULL) {
+            helpers[i].ctx = (SearchContext*)calloc(1, sizeof(SearchContext));
+            if (helpers[i].ctx == NULL) {
+                count = i + 1; // Out of memory: run with the helpers we have
+                break;
+            }
+            helpers[i].ctx->is_helper = true;
+        }
+    }
+    helper_count = count - 1;
+    set_tt_threads(count);
+    return count;
+}
+
+// Halves all history scores so that knowledge from earlier moves fades out
+// instead of being discarded. Killers belong to the plies of the previous
+// search and are cleared.
+static void age_history_tables(SearchContext* ctx) {
+    int16_t* history = &ctx->history_table[0][0];
+    for (size_t i = 0; i < sizeof(ctx->history_table) / sizeof(int16_t); ++i) {
+        history[i] /= 2;
+    }
+    int16_t* continuation = &ctx->continuation_history[0][0][0][0];
+    for (size_t i = 0; i < sizeof(ctx->continuation_history) / sizeof(int16_t); ++i) {
+        continuation[i] /= 2;
+    }
+    memset(ctx->killers, 0, sizeof(ctx->killers));
+}
+
+// Returns the search stack entry for the given ply (ply may be -1 or -2)
+static inline SearchStackEntry* stack_at(SearchContext* ctx, int ply) {
+    return &ctx->stack[ply + STACK_OFFSET];
+}
+
+// History bonus (or penalty) for a move searched at the given depth
+static inline int history_bonus(int depth) {
+    int bonus = 32 * depth * depth;
+    return (bonus < 1600) ? bonus : 1600;
+}
+
+// Gravity-style update: the closer an entry already is to +/-HISTORY_MAX, the
+// smaller the effect of a bonus pushing it further, so scores stay bounded.
+static inline void update_history_entry(int16_t* entry, int bonus) {
+    *entry += bonus - *entry * abs(bonus) / HISTORY_MAX;
+}
+
+// Applies a bonus to the butterfly history and to the continuation history
+// of the previous one and two moves.
+static void update_quiet_history(SearchContext* ctx, const Board* board, int ply, Move move, int bonus) {
+    int piece_idx = get_piece_to_bb_index(board->board[move.from_sq]);
+    update_history_entry(&ctx->history_table[piece_idx][move.to_sq], bonus);
+
+    for (int back = 1; back <= 2; ++back) {
+        const SearchStackEntry* prev = stack_at(ctx, ply - back);
+        if (prev->piece_idx >= 0) {
+            update_history_entry(&ctx->continuation_history[prev->piece_idx][prev->move.to_sq][piece_idx][move.to_sq], bonus);
+        }
+    }
+}
+
+// Called when a quiet move causes a beta cutoff: rewards the move as killer,
+// countermove and in the history tables, and penalizes the quiet moves that
+// were searched before it and failed.
+static void update_quiet_stats(SearchContext* ctx, const Board* board, int ply, int depth,
+                               Move best_move, const Move* quiets_tried, int quiet_count) {
+    if (!is_same_move(ctx->killers[ply][0], best_move)) {
+        ctx->killers[ply][1] = ctx->killers[ply][0];
+        ctx->killers[ply][0] = best_move;
     }
 
-    // History heuristic
+    const SearchStackEntry* prev = stack_at(ctx, ply - 1);
+    if (prev->piece_idx >= 0) {
+        ctx->countermoves[prev->piece_idx][prev->move.to_sq] = best_move;
+    }
+
+    int bonus = history_bonus(depth);
+    update_quiet_history(ctx, board, ply, best_move, bonus);
+    for (int i = 0; i < quiet_count; ++i) {
+        update_quiet_history(ctx, board, ply, quiets_tried[i], -bonus);
+    }
+}
+
+// Combined butterfly and continuation history score of a quiet move
+static int quiet_history_score(SearchContext* ctx, const Board* board, Move move, int ply) {
+    int piece_idx = get_piece_to_bb_index(board->board[move.from_sq]);
+    int score = ctx->history_table[piece_idx][move.to_sq];
+    for (int back = 1; back <= 2; ++back) {
+        const SearchStackEntry* prev = stack_at(ctx, ply - back);
+        if (prev->piece_idx >= 0) {
+            score += ctx->continuation_history[prev->piece_idx][prev->move.to_sq][piece_idx][move.to_sq];
+        }
+    }
+    return score;
+}
+
+// MVV-LVA (Most Valuable Victim - Least Valuable Aggressor) score of a capture
+static int score_capture(const Board* board, Move move) {
+    Piece captured_piece = board->board[move.to_sq];
     Piece moving_piece = board->board[move.from_sq];
-    return history_table[get_piece_to_bb_index(moving_piece)][move.to_sq];
+    // Score = 1000 * abs(captured_value) - abs(moving_value)
+    return 1000 * get_piece_value(captured_piece) - get_piece_value(moving_piece);
+}
+
+// Helper to score a move for move ordering: captures by MVV-LVA, then killers,
+// the countermove, and the remaining quiet moves by their history scores.
+static int score_move(SearchContext* ctx, const Board* board, Move move, int ply) {
+    if (board->board[move.to_sq] != EMPTY) {
+        return score_capture(board, move);
+    }
+
+    if (is_same_move(move, ctx->killers[ply][0])) {
+        return KILLER_1_SCORE;
+    }
+    if (is_same_move(move, ctx->killers[ply][1])) {
+        return KILLER_2_SCORE;
+    }
+
+    const SearchStackEntry* prev = stack_at(ctx, ply - 1);
+    if (prev->piece_idx >= 0 && is_same_move(move, ctx->countermoves[prev->piece_idx][prev->move.to_sq])) {
+        return COUNTERMOVE_SCORE;
+    }
+
+    return quiet_history_score(ctx, board, move, ply);
+}
+
+// Counts a node and polls the clock every TIME_CHECK_INTERVAL nodes.
+// Returns true once the search has been aborted; callers then unwind
+// immediately and their (meaningless) scores are discarded.
+static void print_progress();
+
+// Checks the limits that only the main searcher enforces; called every
+// TIME_CHECK_INTERVAL nodes.
+static void check_main_limits(SearchContext* ctx) {
+    if (time_hard_limit_reached()) {
+        ctx->stopped = true;
+    }
+    if (protocol_output() && time_elapsed() - last_info_time >= 1000) {
+        print_progress();
+    }
+}
+
+static inline bool search_aborted(SearchContext* ctx) {
+    if (ctx->is_helper) {
+        ++ctx->stats.nodes;
+        if (atomic_load_explicit(&helpers_stop, memory_order_relaxed)) {
+            ctx->stopped = true;
+        }
+    } else {
+        if ((++ctx->stats.nodes & (TIME_CHECK_INTERVAL - 1)) == 0) {
+            check_main_limits(ctx);
+        }
+        if (ctx->stats.nodes >= ctx->node_limit) {
+            ctx->stopped = true;
+        }
+    }
+    if (atomic_load_explicit(&stop_requested, memory_order_relaxed)) {
+        ctx->stopped = true;
+    }
+    return ctx->stopped;
 }
 
 // Comparison function for qsort
@@ -39,14 +355,47 @@ static int compare_moves(const void* a, const void* b) {
     return sm_b->score - sm_a->score; // Descending order
 }
 
-// Quiescence search to evaluate noisy positions
-static int quiescence_search(Board* board, int alpha, int beta) {
-    // Evaluate the current position statically
-    int stand_pat = evaluate(board);
+static int quiescence_search(SearchContext* ctx, Board* board, int ply, int alpha, int beta);
+
+// Quiescence search to evaluate noisy positions, given the TT probe of the
+// position (by the caller when it has probed already, e.g. negamax at depth 0)
+static int quiescence_search_probed(SearchContext* ctx, Board* board, int ply, int alpha, int beta,
+                                    bool tt_hit, const TTEntry* tt_entry) {
+    if (search_aborted(ctx)) {
+        return 0;
+    }
+    ctx->stats.qnodes++;
+    if (ply > ctx->stats.seldepth) {
+        ctx->stats.seldepth = ply;
+    }
+
+    // --- Transposition Table Cutoff ---
+    // Every stored entry is at least as deep as the quiescence search (TT_DEPTH_QS)
+    Move tt_best_move = {0, 0};
+    if (tt_hit) {
+        if (tt_entry->flag == TT_EXACT
+            || (tt_entry->flag == TT_LOWER && tt_entry->score >= beta)
+            || (tt_entry->flag == TT_UPPER && tt_entry->score <= alpha)) {
+            ctx->stats.tt_cutoffs++;
+            return tt_entry->score;
+        }
+        tt_best_move = tt_entry->best_move;
+    }
+
+    // Evaluate the current position statically, unless the TT already knows the evaluation
+    int stand_pat = (tt_hit && tt_entry->eval != TT_EVAL_NONE) ? tt_entry->eval : evaluate(board);
 
     if (stand_pat >= beta) {
+        store_tt_entry(board->hash_key, TT_DEPTH_QS, beta, stand_pat, TT_LOWER, (Move){0, 0});
         return beta;
     }
+
+    // Big delta: not even capturing a rook could bring the score up to alpha
+    if (stand_pat + get_piece_value(R_ROOK) + search_params.delta_margin < alpha) {
+        return alpha;
+    }
+
+    int original_alpha = alpha;
     if (stand_pat > alpha) {
         alpha = stand_pat;
     }
@@ -54,33 +403,62 @@ static int quiescence_search(Board* board, int alpha, int beta) {
     MoveList capture_moves;
     generate_capture_moves(board, &capture_moves);
 
-    // Sort capture moves (MVV-LVA)
+    // Sort capture moves (TT move first, then MVV-LVA)
     ScoredMove scored_capture_moves[MAX_MOVES];
     for (int i = 0; i < capture_moves.count; ++i) {
         scored_capture_moves[i].move = capture_moves.moves[i];
-        scored_capture_moves[i].score = score_move(board, capture_moves.moves[i]); // Depth 0 for captures
+        if (is_same_move(capture_moves.moves[i], tt_best_move)) {
+            scored_capture_moves[i].score = 1000000;
+        } else {
+            scored_capture_moves[i].score = score_capture(board, capture_moves.moves[i]);
+        }
     }
     qsort(scored_capture_moves, capture_moves.count, sizeof(ScoredMove), compare_moves);
 
+    Move best_move = {0, 0};
     for (int i = 0; i < capture_moves.count; ++i) {
         Move move = scored_capture_moves[i].move;
+
+        // Delta pruning: the captured piece plus a margin cannot lift the score to alpha
+        if (stand_pat + get_piece_value(board->board[move.to_sq]) + search_params.delta_margin <= alpha) {
+            continue;
+        }
+
         Piece captured = move_piece(board, move.from_sq, move.to_sq);
+        prefetch_tt(board->hash_key);
 
-        int score = -quiescence_search(board, -beta, -alpha);
+        int score = -quiescence_search(ctx, board, ply + 1, -beta, -alpha);
 
         unmove_piece(board, move.from_sq, move.to_sq, captured);
 
+        if (ctx->stopped) {
+            return 0;
+        }
+
         if (score >= beta) {
+            store_tt_entry(board->hash_key, TT_DEPTH_QS, beta, stand_pat, TT_LOWER, move);
             return beta;
         }
         if (score > alpha) {
             alpha = score;
+            best_move = move;
         }
     }
 
+    store_tt_entry(board->hash_key, TT_DEPTH_QS, alpha, stand_pat, (alpha > original_alpha) ? TT_EXACT : TT_UPPER, best_move);
     return alpha;
 }
 
+static int quiescence_search(SearchContext* ctx, Board* board, int ply, int alpha, int beta) {
+    TTEntry tt_entry;
+    bool tt_hit = probe_tt(board->hash_key, &tt_entry);
+    ctx->stats.tt_probes++;
+    if (tt_hit) {
+        ctx->stats.tt_hits++;
+    }
+    return quiescence_search_probed(ctx, board, ply, alpha, beta, tt_hit, &tt_entry);
+}
+
 // Helper to count major pieces for null move pruning
 static int get_major_piece_count(Board* board, int player) {
     int count = 0;
@@ -91,7 +469,17 @@ static int get_major_piece_count(Board* board, int player) {
 }
 
 // Negamax implementation with alpha-beta pruning
-static int negamax(Board* board, int depth, int alpha, int beta) {
+static int negamax(SearchContext* ctx, Board* board, int depth, int ply, int alpha, int beta) {
+    if (search_aborted(ctx)) {
+        return 0;
+    }
+    if (ply >= MAX_PLY) {
+        return evaluate(board);
+    }
+    if (ply > ctx->stats.seldepth) {
+        ctx->stats.seldepth = ply;
+    }
+
     // --- Repetition Detection ---
     // Check for 3-fold repetition (current position is the 3rd occurrence)
     if (board->history_ply >= 4) { // Need at least 4 plies to have 3 occurrences
@@ -106,102 +494,351 @@ static int negamax(Board* board, int depth, int alpha, int beta) {
         }
     }
 
+    // --- Endgame Recognizers ---
+    // Material that can never mate is a draw without searching further
+    if (ply > 0 && endgame_is_draw(board)) {
+        return DRAW_VALUE;
+    }
+
+    // A singular extension verification search excludes the TT move; its
+    // result is only valid for that search and must not touch the TT
+    Move excluded_move = stack_at(ctx, ply)->excluded_move;
+    bool has_excluded_move = (excluded_move.from_sq != 0 || excluded_move.to_sq != 0);
+
     // --- Transposition Table Probe ---
-    TTEntry* tt_entry = probe_tt(board->hash_key);
+    TTEntry tt_entry;
+    bool tt_hit = !has_excluded_move && probe_tt(board->hash_key, &tt_entry);
     Move tt_best_move = {0, 0};
+    int tt_depth = -1, tt_score = 0, tt_flag = TT_UPPER, tt_eval = TT_EVAL_NONE;
     int original_alpha = alpha;
 
-    if (tt_entry != NULL && tt_entry->depth >= depth) {
-        if (tt_entry->flag == TT_EXACT) {
-            return tt_entry->score;
-        } else if (tt_entry->flag == TT_LOWER) {
-            alpha = (alpha > tt_entry->score) ? alpha : tt_entry->score;
-        } else if (tt_entry->flag == TT_UPPER) {
-            beta = (beta < tt_entry->score) ? beta : tt_entry->score;
+    if (!has_excluded_move) {
+        ctx->stats.tt_probes++;
+    }
+    if (tt_hit) {
+        ctx->stats.tt_hits++;
+        tt_best_move = tt_entry.best_move;
+        tt_depth = tt_entry.depth;
+        tt_score = tt_entry.score;
+        tt_flag = tt_entry.flag;
+        tt_eval = tt_entry.eval;
+    }
+
+    if (tt_hit && tt_depth >= depth) {
+        if (tt_flag == TT_EXACT) {
+            ctx->stats.tt_cutoffs++;
+            return tt_score;
+        } else if (tt_flag == TT_LOWER) {
+            alpha = (alpha > tt_score) ? alpha : tt_score;
+        } else if (tt_flag == TT_UPPER) {
+            beta = (beta < tt_score) ? beta : tt_score;
         }
         if (alpha >= beta) {
-            return tt_entry->score;
+            ctx->stats.tt_cutoffs++;
+            return tt_score;
+        }
+    }
+
+    // --- Tablebase Probe ---
+    // Positions covered by an endgame table have a known result. Wins are
+    // scored below mate scores, shorter distances to mate first.
+    if (ply > 0 && !has_excluded_move && tablebase_max_pieces() > 0
+        && popcount(get_occupied_bitboard(board)) <= tablebase_max_pieces()) {
+        int tb_result, tb_dtm;
+        if (probe_tablebase(board, &tb_result, &tb_dtm)) {
+            ctx->stats.tb_hits++;
+            int tb_score = DRAW_VALUE;
+            if (tb_result != TB_DRAW) {
+                int distance = ply + (tb_dtm >= 0 ? tb_dtm : TB_MAX_DTM);
+                tb_score = (tb_result == TB_WIN) ? TB_WIN_SCORE - distance : -TB_WIN_SCORE + distance;
+            }
+            store_tt_entry(board->hash_key, depth, tb_score, TT_EVAL_NONE, TT_EXACT, (Move){0, 0});
+            return tb_score;
         }
-        tt_best_move = tt_entry->best_move; // Store TT best move
     }
 
+    // --- Check Extension ---
+    // A side in check is never left to the quiescence search, which does not
+    // generate evasions; forcing checking lines are searched one ply deeper.
+    bool is_in_check_val = is_king_in_check(board, board->player_to_move);
+    if (is_in_check_val) {
+        depth++;
+    }
+
+    // The TT has been probed for this node already, unless a move is excluded
     if (depth == 0) {
-        return quiescence_search(board, alpha, beta);
+        return has_excluded_move ? quiescence_search(ctx, board, ply, alpha, beta)
+                                 : quiescence_search_probed(ctx, board, ply, alpha, beta, tt_hit, &tt_entry);
+    }
+
+    bool is_pv_node = (beta - alpha > 1);
+
+    // --- Shallow-Depth Pruning ---
+    // Near the leaves, a static evaluation far outside the window is trusted.
+    // Never applied in check or when mate or tablebase scores are involved.
+    int static_eval = 0;
+    int eval_for_tt = TT_EVAL_NONE; // Stored with the result, when computed
+    bool can_prune_statically = !is_in_check_val && !has_excluded_move
+        && abs(alpha) < TB_WIN_THRESHOLD && abs(beta) < TB_WIN_THRESHOLD;
+    if (can_prune_statically) {
+        static_eval = (tt_eval != TT_EVAL_NONE) ? tt_eval : evaluate(board);
+        eval_for_tt = static_eval;
+
+        // Reverse futility (static null move) pruning: even after giving away
+        // a margin per remaining ply, we are still above beta
+        if (!is_pv_node && depth <= search_params.rfp_max_depth
+            && static_eval - search_params.rfp_margin * depth >= beta) {
+            return static_eval;
+        }
+
+        // Razoring: far below alpha, verify with quiescence search only
+        if (!is_pv_node && depth <= search_params.razor_max_depth
+            && static_eval + search_params.razor_base + search_params.razor_margin * depth < alpha) {
+            int razor_score = quiescence_search_probed(ctx, board, ply, alpha - 1, alpha, tt_hit, &tt_entry);
+            if (ctx->stopped) {
+                return 0;
+            }
+            if (razor_score < alpha) {
+                return razor_score;
+            }
+        }
     }
 
+    // Futility pruning: quiet moves at frontier nodes cannot raise a hopeless eval to alpha
+    bool futility_pruning = can_prune_statically && depth <= search_params.futility_max_depth
+        && static_eval + search_params.futility_base + search_params.futility_margin * depth <= alpha;
+
     // --- Null Move Pruning ---
     // If we can make a null move and still get a high score, we can prune this branch.
     // Conditions: not in check, depth is sufficient, and enough major pieces on board.
-    bool is_in_check_val = is_king_in_check(board, board->player_to_move);
-    if (!is_in_check_val && depth >= 3 && get_major_piece_count(board, board->player_to_move) > 1) {
+    if (!is_in_check_val && !has_excluded_move && depth >= 3 && get_major_piece_count(board, board->player_to_move) > 1) {
         board->player_to_move *= -1;
         board->hash_key ^= zobrist_player;
         board->history_ply++;
         board->history[board->history_ply] = board->hash_key;
+        stack_at(ctx, ply)->move = (Move){0, 0};
+        stack_at(ctx, ply)->piece_idx = -1;
+        ctx->stats.null_move_tries++;
 
-        int null_move_score = -negamax(board, depth - 1 - 2, -beta, -beta + 1); // R = 2
+        int null_move_score = -negamax(ctx, board, depth - 1 - 2, ply + 1, -beta, -beta + 1); // R = 2
 
         board->history_ply--;
         board->hash_key ^= zobrist_player;
         board->player_to_move *= -1;
 
+        if (ctx->stopped) {
+            return 0;
+        }
         if (null_move_score >= beta) {
+            ctx->stats.null_move_cutoffs++;
             // Store in TT (optional, but good for consistency)
-            store_tt_entry(board->hash_key, depth, beta, TT_LOWER, (Move){0,0});
+            store_tt_entry(board->hash_key, depth, beta, eval_for_tt, TT_LOWER, (Move){0,0});
             return beta;
         }
     }
 
+    // --- ProbCut ---
+    // If a good capture already beats a raised beta in a reduced search, the
+    // full-depth search would almost certainly fail high as well.
+    int probcut_beta = beta + search_params.probcut_margin;
+    if (!is_pv_node && can_prune_statically && depth >= search_params.probcut_min_depth
+        && abs(probcut_beta) < TB_WIN_THRESHOLD
+        && !(tt_depth >= depth - (search_params.probcut_reduction - 1) && tt_score < probcut_beta)) {
+        MoveList capture_moves;
+        generate_capture_moves(board, &capture_moves);
+
+        // MVV-LVA order, skipping captures that cannot reach probcut_beta even if unanswered
+        ScoredMove scored_capture_moves[MAX_MOVES];
+        int capture_count = 0;
+        for (int i = 0; i < capture_moves.count; ++i) {
+            Move move = capture_moves.moves[i];
+            if (static_eval + get_piece_value(board->board[move.to_sq]) < probcut_beta) {
+                continue;
+            }
+            scored_capture_moves[capture_count].move = move;
+            scored_capture_moves[capture_count].score = score_capture(board, move);
+            capture_count++;
+        }
+        qsort(scored_capture_moves, capture_count, sizeof(ScoredMove), compare_moves);
+
+        for (int i = 0; i < capture_count; ++i) {
+            Move move = scored_capture_moves[i].move;
+            stack_at(ctx, ply)->move = move;
+            stack_at(ctx, ply)->piece_idx = get_piece_to_bb_index(board->board[move.from_sq]);
+
+            int player = board->player_to_move;
+            Piece captured = move_piece(board, move.from_sq, move.to_sq);
+            if (is_king_in_check(board, player)) { // Capture generation is pseudo-legal
+                unmove_piece(board, move.from_sq, move.to_sq, captured);
+                continue;
+            }
+
+            // Cheap quiescence check first, then the reduced-depth search
+            int score = -quiescence_search(ctx, board, ply + 1, -probcut_beta, -probcut_beta + 1);
+            if (score >= probcut_beta) {
+                score = -negamax(ctx, board, depth - search_params.probcut_reduction, ply + 1, -probcut_beta, -probcut_beta + 1);
+            }
+
+            unmove_piece(board, move.from_sq, move.to_sq, captured);
+
+            if (ctx->stopped) {
+                return 0;
+            }
+            if (score >= probcut_beta) {
+                store_tt_entry(board->hash_key, depth - (search_params.probcut_reduction - 1), score, eval_for_tt, TT_LOWER, move);
+                return score;
+            }
+        }
+    }
+
+    // --- Internal Iterative Reduction / Deepening ---
+    // Without a TT move the first move is often poor and its subtree large.
+    // Either search the node one ply shallower (its result will provide a TT
+    // move for the next iteration), or run a shallow search now to obtain one.
+    bool has_tt_move = (tt_best_move.from_sq != 0 || tt_best_move.to_sq != 0);
+    if (!has_tt_move && !has_excluded_move && depth >= search_params.iid_min_depth) {
+        if (search_params.iid_mode == IID_MODE_REDUCTION) {
+            depth--;
+        } else if (search_params.iid_mode == IID_MODE_DEEPENING) {
+            negamax(ctx, board, depth - 2, ply, alpha, beta);
+            if (ctx->stopped) {
+                return 0;
+            }
+            TTEntry iid_entry;
+            if (probe_tt(board->hash_key, &iid_entry)) {
+                tt_best_move = iid_entry.best_move;
+            }
+        }
+    }
+
     MoveList move_list;
     generate_legal_moves(board, &move_list);
 
     if (move_list.count == 0) {
-        // Check for mate or stalemate
-        if (is_in_check_val) {
-            return -MATE_VALUE + depth; // Checkmate
-        } else {
-            return 0; // Stalemate
-        }
+        // In Xiangqi a side without legal moves loses, mated or stalemated,
+        // as the tablebases score it
+        return -MATE_VALUE + depth;
     }
 
     // --- Move Ordering ---
     ScoredMove scored_moves[MAX_MOVES];
+    bool tt_move_is_legal = false;
     for (int i = 0; i < move_list.count; ++i) {
         scored_moves[i].move = move_list.moves[i];
         // Give a huge bonus to the TT move
         if (move_list.moves[i].from_sq == tt_best_move.from_sq && move_list.moves[i].to_sq == tt_best_move.to_sq) {
             scored_moves[i].score = 1000000;
+            tt_move_is_legal = true;
         } else {
-            scored_moves[i].score = score_move(board, move_list.moves[i]);
+            scored_moves[i].score = score_move(ctx, board, move_list.moves[i], ply);
         }
     }
     qsort(scored_moves, move_list.count, sizeof(ScoredMove), compare_moves);
 
+    // --- Singular Extension ---
+    // Search all moves except the TT move at reduced depth against a bound below
+    // the TT score. If they all fail low, the TT move is singular and is extended.
+    // If they reach beta anyway, several moves beat beta and the node is cut (multi-cut).
+    bool tt_move_is_singular = false;
+    if (depth >= search_params.singular_min_depth && tt_move_is_legal && !has_excluded_move
+        && tt_depth >= depth - 3 && tt_flag != TT_UPPER && abs(tt_score) < MATE_THRESHOLD) {
+        int singular_beta = tt_score - search_params.singular_margin * depth;
+
+        stack_at(ctx, ply)->excluded_move = tt_best_move;
+        int singular_score = negamax(ctx, board, (depth - 1) / 2, ply, singular_beta - 1, singular_beta);
+        stack_at(ctx, ply)->excluded_move = (Move){0, 0};
+
+        if (ctx->stopped) {
+            return 0;
+        }
+        if (singular_score < singular_beta) {
+            tt_move_is_singular = true;
+        } else if (singular_beta >= beta) {
+            return singular_beta;
+        }
+    }
+
+    bool tt_move_is_capture = tt_move_is_legal && board->board[tt_best_move.to_sq] != EMPTY;
+
     int best_score = -MATE_VALUE;
     Move best_move_for_tt = {0,0};
+    Move quiets_tried[MAX_MOVES];
+    int quiet_count = 0;
+    int moves_searched = 0;
 
     for (int i = 0; i < move_list.count; ++i) {
         Move move = scored_moves[i].move;
         bool is_quiet = (board->board[move.to_sq] == EMPTY);
 
+        if (has_excluded_move && is_same_move(move, excluded_move)) {
+            continue;
+        }
+        int extension = (tt_move_is_singular && is_same_move(move, tt_best_move)) ? 1 : 0;
+        int new_depth = depth - 1 + extension;
+
         // --- Late Move Reduction (LMR) ---
+        // Base reduction from the logarithmic table, adjusted for the move's history,
+        // the node type and check status
         int reduction = 0;
-        if (depth >= 3 && i > 3 && is_quiet && !is_in_check_val) { // i > 3 means we are on the 5th move or later
-            reduction = 1;
+        if (depth >= 3 && moves_searched >= LMR_MIN_MOVES && is_quiet) {
+            reduction = lmr_table[depth < MAX_PLY ? depth : MAX_PLY - 1][moves_searched < MAX_MOVES ? moves_searched : MAX_MOVES - 1];
+            reduction -= quiet_history_score(ctx, board, move, ply) / search_params.lmr_history_divisor;
+            if (is_pv_node) reduction--;
+            if (is_in_check_val) reduction--;
+            if (tt_move_is_capture) reduction++; // Quiet moves rarely beat a capturing hash move
+            if (is_same_move(move, ctx->killers[ply][0]) || is_same_move(move, ctx->killers[ply][1])) reduction--;
         }
 
+        stack_at(ctx, ply)->move = move;
+        stack_at(ctx, ply)->piece_idx = get_piece_to_bb_index(board->board[move.from_sq]);
+
         Piece captured = move_piece(board, move.from_sq, move.to_sq);
+        prefetch_tt(board->hash_key);
+
+        // Skip futile quiet moves, but keep the first move and moves that give check
+        if (futility_pruning && is_quiet && i > 0 && !is_king_in_check(board, board->player_to_move)) {
+            unmove_piece(board, move.from_sq, move.to_sq, captured);
+            continue;
+        }
         
-        // Search with reduced depth first
-        int score = -negamax(board, depth - 1 - reduction, -beta, -alpha);
+        moves_searched++;
+
+        int score;
+        if (moves_searched == 1) {
+            // Principal variation search: only the first move gets the full window
+            score = -negamax(ctx, board, new_depth, ply + 1, -beta, -alpha);
+        } else {
+            // Moves that give check are not reduced
+            if (reduction > 0 && is_king_in_check(board, board->player_to_move)) {
+                reduction = 0;
+            }
+            if (reduction > new_depth - 1) reduction = new_depth - 1;
+            if (reduction < 0) reduction = 0;
+            if (reduction > 0) {
+                ctx->stats.lmr_reductions++;
+            }
+
+            // Null-window search, reduced if LMR applies
+            score = -negamax(ctx, board, new_depth - reduction, ply + 1, -alpha - 1, -alpha);
+
+            // A reduced move that beats alpha is first verified at full depth with a null window
+            if (reduction > 0 && score > alpha) {
+                ctx->stats.lmr_researches++;
+                score = -negamax(ctx, board, new_depth, ply + 1, -alpha - 1, -alpha);
+            }
 
-        // If LMR was used and the score was better than alpha, re-search with full depth
-        if (reduction > 0 && score > alpha) {
-            score = -negamax(board, depth - 1, -beta, -alpha);
+            // Only a move that lands inside the window needs the full-window re-search
+            if (score > alpha && score < beta) {
+                ctx->stats.pvs_researches++;
+                score = -negamax(ctx, board, new_depth, ply + 1, -beta, -alpha);
+            }
         }
         
         unmove_piece(board, move.from_sq, move.to_sq, captured);
 
+        if (ctx->stopped) {
+            return 0;
+        }
         if (score > best_score) {
             best_score = score;
             best_move_for_tt = move;
@@ -210,11 +847,24 @@ static int negamax(Board* board, int depth, int alpha, int beta) {
             alpha = best_score;
         }
         if (alpha >= beta) {
-            // Beta cutoff, update history table
-            Piece moving_piece = board->board[move.from_sq];
-            history_table[get_piece_to_bb_index(moving_piece)][move.to_sq] += depth * depth;
+            ctx->stats.beta_cutoffs++;
+            if (moves_searched == 1) {
+                ctx->stats.first_move_cutoffs++;
+            }
+            // Beta cutoff, reward the move and penalize the quiet moves that failed before it
+            if (is_quiet) {
+                update_quiet_stats(ctx, board, ply, depth, move, quiets_tried, quiet_count);
+            }
             break; 
         }
+        if (is_quiet && quiet_count < MAX_MOVES) {
+            quiets_tried[quiet_count++] = move;
+        }
+    }
+
+    if (has_excluded_move) {
+        // The excluded TT move was the only move; fail low for the verification search
+        return (moves_searched == 0) ? alpha : best_score;
     }
 
     // --- Transposition Table Store ---
@@ -224,101 +874,505 @@ static int negamax(Board* board, int depth, int alpha, int beta) {
     } else if (best_score >= beta) {
         flag = TT_LOWER;
     }
-    store_tt_entry(board->hash_key, depth, best_score, flag, best_move_for_tt);
+    store_tt_entry(board->hash_key, depth, best_score, eval_for_tt, flag, best_move_for_tt);
 
     return best_score;
 }
 
 Move search(Board* board, int max_depth, long time_limit_ms) {
-    clock_t start_time = clock();
+    SearchLimits limits = {0};
+    limits.depth = max_depth;
+    limits.movetime = time_limit_ms;
+    return search_position(board, &limits);
+}
 
-    // Load the opening book (should ideally be done only once)
-    static bool book_loaded = false;
-    if (!book_loaded) {
-        load_opening_book("opening_book.bin");
-        book_loaded = true;
+// Blocks a finished ponder or infinite search until the ponder-hit or a stop
+// arrives, so that its result is never used on the opponent's time.
+static void wait_while_pondering(const SearchLimits* limits) {
+    struct timespec pause = {0, 1000000}; // 1 ms
+    while ((time_is_pondering() || limits->infinite) && !atomic_load(&stop_requested)) {
+        nanosleep(&pause, NULL);
     }
+}
 
-    // Query the opening book
-    Move book_move = query_opening_book(board);
-    if (book_move.from_sq != 0 || book_move.to_sq != 0) {
-        printf("Move from opening book: %d -> %d\n", book_move.from_sq, book_move.to_sq);
-        return book_move;
+// --- Search Statistics ---
+
+// JSON Lines log of per-search statistics, NULL if disabled
+static FILE* stats_file = NULL;
+
+void set_search_stats_file(const char* path) {
+    if (stats_file) {
+        fclose(stats_file);
+        stats_file = NULL;
     }
+    if (path) {
+        stats_file = fopen(path, "a");
+        if (!stats_file) {
+            printf("Could not open search statistics file: %s\n", path);
+        }
+    }
+}
 
-    init_tt(); // Initialize TT at the start of each top-level search
-    clear_history_table(); // Clear history table at the start of each top-level search
+// Publishes a helper's statistics for merging by the main thread
+static void publish_search_stats(SearchContext* ctx) {
+    pthread_mutex_lock(&stats_mutex);
+    ctx->published_stats = ctx->stats;
+    pthread_mutex_unlock(&stats_mutex);
+}
 
-    Move best_move_overall = {0, 0};
-    int best_score_overall = -MATE_VALUE;
+// Merges the statistics of all searchers into total: the live counters of the
+// main thread and the last published snapshot of every helper.
+static void merge_search_stats(SearchStats* total) {
+    memset(total, 0, sizeof(*total));
+    pthread_mutex_lock(&stats_mutex);
+    for (int i = 0; i <= helper_count; ++i) {
+        const SearchStats* stats = (i == 0) ? &search_context.stats : &helpers[i - 1].ctx->published_stats;
+        total->nodes += stats->nodes;
+        total->qnodes += stats->qnodes;
+        total->tt_probes += stats->tt_probes;
+        total->tt_hits += stats->tt_hits;
+        total->tt_cutoffs += stats->tt_cutoffs;
+        total->beta_cutoffs += stats->beta_cutoffs;
+        total->first_move_cutoffs += stats->first_move_cutoffs;
+        total->null_move_tries += stats->null_move_tries;
+        total->null_move_cutoffs += stats->null_move_cutoffs;
+        total->lmr_reductions += stats->lmr_reductions;
+        total->lmr_researches += stats->lmr_researches;
+        total->pvs_researches += stats->pvs_researches;
+        total->tb_hits += stats->tb_hits;
+        if (stats->seldepth > total->seldepth) {
+            total->seldepth = stats->seldepth;
+        }
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
 
-    printf("Starting iterative deepening search up to depth %d or %ldms...\n", max_depth, time_limit_ms);
+// Periodic protocol line so that a GUI sees progress during long iterations
+static void print_progress() {
+    SearchStats stats;
+    merge_search_stats(&stats);
+    long elapsed = time_elapsed();
+    printf("info time %ld nodes %llu", elapsed, (unsigned long long)stats.nodes);
+    if (output_mode == SEARCH_OUTPUT_UCI) {
+        printf(" nps %llu", (unsigned long long)(stats.nodes * 1000 / (elapsed > 0 ? elapsed : 1)));
+    }
+    printf("\n");
+    fflush(stdout);
+    last_info_time = elapsed;
+}
 
-    for (int current_depth = 1; current_depth <= max_depth; ++current_depth) {
-        Move best_move_this_depth = {0, 0};
-        int best_score_this_depth = -MATE_VALUE;
-        int alpha = -MATE_VALUE;
-        int beta = MATE_VALUE;
+static inline double percentage(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
 
+// Prints the statistics line that follows each iteration's info line
+static void print_search_stats(const SearchStats* stats, long elapsed_ms, double ebf) {
+    printf("    Seldepth %d, Nodes %llu (%.1f%% qnodes), NPS %llu, EBF %.2f\n",
+           stats->seldepth, (unsigned long long)stats->nodes, percentage(stats->qnodes, stats->nodes),
+           (unsigned long long)(stats->nodes * 1000 / (elapsed_ms > 0 ? elapsed_ms : 1)), ebf);
+    printf("    TT hits %.1f%% (cutoffs %.1f%%), First-move cutoffs %.1f%%, Null move %llu/%llu, "
+           "LMR %llu (re-searched %.1f%%), PVS re-searches %llu\n",
+           percentage(stats->tt_hits, stats->tt_probes), percentage(stats->tt_cutoffs, stats->tt_probes),
+           percentage(stats->first_move_cutoffs, stats->beta_cutoffs),
+           (unsigned long long)stats->null_move_cutoffs, (unsigned long long)stats->null_move_tries,
+           (unsigned long long)stats->lmr_reductions, percentage(stats->lmr_researches, stats->lmr_reductions),
+           (unsigned long long)stats->pvs_researches);
+}
+
+// Appends the JSON record of a finished search to the statistics log
+static void log_search_stats(const SearchStats* stats, int depth, int score, Move best_move, long elapsed_ms, double ebf) {
+    if (!stats_file) {
+        return;
+    }
+    fprintf(stats_file,
+            "{\"depth\":%d,\"seldepth\":%d,\"score\":%d,\"from_sq\":%d,\"to_sq\":%d,\"time_ms\":%ld,"
+            "\"nodes\":%llu,\"qnodes\":%llu,\"nps\":%llu,\"ebf\":%.3f,"
+            "\"tt_probes\":%llu,\"tt_hits\":%llu,\"tt_cutoffs\":%llu,"
+            "\"beta_cutoffs\":%llu,\"first_move_cutoffs\":%llu,"
+            "\"null_move_tries\":%llu,\"null_move_cutoffs\":%llu,"
+            "\"lmr_reductions\":%llu,\"lmr_researches\":%llu,\"pvs_researches\":%llu,\"tb_hits\":%llu}\n",
+            depth, stats->seldepth, score, best_move.from_sq, best_move.to_sq, elapsed_ms,
+            (unsigned long long)stats->nodes, (unsigned long long)stats->qnodes,
+            (unsigned long long)(stats->nodes * 1000 / (elapsed_ms > 0 ? elapsed_ms : 1)), ebf,
+            (unsigned long long)stats->tt_probes, (unsigned long long)stats->tt_hits, (unsigned long long)stats->tt_cutoffs,
+            (unsigned long long)stats->beta_cutoffs, (unsigned long long)stats->first_move_cutoffs,
+            (unsigned long long)stats->null_move_tries, (unsigned long long)stats->null_move_cutoffs,
+            (unsigned long long)stats->lmr_reductions, (unsigned long long)stats->lmr_researches,
+            (unsigned long long)stats->pvs_researches, (unsigned long long)stats->tb_hits);
+    fflush(stats_file);
+}
+
+static Move think(Board* board, const SearchLimits* limits);
+
+Move search_position(Board* board, const SearchLimits* limits) {
+    atomic_store(&stop_requested, false);
+    time_start(limits->ponder);
+    return think(board, limits);
+}
+
+static void* search_thread_main(void* arg) {
+    (void)arg;
+    async_result = think(&async_board, &async_limits);
+    if (async_on_done) {
+        async_on_done(&async_board, async_result);
+    }
+    return NULL;
+}
+
+void search_async(const Board* board, const SearchLimits* limits, SearchDoneCallback on_done) {
+    copy_board(board, &async_board);
+    async_limits = *limits;
+    async_on_done = on_done;
+    // Cleared here rather than in the thread, so that a stop_search() issued
+    // right after this call cannot be lost
+    atomic_store(&stop_requested, false);
+    // Likewise the clock and ponder state, so that an early ponder-hit is kept
+    time_start(limits->ponder);
+    pthread_create(&search_thread, NULL, search_thread_main, NULL);
+}
+
+Move wait_search() {
+    pthread_join(search_thread, NULL);
+    return async_result;
+}
+
+void stop_search() {
+    atomic_store(&stop_requested, true);
+}
+
+Move get_ponder_move(Board* board, Move best_move) {
+    Move ponder_move = {0, 0};
+    if (best_move.from_sq == 0 && best_move.to_sq == 0) {
+        return ponder_move;
+    }
+
+    Piece captured = move_piece(board, best_move.from_sq, best_move.to_sq);
+    TTEntry tt_entry;
+    if (probe_tt(board->hash_key, &tt_entry)) {
+        // The entry may come from a hash collision, so only trust a legal move
         MoveList move_list;
         generate_legal_moves(board, &move_list);
-
-        if (move_list.count == 0) {
-            if (is_king_in_check(board, board->player_to_move)) {
-                best_score_overall = -MATE_VALUE; // Checkmate
-            } else {
-                best_score_overall = 0; // Stalemate
+        for (int i = 0; i < move_list.count; ++i) {
+            if (is_same_move(move_list.moves[i], tt_entry.best_move)) {
+                ponder_move = tt_entry.best_move;
+                break;
             }
-            break;
         }
+    }
+    unmove_piece(board, best_move.from_sq, best_move.to_sq, captured);
+    return ponder_move;
+}
 
-        ScoredMove scored_moves[MAX_MOVES];
-        for (int i = 0; i < move_list.count; ++i) {
-            scored_moves[i].move = move_list.moves[i];
-            scored_moves[i].score = score_move(board, move_list.moves[i]);
+// Resets the per-search state of a searcher; history persists between moves and is only aged
+static void prepare_context(SearchContext* ctx, uint64_t node_limit) {
+    age_history_tables(ctx);
+    for (int i = 0; i < STACK_OFFSET; ++i) {
+        ctx->stack[i].move = (Move){0, 0};
+        ctx->stack[i].piece_idx = -1;
+        ctx->stack[i].excluded_move = (Move){0, 0};
+    }
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    memset(&ctx->published_stats, 0, sizeof(ctx->published_stats));
+    ctx->node_limit = node_limit;
+    ctx->stopped = false;
+}
+
+// Searches all root moves to the given depth and returns the best score.
+// The best move of the previous iteration is searched first, so that an
+// iteration aborted by the clock still yields a usable result: *best_move is
+// set from completely searched moves only, and stays a null move otherwise.
+static int search_root(SearchContext* ctx, Board* board, const MoveList* root_moves, int depth,
+                       Move previous_best, Move* best_move) {
+    int alpha = -MATE_VALUE;
+    int beta = MATE_VALUE;
+    int best_score = -MATE_VALUE;
+    *best_move = (Move){0, 0};
+
+    ScoredMove scored_moves[MAX_MOVES];
+    for (int i = 0; i < root_moves->count; ++i) {
+        scored_moves[i].move = root_moves->moves[i];
+        if (is_same_move(root_moves->moves[i], previous_best)) {
+            scored_moves[i].score = 1000000;
+        } else {
+            scored_moves[i].score = score_move(ctx, board, root_moves->moves[i], 0);
+        }
+    }
+    qsort(scored_moves, root_moves->count, sizeof(ScoredMove), compare_moves);
+
+    for (int i = 0; i < root_moves->count; ++i) {
+        Move move = scored_moves[i].move;
+        stack_at(ctx, 0)->move = move;
+        stack_at(ctx, 0)->piece_idx = get_piece_to_bb_index(board->board[move.from_sq]);
+
+        Piece captured = move_piece(board, move.from_sq, move.to_sq);
+
+        int score = -negamax(ctx, board, depth - 1, 1, -beta, -alpha);
+
+        unmove_piece(board, move.from_sq, move.to_sq, captured);
+
+        if (ctx->stopped) {
+            break; // The move being searched is incomplete, discard it
         }
-        qsort(scored_moves, move_list.count, sizeof(ScoredMove), compare_moves);
+        if (score > best_score) {
+            best_score = score;
+            *best_move = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+    }
+    return best_score;
+}
+
+// Move played if no iteration completes, e.g. when a node limit or a stop
+// aborts the first one: the first root move in search order, with the static
+// evaluation of the position it leads to
+static Move fallback_root_move(SearchContext* ctx, Board* board, const MoveList* root_moves, int* score) {
+    Move best_move = root_moves->moves[0];
+    int best_order = score_move(ctx, board, best_move, 0);
+    for (int i = 1; i < root_moves->count; ++i) {
+        int order = score_move(ctx, board, root_moves->moves[i], 0);
+        if (order > best_order) {
+            best_order = order;
+            best_move = root_moves->moves[i];
+        }
+    }
+    Piece captured = move_piece(board, best_move.from_sq, best_move.to_sq);
+    *score = -evaluate(board);
+    unmove_piece(board, best_move.from_sq, best_move.to_sq, captured);
+    return best_move;
+}
+
+static void* helper_search_main(void* arg) {
+    HelperSearch* helper = (HelperSearch*)arg;
+    SearchContext* ctx = helper->ctx;
 
+    MoveList root_moves;
+    generate_legal_moves(&helper->board, &root_moves);
+
+    // Odd helpers start one ply deeper, so that the threads spread over
+    // different depths and fill the TT for each other
+    Move best_move = {0, 0};
+    for (int depth = 1 + helper->id % 2; depth <= helper->max_depth && !ctx->stopped; ++depth) {
+        Move best_move_this_depth;
+        search_root(ctx, &helper->board, &root_moves, depth, best_move, &best_move_this_depth);
+        if (best_move_this_depth.from_sq != 0 || best_move_this_depth.to_sq != 0) {
+            best_move = best_move_this_depth;
+        }
+        publish_search_stats(ctx);
+    }
+    publish_search_stats(ctx);
+    return NULL;
+}
+
+static void start_helper_searches(const Board* board, int max_depth) {
+    atomic_store(&helpers_stop, false);
+    for (int i = 0; i < helper_count; ++i) {
+        HelperSearch* helper = &helpers[i];
+        prepare_context(helper->ctx, UINT64_MAX);
+        copy_board(board, &helper->board);
+        helper->max_depth = max_depth;
+        helper->id = i + 1;
+        pthread_create(&helper->thread, NULL, helper_search_main, helper);
+    }
+}
+
+static void stop_helper_searches() {
+    atomic_store(&helpers_stop, true);
+    for (int i = 0; i < helper_count; ++i) {
+        pthread_join(helpers[i].thread, NULL);
+    }
+}
+
+// Follows the TT best moves from the root to build the principal variation.
+// Every move is checked for legality since entries may be overwritten or collide.
+static int extract_pv(Board* board, Move best_move, Move* pv, int max_length) {
+    Piece captured[MAX_PLY];
+    int length = 0;
+    Move move = best_move;
+
+    while (length < max_length) {
+        pv[length] = move;
+        captured[length] = move_piece(board, move.from_sq, move.to_sq);
+        length++;
+
+        TTEntry tt_entry;
+        if (!probe_tt(board->hash_key, &tt_entry)) {
+            break;
+        }
+        move = tt_entry.best_move;
+        MoveList move_list;
+        generate_legal_moves(board, &move_list);
+        bool legal = false;
         for (int i = 0; i < move_list.count; ++i) {
-            // Check time before processing each root move
-            if (time_limit_ms > 0) {
-                clock_t current_time = clock();
-                if ((long)((current_time - start_time) * 1000 / CLOCKS_PER_SEC) >= time_limit_ms) {
-                    goto time_up;
-                }
+            if (is_same_move(move_list.moves[i], move)) {
+                legal = true;
+                break;
             }
+        }
+        if (!legal) {
+            break;
+        }
+    }
 
-            Move move = scored_moves[i].move;
-            Piece captured = move_piece(board, move.from_sq, move.to_sq);
-            
-            int score = -negamax(board, current_depth - 1, -beta, -alpha);
-            
-            unmove_piece(board, move.from_sq, move.to_sq, captured);
+    for (int i = length - 1; i >= 0; --i) {
+        unmove_piece(board, pv[i].from_sq, pv[i].to_sq, captured[i]);
+    }
+    return length;
+}
 
-            if (score > best_score_this_depth) {
-                best_score_this_depth = score;
-                best_move_this_depth = move;
-            }
-            if (score > alpha) {
-                alpha = score;
-            }
+// Prints the protocol line of a completed iteration
+static void print_iteration_info(Board* board, int depth, int score, Move best_move, const SearchStats* stats) {
+    long elapsed = time_elapsed();
+    Move pv[MAX_PLY];
+    int pv_length = extract_pv(board, best_move, pv, depth);
+
+    if (output_mode == SEARCH_OUTPUT_UCCI) {
+        printf("info depth %d score %d time %ld nodes %llu pv",
+               depth, score, elapsed, (unsigned long long)stats->nodes);
+    } else {
+        printf("info depth %d seldepth %d score cp %d time %ld nodes %llu nps %llu hashfull %d",
+               depth, stats->seldepth, score, elapsed, (unsigned long long)stats->nodes,
+               (unsigned long long)(stats->nodes * 1000 / (elapsed > 0 ? elapsed : 1)), tt_hashfull());
+        if (tablebase_max_pieces() > 0) {
+            printf(" tbhits %llu", (unsigned long long)stats->tb_hits);
         }
-        
+        printf(" pv");
+    }
+    for (int i = 0; i < pv_length; ++i) {
+        char move_str[5];
+        move_to_string(pv[i], move_str);
+        printf(" %s", move_str);
+    }
+    printf("\n");
+    fflush(stdout);
+    last_info_time = elapsed;
+}
+
+static Move think(Board* board, const SearchLimits* limits) {
+    time_init(limits);
+    last_info_time = 0;
+    memset(&last_search_stats, 0, sizeof(last_search_stats));
+    last_search_score = 0;
+    last_search_depth = 0;
+
+    if (use_opening_book && !book_opened) {
+        set_opening_book(DEFAULT_BOOK_PATH);
+    }
+
+    Move book_move = use_opening_book ? query_opening_book(board) : (Move){0, 0};
+    if (book_move.from_sq != 0 || book_move.to_sq != 0) {
+        if (output_mode == SEARCH_OUTPUT_TEXT) {
+            printf("Move from opening book: %d -> %d\n", book_move.from_sq, book_move.to_sq);
+        } else if (protocol_output()) {
+            printf("info string book move\n");
+            fflush(stdout);
+        }
+        wait_while_pondering(limits);
+        return book_move;
+    }
+
+    // The TT is kept between searches, so a ponder miss still leaves it warm;
+    // entries of earlier searches are aged rather than cleared
+    tt_new_search();
+
+    init_lmr_table(); // Parameters may have changed since the last search
+
+    SearchContext* ctx = &search_context;
+    prepare_context(ctx, limits->nodes > 0 ? limits->nodes : UINT64_MAX);
+
+    int max_depth = (limits->depth > 0 && limits->depth < MAX_PLY) ? limits->depth : MAX_PLY - 1;
+    Move best_move_overall = {0, 0};
+    int best_score_overall = -MATE_VALUE;
+    int completed_depth = 0;
+
+    // Statistics merged over all searchers after each iteration
+    SearchStats stats = {0};
+    uint64_t previous_iteration_nodes = 0;
+    double ebf = 0.0; // Effective branching factor: nodes of an iteration / nodes of the previous one
+
+    MoveList root_moves;
+    generate_legal_moves(board, &root_moves);
+
+    if (root_moves.count == 0) {
+        best_score_overall = -MATE_VALUE; // Checkmate or stalemate, both lost
+        last_search_score = best_score_overall;
+        wait_while_pondering(limits);
+        return best_move_overall;
+    }
+
+    if (output_mode == SEARCH_OUTPUT_TEXT && !time_is_pondering()) {
+        printf("Starting iterative deepening search up to depth %d or %ldms...\n", max_depth, limits->movetime);
+    }
+
+    int fallback_score;
+    Move fallback_move = fallback_root_move(ctx, board, &root_moves, &fallback_score);
+
+    start_helper_searches(board, max_depth);
+
+    for (int current_depth = 1; current_depth <= max_depth; ++current_depth) {
+        Move best_move_this_depth;
+        int best_score_this_depth = search_root(ctx, board, &root_moves, current_depth,
+                                                best_move_overall, &best_move_this_depth);
+
+        bool best_move_changed = false;
+        int previous_score = best_score_overall;
         if (best_move_this_depth.from_sq != 0 || best_move_this_depth.to_sq != 0) {
+            best_move_changed = !is_same_move(best_move_this_depth, best_move_overall);
             best_move_overall = best_move_this_depth;
             best_score_overall = best_score_this_depth;
         }
 
-        printf("  Depth %d: Best score = %d, Best move = %d -> %d\n", 
-               current_depth, best_score_overall, best_move_overall.from_sq, best_move_overall.to_sq);
+        uint64_t nodes_before = stats.nodes;
+        merge_search_stats(&stats);
+
+        if (ctx->stopped) {
+            break;
+        }
+
+        completed_depth = current_depth;
+        uint64_t iteration_nodes = stats.nodes - nodes_before;
+        if (previous_iteration_nodes > 0) {
+            ebf = (double)iteration_nodes / previous_iteration_nodes;
+        }
+        previous_iteration_nodes = iteration_nodes;
+
+        if (protocol_output()) {
+            print_iteration_info(board, current_depth, best_score_overall, best_move_overall, &stats);
+        } else if (output_mode == SEARCH_OUTPUT_TEXT && !time_is_pondering()) {
+            long elapsed = time_elapsed();
+            printf("  Depth %d: Best score = %d, Best move = %d -> %d, Time = %ldms\n", 
+                   current_depth, best_score_overall, best_move_overall.from_sq, best_move_overall.to_sq, elapsed);
+            print_search_stats(&stats, elapsed, ebf);
+        }
 
         // If mate is found, no need to search deeper
-        if (abs(best_score_overall) > MATE_VALUE - 100) {
+        if (abs(best_score_overall) > MATE_THRESHOLD) {
+            break;
+        }
+
+        if (current_depth > 1) {
+            time_update_iteration(best_move_changed, best_score_overall, previous_score);
+        }
+        if (time_soft_limit_reached()) {
             break;
         }
     }
 
-time_up:
-    printf("Final Best score: %d\n", best_score_overall);
+    if (best_move_overall.from_sq == 0 && best_move_overall.to_sq == 0) {
+        best_move_overall = fallback_move;
+        best_score_overall = fallback_score;
+    }
+
+    wait_while_pondering(limits);
+    stop_helper_searches();
+    merge_search_stats(&stats);
+    last_search_stats = stats;
+    last_search_score = best_score_overall;
+    last_search_depth = completed_depth;
+    log_search_stats(&stats, completed_depth, best_score_overall, best_move_overall, time_elapsed(), ebf);
+    if (output_mode == SEARCH_OUTPUT_TEXT) {
+        printf("Final Best score: %d\n", best_score_overall);
+    }
     return best_move_overall;
 }
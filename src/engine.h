@@ -3,6 +3,7 @@
 
 #include "bitboard.h"
 #include "move.h"
+#include "timeman.h"
 #include <stdint.h>
 
 // Struct to hold a move and its score for move ordering
@@ -15,9 +16,155 @@ typedef struct {
 // Returns the best move found.
 Move search(Board* board, int max_depth, long time_limit_ms);
 
+// Searches the given position within the given depth and time limits.
+Move search_position(Board* board, const SearchLimits* limits);
 
-// History table for move ordering
-extern int history_table[14][90];
+// Called on the search thread when a background search finishes, with the
+// searched position and its best move.
+typedef void (*SearchDoneCallback)(Board* board, Move best_move);
+
+// Starts search_position() on a background thread with a private copy of the board.
+// on_done may be NULL.
+void search_async(const Board* board, const SearchLimits* limits, SearchDoneCallback on_done);
+
+// Waits for the background search to finish and returns its best move.
+Move wait_search();
+
+// Asks the running search to stop as soon as possible. Safe to call from any thread.
+void stop_search();
+
+// Appends one JSON record with the statistics of every search to the given
+// file (JSON Lines). NULL disables logging.
+void set_search_stats_file(const char* path);
+
+// Returns the expected reply to best_move from the transposition table,
+// or a null move {0,0} if none is known.
+Move get_ponder_move(Board* board, Move best_move);
+
+// Search progress output (set_search_output)
+#define SEARCH_OUTPUT_TEXT 0    // Human readable lines for the textual UI
+#define SEARCH_OUTPUT_UCCI 1    // UCCI "info" lines
+#define SEARCH_OUTPUT_UCI 2     // UCI "info" lines
+#define SEARCH_OUTPUT_NONE 3
+
+void set_search_output(int mode);
+
+// Enables or disables opening book moves (enabled by default).
+void set_use_opening_book(bool enabled);
+
+// Opens the opening book file (see opening_book.h), replacing the current
+// book. Without a call, the first search opens DEFAULT_BOOK_PATH. Returns
+// false if the file is missing or invalid; no book is used then.
+bool set_opening_book(const char* path);
+
+// Maximum number of search threads (Lazy SMP)
+#define MAX_SEARCH_THREADS 64
+
+// Sets the number of search threads, including the main one.
+// Returns the number actually available. Must not be called during a search.
+int set_search_threads(int count);
+
+
+// --- Move Ordering Heuristics ---
+
+// Maximum search ply tracked by the killer and search stacks
+#define MAX_PLY 64
+
+// History scores are kept within [-HISTORY_MAX, HISTORY_MAX] by the gravity update
+#define HISTORY_MAX 16384
+
+// Per-ply search stack entry; remembers which piece moved where so that
+// continuation history can be indexed by the previous one and two moves.
+typedef struct {
+    Move move;
+    int piece_idx;          // Bitboard index of the moving piece, -1 for a null move
+    Move excluded_move;     // Move skipped by a singular extension verification search
+} SearchStackEntry;
+
+// Number of sentinel entries below ply 0 so that ply - 1 and ply - 2 are always valid
+#define STACK_OFFSET 2
+
+// Search statistics of one searcher. Plain counters, only ever touched by
+// their own thread; totals are obtained by merging all searchers per iteration.
+typedef struct {
+    uint64_t nodes;                 // All nodes, including quiescence nodes
+    uint64_t qnodes;                // Quiescence search nodes
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t tt_cutoffs;
+    uint64_t beta_cutoffs;
+    uint64_t first_move_cutoffs;    // Beta cutoffs produced by the first move searched
+    uint64_t null_move_tries;
+    uint64_t null_move_cutoffs;
+    uint64_t lmr_reductions;        // Moves searched with a late move reduction
+    uint64_t lmr_researches;        // Reduced moves re-searched at full depth
+    uint64_t pvs_researches;        // Null-window searches re-searched with the full window
+    uint64_t tb_hits;               // Positions resolved by an endgame table
+    int seldepth;                   // Deepest ply reached
+} SearchStats;
+
+// Move ordering state of one searcher. It survives between moves and is only
+// aged (not cleared) at the start of each search.
+typedef struct {
+    Move killers[MAX_PLY][2];
+    Move countermoves[14][90];                      // [prev_piece][prev_to_sq]
+    int16_t history_table[14][90];                  // [piece][to_sq]
+    int16_t continuation_history[14][90][14][90];   // [prev_piece][prev_to_sq][piece][to_sq]
+    SearchStackEntry stack[MAX_PLY + STACK_OFFSET];
+
+    SearchStats stats;              // Statistics of the current search
+    SearchStats published_stats;    // Snapshot of a helper's stats, guarded by a mutex
+    uint64_t node_limit;            // Abort once stats.nodes reaches it
+    bool is_helper;                 // Lazy SMP helper thread, stopped by the main one
+    bool stopped;                   // Set when the hard time limit aborts the search
+} SearchContext;
+
+// Clears all history tables, e.g. when starting a new game.
 void clear_history_table();
 
+// Copies the statistics of the last finished search, merged over all threads.
+void get_search_stats(SearchStats* stats);
+
+// Score (for the side to move) and completed depth of the last finished
+// search; both 0 for a book move.
+void get_search_result(int* score, int* depth);
+
+// --- Tunable Search Parameters ---
+
+// Handling of nodes without a TT move (SearchParams.iid_mode)
+#define IID_MODE_OFF 0
+#define IID_MODE_REDUCTION 1    // Internal iterative reduction: search one ply shallower
+#define IID_MODE_DEEPENING 2    // Internal iterative deepening: shallow search to find a move
+
+typedef struct {
+    int rfp_max_depth;          // Reverse futility (static null move) pruning
+    int rfp_margin;             // Margin per remaining ply
+    int futility_max_depth;     // Futility pruning of quiet moves at frontier nodes
+    int futility_base;
+    int futility_margin;        // Margin per remaining ply
+    int razor_max_depth;        // Razoring into quiescence search
+    int razor_base;
+    int razor_margin;           // Margin per remaining ply
+    int singular_min_depth;     // Singular extensions of the TT move
+    int singular_margin;        // Singular beta margin per remaining ply
+    int probcut_min_depth;      // ProbCut on strong captures
+    int probcut_margin;         // Raise of beta for the reduced capture search
+    int probcut_reduction;      // Depth reduction of the ProbCut search
+    int iid_mode;               // One of IID_MODE_*
+    int iid_min_depth;
+    int lmr_base;               // Late move reductions: base / 100 + ln(depth) * ln(move_index) / (divisor / 100)
+    int lmr_divisor;
+    int lmr_history_divisor;    // History score worth one ply less (or more) reduction
+    int delta_margin;           // Quiescence delta pruning margin
+} SearchParams;
+
+extern SearchParams search_params;
+
+// Sets a search parameter by its field name (e.g. "rfp_margin").
+// Returns false if no parameter has that name.
+bool set_search_param(const char* name, int value);
+
+// Prints all search parameters as "name value" lines.
+void print_search_params();
+
 #endif // ENGINE_H
@@ -1,5 +1,6 @@
 #include "evaluate.h"
 #include "bitboard.h"
+#include "endgame.h"
 #include "move.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -284,21 +285,27 @@ static int calculate_mobility_score(const Board* board) {
 
 
 int evaluate(Board* board) {
+    // 0. Endgame recognizers: certain draws need no evaluation
+    const EndgameEntry* endgame = probe_endgame(board->material_key);
+    if (endgame && endgame->is_draw && endgame->is_draw(board, endgame->strong_side)) {
+        return DRAW_VALUE;
+    }
+
     int material_score = 0;
     int pst_score = 0;
 
     // 1. Material Score
     for (int i = 1; i <= 7; ++i) {
-        material_score += popcount(board->piece_bitboards[get_piece_to_bb_index(i)]) * MATERIAL_VALUES[i];
-        material_score -= popcount(board->piece_bitboards[get_piece_to_bb_index(-i)]) * MATERIAL_VALUES[i];
+        material_score += material_count(board->material_key, get_piece_to_bb_index(i)) * MATERIAL_VALUES[i];
+        material_score -= material_count(board->material_key, get_piece_to_bb_index(-i)) * MATERIAL_VALUES[i];
     }
 
     // 2. Tapered Eval Phase Weight
     const int OPENING_PHASE_MATERIAL = (900 + 450 + 500) * 2 + (200 + 200) * 2; // Rooks, Horses, Cannons, Guards, Bishops
     int current_phase_material = 0;
     for (int i = 2; i <= 6; ++i) { // Major pieces
-        current_phase_material += popcount(board->piece_bitboards[get_piece_to_bb_index(i)]) * MATERIAL_VALUES[i];
-        current_phase_material += popcount(board->piece_bitboards[get_piece_to_bb_index(-i)]) * MATERIAL_VALUES[i];
+        current_phase_material += material_count(board->material_key, get_piece_to_bb_index(i)) * MATERIAL_VALUES[i];
+        current_phase_material += material_count(board->material_key, get_piece_to_bb_index(-i)) * MATERIAL_VALUES[i];
     }
     double phase_weight = (double)current_phase_material / OPENING_PHASE_MATERIAL;
     if (phase_weight > 1.0) phase_weight = 1.0;
@@ -340,5 +347,8 @@ int evaluate(Board* board) {
     int dynamic_bonus_score = calculate_dynamic_bonus_score(board);
 
     int final_score = material_score + pst_score + mobility_score + pattern_score + king_safety_score + dynamic_bonus_score;
+    if (endgame && endgame->evaluate) {
+        final_score = endgame->evaluate(board, endgame->strong_side, final_score);
+    }
     return final_score * board->player_to_move;
 }
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game_db.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(GameDBHeader) == 48, "GameDBHeader must match the file format");
+_Static_assert(sizeof(GameDBGame) == 16, "GameDBGame must match the file format");
+_Static_assert(sizeof(GameDBPosition) == 32, "GameDBPosition must match the file format");
+_Static_assert(sizeof(GameDBEntry) == 8, "GameDBEntry must match the file format");
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The game database file is read in place and requires a little-endian host"
+#endif
+
+static void* db_mapping = NULL;
+static size_t db_bytes = 0;
+static const GameDBHeader* db_header = NULL;
+static const GameDBGame* db_games = NULL;
+static const uint16_t* db_moves = NULL;
+static const GameDBPosition* db_positions = NULL;
+static const GameDBEntry* db_entries = NULL;
+
+static size_t align8(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+void close_game_db() {
+    if (db_mapping) {
+        munmap(db_mapping, db_bytes);
+    }
+    db_mapping = NULL;
+    db_header = NULL;
+    db_games = NULL;
+    db_moves = NULL;
+    db_positions = NULL;
+    db_entries = NULL;
+}
+
+// Returns NULL if the mapped file is a valid database, otherwise the reason.
+// Games and positions are checked once here, so that queries need no bounds
+// checks; entries are not, as they are the bulk of the file, and their game
+// IDs are checked by game_db_game().
+static const char* check_game_db(const void* data, size_t bytes) {
+    if (bytes < sizeof(GameDBHeader)) {
+        return "truncated file";
+    }
+    const GameDBHeader* header = (const GameDBHeader*)data;
+    if (memcmp(header->magic, GAME_DB_MAGIC, sizeof(header->magic)) != 0) {
+        return "not a game database";
+    }
+    if (header->version != GAME_DB_VERSION) {
+        return "unsupported format version";
+    }
+    if (header->game_count > UINT32_MAX || header->position_count > bytes || header->entry_count > bytes
+        || header->move_count > bytes) {
+        return "file size does not match its header";
+    }
+    size_t expected = sizeof(GameDBHeader) + header->game_count * sizeof(GameDBGame)
+                      + align8(header->move_count * sizeof(uint16_t))
+                      + header->position_count * sizeof(GameDBPosition) + header->entry_count * sizeof(GameDBEntry);
+    if (bytes != expected) {
+        return "file size does not match its header";
+    }
+
+    const GameDBGame* games = (const GameDBGame*)(header + 1);
+    for (uint64_t i = 0; i < header->game_count; ++i) {
+        if (games[i].first_move + games[i].move_count > header->move_count) {
+            return "move index out of range";
+        }
+    }
+    const GameDBPosition* positions = (const GameDBPosition*)((const char*)(games + header->game_count)
+                                                              + align8(header->move_count * sizeof(uint16_t)));
+    for (uint64_t i = 0; i < header->position_count; ++i) {
+        if ((uint64_t)positions[i].first_entry + positions[i].game_count > header->entry_count) {
+            return "entry index out of range";
+        }
+        if (i > 0 && positions[i].hash_key <= positions[i - 1].hash_key) {
+            return "positions not sorted";
+        }
+    }
+    return NULL;
+}
+
+bool open_game_db(const char* path) {
+    close_game_db();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open game database: %s\n", path);
+        return false;
+    }
+    struct stat file_stat;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Could not map game database: %s\n", path);
+        return false;
+    }
+
+    const char* error = check_game_db(data, (size_t)file_stat.st_size);
+    if (error != NULL) {
+        printf("Invalid game database %s: %s.\n", path, error);
+        munmap(data, (size_t)file_stat.st_size);
+        return false;
+    }
+
+    db_mapping = data;
+    db_bytes = (size_t)file_stat.st_size;
+    db_header = (const GameDBHeader*)data;
+    db_games = (const GameDBGame*)(db_header + 1);
+    db_moves = (const uint16_t*)(db_games + db_header->game_count);
+    db_positions = (const GameDBPosition*)((const char*)db_moves + align8(db_header->move_count * sizeof(uint16_t)));
+    db_entries = (const GameDBEntry*)(db_positions + db_header->position_count);
+    // Queries touch a few pages at random
+    posix_madvise(data, db_bytes, POSIX_MADV_RANDOM);
+    return true;
+}
+
+const GameDBPosition* find_game_db_position(uint64_t hash_key) {
+    if (!db_header) {
+        return NULL;
+    }
+    uint64_t low = 0, high = db_header->position_count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (db_positions[mid].hash_key < hash_key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < db_header->position_count && db_positions[low].hash_key == hash_key) {
+        return &db_positions[low];
+    }
+    return NULL;
+}
+
+const GameDBEntry* game_db_entries(const GameDBPosition* position) {
+    return &db_entries[position->first_entry];
+}
+
+const GameDBGame* game_db_game(uint32_t game_id, const uint16_t** moves) {
+    if (!db_header || game_id >= db_header->game_count) {
+        return NULL;
+    }
+    const GameDBGame* game = &db_games[game_id];
+    if (moves) {
+        *moves = &db_moves[game->first_move];
+    }
+    return game;
+}
+
+uint64_t game_db_game_count() {
+    return db_header ? db_header->game_count : 0;
+}
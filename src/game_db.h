@@ -0,0 +1,93 @@
+#ifndef GAME_DB_H
+#define GAME_DB_H
+
+#include "bitboard.h"
+#include "move.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Game database: a compact store of whole games and an index from every
+// position reached to the games that reached it, for questions such as
+// "which games reached this position and how did they end". Built from game
+// record files (see game_records.h) by "xiangqi gamedb build", and
+// memory-mapped read-only for queries.
+
+#define DEFAULT_GAME_DB_PATH "games.xqdb"
+
+// Game database file format (version 1, little-endian), each section
+// starting at a multiple of 8 bytes:
+//   GameDBHeader
+//   GameDBGame[game_count], in the order of the game files
+//   uint16_t moves[move_count], the packed moves of each game contiguously
+//   GameDBPosition[position_count], sorted by hash_key
+//   GameDBEntry[entry_count], the entries of each position contiguously,
+//   sorted by game ID
+#define GAME_DB_MAGIC "XQGAMEDB"
+#define GAME_DB_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t game_count;
+    uint64_t move_count;
+    uint64_t position_count;
+    uint64_t entry_count;
+} GameDBHeader;
+
+typedef struct {
+    uint64_t first_move;    // Index into the move array
+    uint16_t move_count;
+    uint8_t result;         // Points for Red: 2 win, 1 draw, 0 loss
+    uint8_t reserved[5];
+} GameDBGame;
+
+// A position with the results of all games that reached it; a game that
+// reached it more than once counts once
+typedef struct {
+    uint64_t hash_key;
+    uint32_t first_entry;   // Index into the entry array
+    uint32_t game_count;    // Entries of the position
+    uint32_t red_wins;
+    uint32_t draws;
+    uint32_t black_wins;
+    uint32_t reserved;
+} GameDBPosition;
+
+// A game that reached a position: the first ply at which it did, and the
+// move it played next (0 if the game ended there)
+typedef struct {
+    uint32_t game_id;
+    uint16_t ply;
+    uint16_t next_move;
+} GameDBEntry;
+
+// Moves are packed in 16 bits: from_sq * 128 + to_sq; 0 is no move
+static inline uint16_t pack_game_db_move(Move move) {
+    return (uint16_t)(move.from_sq << 7 | move.to_sq);
+}
+
+static inline Move unpack_game_db_move(uint16_t packed) {
+    return (Move){packed >> 7, packed & 127};
+}
+
+// Maps a game database read-only, replacing the current one. Returns false
+// if the file is missing or invalid; there is no database then.
+bool open_game_db(const char* path);
+
+// Unmaps the current database, if any
+void close_game_db();
+
+// Looks up a position by binary search. Returns NULL if no game reached it.
+const GameDBPosition* find_game_db_position(uint64_t hash_key);
+
+// The entries of a position found by find_game_db_position()
+const GameDBEntry* game_db_entries(const GameDBPosition* position);
+
+// Returns a game and its packed moves, or NULL for an unknown ID
+const GameDBGame* game_db_game(uint32_t game_id, const uint16_t** moves);
+
+uint64_t game_db_game_count();
+
+#endif // GAME_DB_H
@@ -0,0 +1,639 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game_db_builder.h"
+#include "game_db.h"
+#include "game_records.h"
+#include "bitboard.h"
+#include "move.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GAMEDB_MAX_THREADS 256
+#define GAMEDB_MAX_FILES 1024
+
+// Position records are distributed over shards by the top bits of the
+// position key, so that every shard can be sorted and indexed on its own,
+// and the shards concatenated in order are sorted by key
+#define GAMEDB_SHARD_BITS 8
+#define GAMEDB_SHARDS (1 << GAMEDB_SHARD_BITS)
+
+// Longer games are skipped; plies are stored in 16 bits
+#define GAMEDB_MAX_PLIES UINT16_MAX
+
+#define GAMEDB_DEFAULT_QUERY_GAMES 10
+
+// One position reached in one game
+typedef struct {
+    uint64_t hash_key;
+    uint32_t game_id;       // Local to the worker until the shards are gathered
+    uint16_t ply;
+    uint16_t next_move;
+} PositionRecord;
+
+typedef struct {
+    PositionRecord* records;
+    size_t count;
+    size_t capacity;
+} RecordList;
+
+// Index data of one shard, with entry indices relative to the shard
+typedef struct {
+    GameDBPosition* positions;
+    GameDBEntry* entries;
+    size_t position_count;
+    size_t entry_count;
+} ShardOutput;
+
+typedef struct {
+    const char* paths[GAMEDB_MAX_FILES];
+    int file_count;
+    const char* out_path;
+    int threads;
+} BuilderConfig;
+
+typedef struct {
+    int id;
+    RecordList shards[GAMEDB_SHARDS];
+    GameDBGame* games;                      // first_move indexes the worker's moves
+    size_t game_count;
+    size_t game_capacity;
+    uint16_t* moves;
+    size_t move_count;
+    size_t move_capacity;
+    uint64_t* keys;                         // Position keys of the game being replayed
+    size_t key_capacity;
+    size_t file_games[GAMEDB_MAX_FILES + 1]; // First local game of each file
+    uint32_t* game_ids;                     // Game ID of each local game
+    uint64_t skipped_games;                 // Without a result, with an illegal or malformed move, or too long
+} Worker;
+
+static BuilderConfig config;
+static GameFile files[GAMEDB_MAX_FILES];
+static Worker* workers;
+static ShardOutput shard_outputs[GAMEDB_SHARDS];
+static GameDBGame* games;   // All games by ID, first_move indexing the file's move array
+static uint64_t game_total;
+static Board start_board;
+
+static void out_of_memory() {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+}
+
+// Grows *items to hold at least needed items of size bytes
+static void reserve(void** items, size_t* capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) {
+        return;
+    }
+    size_t new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* grown = realloc(*items, new_capacity * size);
+    if (!grown) {
+        out_of_memory();
+    }
+    *items = grown;
+    *capacity = new_capacity;
+}
+
+// --- Replay ---
+
+// Replays one game line [line, end) and records every position it reached.
+// Games without a result, with an illegal or malformed move or longer than
+// GAMEDB_MAX_PLIES are skipped as a whole.
+static void process_game(Worker* worker, const char* line, const char* end) {
+    bool comment;
+    int red_points = game_line_result(line, end, &comment);
+    if (comment) {
+        return;
+    }
+    if (red_points == GAME_NO_RESULT) {
+        worker->skipped_games++;
+        return;
+    }
+
+    // Moves are appended after the worker's moves, and kept only if the
+    // whole game replays
+    char token[GAME_TOKEN_LENGTH];
+    const char* cursor = line;
+    Board board;
+    copy_board(&start_board, &board);
+    size_t plies = 0;
+    while (next_game_token(&cursor, end, token)) {
+        if (parse_game_result(token) != GAME_NO_RESULT) {
+            continue;
+        }
+        Move move = parse_move_string(token);
+        if (plies == GAMEDB_MAX_PLIES || (move.from_sq == 0 && move.to_sq == 0)) {
+            worker->skipped_games++;
+            return;
+        }
+        reserve((void**)&worker->keys, &worker->key_capacity, plies + 2, sizeof(uint64_t));
+        reserve((void**)&worker->moves, &worker->move_capacity, worker->move_count + plies + 1, sizeof(uint16_t));
+        worker->keys[plies] = board.hash_key;
+        if (!play_if_legal(&board, move)) {
+            worker->skipped_games++;
+            return;
+        }
+        worker->moves[worker->move_count + plies] = pack_game_db_move(move);
+        plies++;
+        // Only the position keys matter here, not repetitions
+        if (board.history_ply >= MAX_HISTORY - 1) {
+            trim_history(&board, 1);
+        }
+    }
+    reserve((void**)&worker->keys, &worker->key_capacity, plies + 1, sizeof(uint64_t));
+    worker->keys[plies] = board.hash_key;
+
+    reserve((void**)&worker->games, &worker->game_capacity, worker->game_count + 1, sizeof(GameDBGame));
+    uint32_t local_id = (uint32_t)worker->game_count;
+    worker->games[worker->game_count++] = (GameDBGame){
+        .first_move = worker->move_count,
+        .move_count = (uint16_t)plies,
+        .result = (uint8_t)red_points,
+    };
+    for (size_t ply = 0; ply <= plies; ++ply) {
+        PositionRecord record = {
+            .hash_key = worker->keys[ply],
+            .game_id = local_id,
+            .ply = (uint16_t)ply,
+            .next_move = (ply < plies) ? worker->moves[worker->move_count + ply] : 0,
+        };
+        RecordList* list = &worker->shards[record.hash_key >> (64 - GAMEDB_SHARD_BITS)];
+        reserve((void**)&list->records, &list->capacity, list->count + 1, sizeof(PositionRecord));
+        list->records[list->count++] = record;
+    }
+    worker->move_count += plies;
+}
+
+static void* replay_games(void* arg) {
+    Worker* worker = (Worker*)arg;
+    for (int f = 0; f < config.file_count; ++f) {
+        const GameFile* file = &files[f];
+        worker->file_games[f] = worker->game_count;
+        if (file->size == 0) continue;
+        // Each file is split into one range of lines per worker
+        const char* p = file->data + game_file_range_start(file, worker->id, config.threads);
+        const char* range_end = file->data + game_file_range_start(file, worker->id + 1, config.threads);
+        while (p < range_end) {
+            const char* newline = memchr(p, '\n', file->data + file->size - p);
+            const char* line_end = newline ? newline : file->data + file->size;
+            process_game(worker, p, line_end);
+            p = line_end + 1;
+        }
+    }
+    worker->file_games[config.file_count] = worker->game_count;
+    return NULL;
+}
+
+// Numbers the games in the order of the game files: file by file, the ranges
+// of the workers in order. The IDs, and so the whole database, do not depend
+// on the number of threads.
+static bool number_games() {
+    game_total = 0;
+    for (int w = 0; w < config.threads; ++w) {
+        game_total += workers[w].game_count;
+    }
+    if (game_total > UINT32_MAX) {
+        printf("Too many games: %llu.\n", (unsigned long long)game_total);
+        return false;
+    }
+    games = (GameDBGame*)malloc((game_total ? game_total : 1) * sizeof(GameDBGame));
+    if (!games) {
+        out_of_memory();
+    }
+
+    uint32_t next_id = 0;
+    uint64_t move_offset = 0;
+    for (int f = 0; f < config.file_count; ++f) {
+        for (int w = 0; w < config.threads; ++w) {
+            Worker* worker = &workers[w];
+            if (f == 0) {
+                worker->game_ids = (uint32_t*)malloc((worker->game_count ? worker->game_count : 1) * sizeof(uint32_t));
+                if (!worker->game_ids) {
+                    out_of_memory();
+                }
+            }
+            for (size_t local = worker->file_games[f]; local < worker->file_games[f + 1]; ++local) {
+                worker->game_ids[local] = next_id;
+                games[next_id] = worker->games[local];
+                games[next_id].first_move = move_offset;
+                move_offset += worker->games[local].move_count;
+                next_id++;
+            }
+        }
+    }
+    return true;
+}
+
+// --- Indexing ---
+
+static int compare_records(const void* a, const void* b) {
+    const PositionRecord* x = (const PositionRecord*)a;
+    const PositionRecord* y = (const PositionRecord*)b;
+    if (x->hash_key != y->hash_key) return (x->hash_key > y->hash_key) - (x->hash_key < y->hash_key);
+    if (x->game_id != y->game_id) return (x->game_id > y->game_id) - (x->game_id < y->game_id);
+    return x->ply - y->ply;
+}
+
+// Turns the sorted records of one shard into positions and entries; a game
+// that reached a position more than once keeps its first entry only
+static void index_shard(const PositionRecord* records, size_t count, ShardOutput* output) {
+    size_t positions = 0, entries = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool new_position = (i == 0 || records[i].hash_key != records[i - 1].hash_key);
+        positions += new_position;
+        entries += (new_position || records[i].game_id != records[i - 1].game_id);
+    }
+    output->positions = (GameDBPosition*)malloc((positions ? positions : 1) * sizeof(GameDBPosition));
+    output->entries = (GameDBEntry*)malloc((entries ? entries : 1) * sizeof(GameDBEntry));
+    if (!output->positions || !output->entries) {
+        out_of_memory();
+    }
+
+    GameDBPosition* position = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        const PositionRecord* record = &records[i];
+        if (i == 0 || record->hash_key != records[i - 1].hash_key) {
+            position = &output->positions[output->position_count++];
+            *position = (GameDBPosition){
+                .hash_key = record->hash_key,
+                .first_entry = (uint32_t)output->entry_count,
+            };
+        } else if (record->game_id == records[i - 1].game_id) {
+            continue;
+        }
+        output->entries[output->entry_count++] = (GameDBEntry){
+            .game_id = record->game_id,
+            .ply = record->ply,
+            .next_move = record->next_move,
+        };
+        position->game_count++;
+        int result = games[record->game_id].result;
+        if (result == 2) position->red_wins++;
+        else if (result == 1) position->draws++;
+        else position->black_wins++;
+    }
+}
+
+// Gathers, sorts and indexes the shards id, id + threads, ... of all workers
+static void* index_shards(void* arg) {
+    int id = ((Worker*)arg)->id;
+    for (int s = id; s < GAMEDB_SHARDS; s += config.threads) {
+        size_t count = 0;
+        for (int w = 0; w < config.threads; ++w) {
+            count += workers[w].shards[s].count;
+        }
+        PositionRecord* records = (PositionRecord*)malloc((count ? count : 1) * sizeof(PositionRecord));
+        if (!records) {
+            out_of_memory();
+        }
+        size_t offset = 0;
+        for (int w = 0; w < config.threads; ++w) {
+            RecordList* list = &workers[w].shards[s];
+            for (size_t i = 0; i < list->count; ++i) {
+                records[offset] = list->records[i];
+                records[offset].game_id = workers[w].game_ids[list->records[i].game_id];
+                offset++;
+            }
+            free(list->records);
+            list->records = NULL;
+        }
+
+        qsort(records, count, sizeof(PositionRecord), compare_records);
+        index_shard(records, count, &shard_outputs[s]);
+        free(records);
+    }
+    return NULL;
+}
+
+// Runs one phase on all workers; worker 0 runs on the calling thread
+static void run_workers(void* (*phase)(void*)) {
+    pthread_t threads[GAMEDB_MAX_THREADS];
+    bool started[GAMEDB_MAX_THREADS] = {false};
+    for (int i = 1; i < config.threads; ++i) {
+        started[i] = (pthread_create(&threads[i], NULL, phase, &workers[i]) == 0);
+    }
+    phase(&workers[0]);
+    for (int i = 1; i < config.threads; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            phase(&workers[i]);
+        }
+    }
+}
+
+// --- Output ---
+
+static bool write_game_db(const char* path, GameDBHeader* header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, GAME_DB_MAGIC, sizeof(header->magic));
+    header->version = GAME_DB_VERSION;
+    header->game_count = game_total;
+    for (int w = 0; w < config.threads; ++w) {
+        header->move_count += workers[w].move_count;
+    }
+    for (int s = 0; s < GAMEDB_SHARDS; ++s) {
+        header->position_count += shard_outputs[s].position_count;
+        header->entry_count += shard_outputs[s].entry_count;
+    }
+    if (header->entry_count > UINT32_MAX) {
+        printf("Database too large: %llu entries.\n", (unsigned long long)header->entry_count);
+        return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Could not open %s for writing.\n", path);
+        return false;
+    }
+    bool ok = fwrite(header, sizeof(*header), 1, file) == 1;
+    ok = ok && fwrite(games, sizeof(GameDBGame), game_total, file) == game_total;
+
+    // The moves of each worker's games of one file are contiguous, in game order
+    for (int f = 0; f < config.file_count && ok; ++f) {
+        for (int w = 0; w < config.threads && ok; ++w) {
+            Worker* worker = &workers[w];
+            size_t first = worker->file_games[f], last = worker->file_games[f + 1];
+            if (first == last) continue;
+            size_t first_move = worker->games[first].first_move;
+            size_t move_count = worker->games[last - 1].first_move + worker->games[last - 1].move_count - first_move;
+            ok = fwrite(worker->moves + first_move, sizeof(uint16_t), move_count, file) == move_count;
+        }
+    }
+    static const uint8_t padding[8] = {0};
+    size_t padding_bytes = (8 - (header->move_count * sizeof(uint16_t)) % 8) % 8;
+    ok = ok && fwrite(padding, 1, padding_bytes, file) == padding_bytes;
+
+    // Entry indices become global: each shard's entries follow those of the previous shards
+    size_t entry_offset = 0;
+    for (int s = 0; s < GAMEDB_SHARDS && ok; ++s) {
+        ShardOutput* output = &shard_outputs[s];
+        for (size_t i = 0; i < output->position_count; ++i) {
+            output->positions[i].first_entry += (uint32_t)entry_offset;
+        }
+        ok = fwrite(output->positions, sizeof(GameDBPosition), output->position_count, file) == output->position_count;
+        entry_offset += output->entry_count;
+    }
+    for (int s = 0; s < GAMEDB_SHARDS && ok; ++s) {
+        ShardOutput* output = &shard_outputs[s];
+        ok = fwrite(output->entries, sizeof(GameDBEntry), output->entry_count, file) == output->entry_count;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        printf("Failed to write the game database to %s.\n", path);
+    }
+    return ok;
+}
+
+// --- Command line ---
+
+static void print_usage() {
+    printf("Usage: xiangqi gamedb build [options] <game files...>\n"
+           "  Game files hold one game per line: coordinate moves from the start position\n"
+           "  (e.g. h2e2 h9g7) and a result (1-0, 0-1 or 1/2-1/2); lines starting with # are skipped.\n"
+           "  -out <file>       Database file to write (default %s)\n"
+           "  -threads <n>      Worker threads (default: all cores)\n"
+           "Usage: xiangqi gamedb query [options] [moves...]\n"
+           "  Looks up the position after the moves, played from the start position or the FEN.\n"
+           "  -db <file>        Database file (default %s)\n"
+           "  -fen <fen>        Position to play the moves from\n"
+           "  -games <n>        Games to list (default %d)\n",
+           DEFAULT_GAME_DB_PATH, DEFAULT_GAME_DB_PATH, GAMEDB_DEFAULT_QUERY_GAMES);
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int run_build(int argc, char* argv[]) {
+    config = (BuilderConfig){
+        .out_path = DEFAULT_GAME_DB_PATH,
+        .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+    };
+
+    for (int i = 3; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-out") == 0 && remaining >= 1) {
+            config.out_path = argv[++i];
+        } else if (strcmp(option, "-threads") == 0 && remaining >= 1) {
+            config.threads = atoi(argv[++i]);
+        } else if (option[0] != '-' && config.file_count < GAMEDB_MAX_FILES) {
+            config.paths[config.file_count++] = option;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (config.file_count == 0) {
+        print_usage();
+        return 1;
+    }
+    if (config.threads < 1) config.threads = 1;
+    if (config.threads > GAMEDB_MAX_THREADS) config.threads = GAMEDB_MAX_THREADS;
+
+    // Shared tables are initialized before any worker starts
+    init_board(&start_board, NULL);
+    init_move_generator();
+
+    size_t input_bytes = 0;
+    for (int f = 0; f < config.file_count; ++f) {
+        if (!map_game_file(config.paths[f], &files[f])) {
+            return 1;
+        }
+        input_bytes += files[f].size;
+    }
+
+    workers = (Worker*)calloc(config.threads, sizeof(Worker));
+    if (!workers) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < config.threads; ++i) {
+        workers[i].id = i;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    run_workers(replay_games);
+    uint64_t skipped_games = 0, records = 0;
+    for (int i = 0; i < config.threads; ++i) {
+        skipped_games += workers[i].skipped_games;
+        for (int s = 0; s < GAMEDB_SHARDS; ++s) {
+            records += workers[i].shards[s].count;
+        }
+    }
+    double replay_time = elapsed_seconds(&start);
+
+    GameDBHeader header;
+    bool ok = number_games();
+    if (ok) {
+        run_workers(index_shards);
+        ok = write_game_db(config.out_path, &header);
+    }
+    double total_time = elapsed_seconds(&start);
+
+    printf("Games: %llu (%llu skipped), %.1f MB read\n", (unsigned long long)game_total,
+           (unsigned long long)skipped_games, input_bytes / (1024.0 * 1024.0));
+    printf("Replayed positions: %llu in %.2fs (%.0f positions/s, %d threads)\n", (unsigned long long)records,
+           replay_time, replay_time > 0 ? records / replay_time : 0.0, config.threads);
+    if (ok) {
+        printf("Database %s: %llu games, %llu moves, %llu positions, %llu entries, built in %.2fs\n",
+               config.out_path, (unsigned long long)header.game_count, (unsigned long long)header.move_count,
+               (unsigned long long)header.position_count, (unsigned long long)header.entry_count, total_time);
+    }
+
+    for (int s = 0; s < GAMEDB_SHARDS; ++s) {
+        free(shard_outputs[s].positions);
+        free(shard_outputs[s].entries);
+    }
+    for (int i = 0; i < config.threads; ++i) {
+        free(workers[i].games);
+        free(workers[i].moves);
+        free(workers[i].keys);
+        free(workers[i].game_ids);
+    }
+    for (int f = 0; f < config.file_count; ++f) {
+        unmap_game_file(&files[f]);
+    }
+    free(games);
+    free(workers);
+    return ok ? 0 : 1;
+}
+
+static const char* result_string(int red_points) {
+    return red_points == 2 ? "1-0" : red_points == 1 ? "1/2-1/2" : "0-1";
+}
+
+// Games and results of the moves played next from a position
+typedef struct {
+    uint16_t move;
+    uint32_t games;
+    uint32_t points;    // For the side to move: 2 win, 1 draw, 0 loss
+} NextMoveStats;
+
+static int compare_next_moves(const void* a, const void* b) {
+    const NextMoveStats* x = (const NextMoveStats*)a;
+    const NextMoveStats* y = (const NextMoveStats*)b;
+    if (x->games != y->games) return (x->games < y->games) - (x->games > y->games);
+    return x->move - y->move;
+}
+
+static void print_next_moves(const GameDBPosition* position, int player) {
+    NextMoveStats stats[MAX_MOVES + 1]; // Legal moves, and the end of the game
+    int count = 0;
+    const GameDBEntry* entries = game_db_entries(position);
+    for (uint32_t i = 0; i < position->game_count; ++i) {
+        const GameDBGame* game = game_db_game(entries[i].game_id, NULL);
+        if (!game) continue;
+        int k = 0;
+        while (k < count && stats[k].move != entries[i].next_move) k++;
+        if (k == count) {
+            if (count == MAX_MOVES + 1) continue;
+            stats[count++] = (NextMoveStats){entries[i].next_move, 0, 0};
+        }
+        stats[k].games++;
+        stats[k].points += (player == PLAYER_R) ? game->result : 2 - game->result;
+    }
+    qsort(stats, count, sizeof(NextMoveStats), compare_next_moves);
+
+    printf("Next moves (score for the side to move):\n");
+    for (int k = 0; k < count; ++k) {
+        char move_str[6] = "end";
+        if (stats[k].move != 0) {
+            move_to_string(unpack_game_db_move(stats[k].move), move_str);
+        }
+        printf("  %-5s %8u games  %5.1f%%\n", move_str, stats[k].games, 50.0 * stats[k].points / stats[k].games);
+    }
+}
+
+static int run_query(int argc, char* argv[]) {
+    const char* db_path = DEFAULT_GAME_DB_PATH;
+    const char* fen = NULL;
+    int list_games = GAMEDB_DEFAULT_QUERY_GAMES;
+    const char* moves[MAX_HISTORY];
+    int move_count = 0;
+
+    for (int i = 3; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-db") == 0 && remaining >= 1) {
+            db_path = argv[++i];
+        } else if (strcmp(option, "-fen") == 0 && remaining >= 1) {
+            fen = argv[++i];
+        } else if (strcmp(option, "-games") == 0 && remaining >= 1) {
+            list_games = atoi(argv[++i]);
+        } else if (option[0] != '-' && move_count < MAX_HISTORY - 1) {
+            moves[move_count++] = option;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    Board board;
+    init_board(&board, NULL);
+    init_move_generator();
+    if (fen) {
+        parse_fen(&board, fen);
+    }
+    for (int i = 0; i < move_count; ++i) {
+        Move move = parse_move_string(moves[i]);
+        if ((move.from_sq == 0 && move.to_sq == 0) || !play_if_legal(&board, move)) {
+            printf("Illegal move: %s\n", moves[i]);
+            return 1;
+        }
+    }
+    if (!open_game_db(db_path)) {
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const GameDBPosition* position = find_game_db_position(board.hash_key);
+    double lookup_us = elapsed_seconds(&start) * 1e6;
+
+    char fen_string[128];
+    to_fen(&board, fen_string);
+    printf("Position: %s\n", fen_string);
+    if (!position) {
+        printf("No game reached this position (lookup %.1f us).\n", lookup_us);
+        close_game_db();
+        return 0;
+    }
+    printf("Games: %u of %llu, Red wins %u, draws %u, Black wins %u (lookup %.1f us)\n", position->game_count,
+           (unsigned long long)game_db_game_count(), position->red_wins, position->draws, position->black_wins,
+           lookup_us);
+    print_next_moves(position, board.player_to_move);
+
+    const GameDBEntry* entries = game_db_entries(position);
+    for (uint32_t i = 0; i < position->game_count && (int)i < list_games; ++i) {
+        const GameDBGame* game = game_db_game(entries[i].game_id, NULL);
+        if (game) {
+            printf("  game %u: reached at ply %u of %u, %s\n", entries[i].game_id, entries[i].ply,
+                   game->move_count, result_string(game->result));
+        }
+    }
+    close_game_db();
+    return 0;
+}
+
+int run_game_db(int argc, char* argv[]) {
+    if (argc > 2 && strcmp(argv[2], "build") == 0) {
+        return run_build(argc, argv);
+    }
+    if (argc > 2 && strcmp(argv[2], "query") == 0) {
+        return run_query(argc, argv);
+    }
+    print_usage();
+    return 1;
+}
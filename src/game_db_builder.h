@@ -0,0 +1,15 @@
+#ifndef GAME_DB_BUILDER_H
+#define GAME_DB_BUILDER_H
+
+// Game database tool:
+//   "xiangqi gamedb build [options] <game files...>" replays every game of
+//   the game record files (see game_records.h) in parallel, and writes the
+//   games with their packed moves and the index of all positions reached
+//   (see game_db.h).
+//   "xiangqi gamedb query [options] [moves...]" looks up a position, given
+//   as a FEN and/or moves from it, and prints the results of the games that
+//   reached it and the moves they played next.
+// Returns the process exit code.
+int run_game_db(int argc, char* argv[]);
+
+#endif // GAME_DB_BUILDER_H
@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "game_records.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_game_file(const char* path, GameFile* file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open game file: %s\n", path);
+        return false;
+    }
+    struct stat file_stat;
+    bool ok = fstat(fd, &file_stat) == 0;
+    file->size = ok ? (size_t)file_stat.st_size : 0;
+    file->data = NULL;
+    if (ok && file->size > 0) {
+        void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            printf("Could not map game file: %s\n", path);
+            ok = false;
+        } else {
+            file->data = (const char*)data;
+            posix_madvise(data, file->size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void unmap_game_file(GameFile* file) {
+    if (file->data) {
+        munmap((void*)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+size_t game_file_range_start(const GameFile* file, int part, int parts) {
+    if (part >= parts) return file->size;
+    size_t offset = file->size / parts * part;
+    if (offset == 0) return 0;
+    const char* newline = memchr(file->data + offset - 1, '\n', file->size - offset + 1);
+    return newline ? (size_t)(newline - file->data) + 1 : file->size;
+}
+
+bool next_game_token(const char** cursor, const char* end, char* token) {
+    const char* p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p >= end) {
+        *cursor = p;
+        return false;
+    }
+    size_t length = 0;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+        if (length < GAME_TOKEN_LENGTH - 1) {
+            token[length++] = *p;
+        }
+        p++;
+    }
+    token[length] = '\0';
+    *cursor = p;
+    return true;
+}
+
+int parse_game_result(const char* token) {
+    if (strcmp(token, "1-0") == 0) return 2;
+    if (strcmp(token, "0-1") == 0) return 0;
+    if (strcmp(token, "1/2-1/2") == 0 || strcmp(token, "draw") == 0) return 1;
+    return GAME_NO_RESULT;
+}
+
+int game_line_result(const char* line, const char* end, bool* comment) {
+    char token[GAME_TOKEN_LENGTH];
+    const char* cursor = line;
+    int red_points = GAME_NO_RESULT;
+    *comment = false;
+    while (next_game_token(&cursor, end, token)) {
+        if (token[0] == '#') {
+            *comment = true;
+            return GAME_NO_RESULT;
+        }
+        int result = parse_game_result(token);
+        if (result != GAME_NO_RESULT) {
+            red_points = result;
+        }
+    }
+    return red_points;
+}
+
+bool play_if_legal(Board* board, Move move) {
+    MoveList moves;
+    generate_pseudo_legal_moves(board, &moves);
+    for (int i = 0; i < moves.count; ++i) {
+        if (is_same_move(moves.moves[i], move)) {
+            int player = board->player_to_move;
+            Piece captured = move_piece(board, move.from_sq, move.to_sq);
+            if (is_king_in_check(board, player)) {
+                unmove_piece(board, move.from_sq, move.to_sq, captured);
+                return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
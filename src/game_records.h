@@ -0,0 +1,50 @@
+#ifndef GAME_RECORDS_H
+#define GAME_RECORDS_H
+
+#include "bitboard.h"
+#include "move.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Game record files, read by the opening book and game database builders:
+// one game per line, coordinate moves such as "h2e2" from the start position
+// and a result "1-0", "0-1" or "1/2-1/2" ("draw" is accepted too), usually
+// last. Lines starting with # are comments.
+
+#define GAME_TOKEN_LENGTH 16
+
+// Game result in points for Red: 2 win, 1 draw, 0 loss
+#define GAME_NO_RESULT -1
+
+typedef struct {
+    const char* data;
+    size_t size;
+} GameFile;
+
+// Maps a game file read-only for sequential reading; an empty file maps to
+// no data. Returns false, with a message, if it cannot be opened.
+bool map_game_file(const char* path, GameFile* file);
+
+void unmap_game_file(GameFile* file);
+
+// Splits a file into parts byte ranges moved forward to the next line start.
+// Returns the offset where part starts (the file size for part == parts).
+size_t game_file_range_start(const GameFile* file, int part, int parts);
+
+// Copies the next whitespace separated token of [*cursor, end) into token
+// (GAME_TOKEN_LENGTH bytes) and advances the cursor. Returns false at the end
+// of the text.
+bool next_game_token(const char** cursor, const char* end, char* token);
+
+// Returns the points for Red of a result token, or GAME_NO_RESULT
+int parse_game_result(const char* token);
+
+// Result of a game line [line, end): GAME_NO_RESULT if it has none. Sets
+// *comment for comment lines.
+int game_line_result(const char* line, const char* end, bool* comment);
+
+// Plays the move if it is legal. Cheaper than generate_legal_moves(), which
+// makes every pseudo-legal move to test it: only this move is made.
+bool play_if_legal(Board* board, Move move);
+
+#endif // GAME_RECORDS_H
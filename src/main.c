@@ -1,6 +1,52 @@
 #include "textual_ui.h"
+#include "protocol.h"
+#include "match.h"
+#include "bench.h"
+#include "book_builder.h"
+#include "game_db_builder.h"
+#include "datagen.h"
+#include "engine.h"
+#include "tablebase.h"
+#include "tablebase_gen.h"
+#include <string.h>
 
-int main() {
+int main(int argc, char* argv[]) {
+    // "xiangqi [-book <file>] [-tb <directory>] ..." opens another opening book
+    // or endgame tablebases before any mode starts
+    while (argc > 2 && (strcmp(argv[1], "-book") == 0 || strcmp(argv[1], "-tb") == 0)) {
+        if (strcmp(argv[1], "-book") == 0) {
+            set_opening_book(argv[2]);
+        } else {
+            load_tablebases(argv[2]);
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // "xiangqi ucci" or "xiangqi uci" starts straight in protocol mode
+    if (argc > 1 && (strcmp(argv[1], "ucci") == 0 || strcmp(argv[1], "uci") == 0)) {
+        run_protocol(NULL);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "match") == 0) {
+        return run_match(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_bench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "book") == 0) {
+        return run_book_builder(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "gamedb") == 0) {
+        return run_game_db(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "datagen") == 0) {
+        return run_datagen(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "tbgen") == 0) {
+        return run_tablebase_generator(argc, argv);
+    }
     run_textual_ui();
     return 0;
 }
@@ -0,0 +1,748 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "match.h"
+#include "bitboard.h"
+#include "move.h"
+#include "endgame.h"
+#include "timeman.h"
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MATCH_MAX_PARAMS 32
+#define MATCH_MAX_THREADS 256
+#define MATCH_MAX_PLIES 1000                // Hard cap on game length, including the opening
+#define MATCH_POSITION_BUFFER (320 + MATCH_MAX_PLIES * 5)
+
+// Game results, from engine 1's point of view
+#define RESULT_LOSS -1
+#define RESULT_DRAW 0
+#define RESULT_WIN 1
+
+// Built-in opening suite, used without -openings: common first moves given as
+// coordinate moves from the start position
+static const char* DEFAULT_OPENINGS[] = {
+    "h2e2 h9g7",        // Central cannon vs. screen horses
+    "h2e2 b9c7",
+    "h2e2 h7e7",        // Same direction cannons
+    "h2e2 b7e7",        // Opposite direction cannons
+    "h2e2 h9g7 h0g2 i9h9",
+    "c3c4 g6g5",        // Pawn opening
+    "c3c4 b9c7",
+    "g3g4 c6c5",
+    "c0e2 h9g7",        // Elephant opening
+    "c0e2 b7e7",
+    "h0g2 b9c7",        // Horse opening
+    "b0c2 h9g7",
+    "b2d2 h9g7",
+    "h2f2 b9c7",
+};
+
+typedef struct {
+    const char* path;
+    const char* params[MATCH_MAX_PARAMS]; // "name=value", sent with setoption
+    int param_count;
+} EngineConfig;
+
+typedef struct {
+    EngineConfig engines[2];
+    const char* openings_path;
+    const char* out_path;
+    int games;
+    int concurrency;
+    int hash_mb;
+
+    // Time control: exactly one of nodes, movetime, depth or a clock (tc_base + tc_inc)
+    unsigned long long nodes;
+    long movetime;
+    int depth;
+    long tc_base;
+    long tc_inc;
+
+    // Adjudication
+    int max_plies;          // Draw after this many plies
+    int draw_min_ply;       // Draw when both sides report |score| <= draw_score...
+    int draw_score;
+    int draw_plies;         // ...for this many consecutive plies
+    int resign_score;       // Win when both sides agree on a score beyond resign_score...
+    int resign_plies;       // ...for this many consecutive plies
+
+    // SPRT: H0 elo = elo0 against H1 elo = elo1, error rates alpha and beta
+    double elo0;
+    double elo1;
+    double alpha;
+    double beta;
+} MatchConfig;
+
+typedef struct {
+    pid_t pid;
+    FILE* in;   // Engine's stdin
+    FILE* out;  // Engine's stdout
+    char* line;
+    size_t line_capacity;
+} EngineProcess;
+
+static struct {
+    pthread_mutex_t mutex;
+    char** openings;
+    int opening_count;
+    int next_game;
+    int finished_games;
+    int wins;
+    int losses;
+    int draws;
+    bool stop;
+    long start_time;
+    FILE* out;
+} match_state = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// Serializes pipe creation and fork, so that no engine inherits another one's pipes
+static pthread_mutex_t spawn_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// --- Engine Processes ---
+
+static void send_command(EngineProcess* engine, const char* command) {
+    fprintf(engine->in, "%s\n", command);
+    fflush(engine->in);
+}
+
+// Returns the next output line without the newline, or NULL if the engine died
+static const char* read_line(EngineProcess* engine) {
+    ssize_t length = getline(&engine->line, &engine->line_capacity, engine->out);
+    if (length < 0) {
+        return NULL;
+    }
+    while (length > 0 && (engine->line[length - 1] == '\n' || engine->line[length - 1] == '\r')) {
+        engine->line[--length] = '\0';
+    }
+    return engine->line;
+}
+
+// Reads lines until one starts with the given word; returns false if the engine died
+static bool wait_for(EngineProcess* engine, const char* word) {
+    size_t length = strlen(word);
+    const char* line;
+    while ((line = read_line(engine)) != NULL) {
+        if (strncmp(line, word, length) == 0 && (line[length] == '\0' || line[length] == ' ')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void stop_engine(EngineProcess* engine) {
+    if (engine->pid <= 0) {
+        return;
+    }
+    send_command(engine, "quit");
+    fclose(engine->in);
+    fclose(engine->out);
+    free(engine->line);
+    waitpid(engine->pid, NULL, 0);
+    memset(engine, 0, sizeof(*engine));
+}
+
+static bool start_engine(EngineProcess* engine, const EngineConfig* config, const MatchConfig* match) {
+    memset(engine, 0, sizeof(*engine));
+    int to_engine[2];
+    int from_engine[2];
+
+    pthread_mutex_lock(&spawn_mutex);
+    if (pipe(to_engine) != 0) {
+        pthread_mutex_unlock(&spawn_mutex);
+        return false;
+    }
+    if (pipe(from_engine) != 0) {
+        close(to_engine[0]);
+        close(to_engine[1]);
+        pthread_mutex_unlock(&spawn_mutex);
+        return false;
+    }
+    int fds[4] = { to_engine[0], to_engine[1], from_engine[0], from_engine[1] };
+    for (int i = 0; i < 4; ++i) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(to_engine[0], STDIN_FILENO);
+        dup2(from_engine[1], STDOUT_FILENO);
+        execlp(config->path, config->path, "uci", (char*)NULL);
+        _exit(127);
+    }
+    pthread_mutex_unlock(&spawn_mutex);
+
+    close(to_engine[0]);
+    close(from_engine[1]);
+    if (pid < 0) {
+        close(to_engine[1]);
+        close(from_engine[0]);
+        return false;
+    }
+    engine->pid = pid;
+    engine->in = fdopen(to_engine[1], "w");
+    engine->out = fdopen(from_engine[0], "r");
+
+    send_command(engine, "uci");
+    if (!wait_for(engine, "uciok")) {
+        stop_engine(engine);
+        return false;
+    }
+
+    char command[256];
+    snprintf(command, sizeof(command), "setoption name Hash value %d", match->hash_mb);
+    send_command(engine, command);
+    send_command(engine, "setoption name Threads value 1");
+    for (int i = 0; i < config->param_count; ++i) {
+        const char* separator = strchr(config->params[i], '=');
+        if (separator == NULL) continue;
+        snprintf(command, sizeof(command), "setoption name %.*s value %s",
+                 (int)(separator - config->params[i]), config->params[i], separator + 1);
+        send_command(engine, command);
+    }
+    send_command(engine, "isready");
+    if (!wait_for(engine, "readyok")) {
+        stop_engine(engine);
+        return false;
+    }
+    return true;
+}
+
+// Sends the position and go commands and reads the reply. Returns false if the
+// engine died. *score is the last reported score (side to move's view), if any.
+static bool engine_think(EngineProcess* engine, const char* position, const char* go,
+                         Move* move, int* score, bool* has_score) {
+    send_command(engine, position);
+    send_command(engine, go);
+
+    *has_score = false;
+    const char* line;
+    while ((line = read_line(engine)) != NULL) {
+        if (strncmp(line, "info ", 5) == 0) {
+            const char* score_str = strstr(line, " score cp ");
+            if (score_str != NULL) {
+                *score = atoi(score_str + 10);
+                *has_score = true;
+            }
+        } else if (strncmp(line, "bestmove ", 9) == 0) {
+            char move_str[8] = "";
+            sscanf(line + 9, "%7s", move_str);
+            *move = parse_move_string(move_str);
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Games ---
+
+static bool is_legal_move(Board* board, Move move) {
+    MoveList legal_moves;
+    generate_legal_moves(board, &legal_moves);
+    for (int i = 0; i < legal_moves.count; ++i) {
+        if (is_same_move(legal_moves.moves[i], move)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The board keeps a bounded repetition history; games track repetitions themselves
+static void play_move(Board* board, Move move) {
+    move_piece(board, move.from_sq, move.to_sq);
+    if (board->history_ply >= MAX_HISTORY / 2) {
+        trim_history(board, MAX_HISTORY / 4);
+    }
+}
+
+// Sets up the opening (a FEN, or coordinate moves from the start position).
+// Writes the base of the position command and returns false if the opening is invalid.
+static bool setup_opening(const char* opening, Board* board, char* position, size_t position_size, int* ply) {
+    *ply = 0;
+    if (strchr(opening, '/') != NULL) {
+        init_board(board, opening);
+        snprintf(position, position_size, "position fen %s moves", opening);
+        return true;
+    }
+
+    init_board(board, NULL);
+    snprintf(position, position_size, "position startpos moves");
+    char move_str[8];
+    int offset = 0;
+    int consumed;
+    while (sscanf(opening + offset, "%7s%n", move_str, &consumed) == 1) {
+        offset += consumed;
+        Move move = parse_move_string(move_str);
+        if (!is_legal_move(board, move)) {
+            return false;
+        }
+        play_move(board, move);
+        strncat(position, " ", position_size - strlen(position) - 1);
+        strncat(position, move_str, position_size - strlen(position) - 1);
+        (*ply)++;
+    }
+    return true;
+}
+
+// Plays one game. engines[0] is engine 1. Returns the result from engine 1's
+// point of view; *crashed is set if an engine must be restarted.
+static int play_game(EngineProcess engines[2], const MatchConfig* config, const char* opening,
+                     bool engine1_red, const char** reason, int* plies, bool* crashed) {
+    Board board;
+    char position[MATCH_POSITION_BUFFER];
+    int ply;
+    *crashed = false;
+
+    if (!setup_opening(opening, &board, position, sizeof(position), &ply)) {
+        *reason = "invalid opening";
+        *plies = 0;
+        return RESULT_DRAW;
+    }
+    for (int i = 0; i < 2; ++i) {
+        send_command(&engines[i], "ucinewgame");
+        send_command(&engines[i], "isready");
+        if (!wait_for(&engines[i], "readyok")) {
+            *crashed = true;
+            *reason = "engine crashed";
+            *plies = ply;
+            return (i == 0) ? RESULT_LOSS : RESULT_WIN;
+        }
+    }
+
+    // Own repetition record: the board's history is trimmed in long games
+    uint64_t keys[MATCH_MAX_PLIES + 1];
+    int key_count = 0;
+    keys[key_count++] = board.hash_key;
+
+    long clocks[2] = { config->tc_base, config->tc_base }; // [red, black]
+    int scores[MATCH_MAX_PLIES];                        // Mover's score of each ply
+    bool has_scores[MATCH_MAX_PLIES];
+    int game_plies = 0;
+    int result;
+
+    for (;;) {
+        int side = (board.player_to_move == PLAYER_R) ? 0 : 1;
+        int mover = (side == 0) == engine1_red ? 0 : 1; // Engine index
+        int engine1_sign = (mover == 0) ? 1 : -1;         // A win for the mover, seen by engine 1
+
+        // In Xiangqi a side without legal moves loses, whether mated or stalemated
+        MoveList legal_moves;
+        generate_legal_moves(&board, &legal_moves);
+        if (legal_moves.count == 0) {
+            *reason = is_king_in_check(&board, board.player_to_move) ? "checkmate" : "stalemate";
+            result = -engine1_sign;
+            break;
+        }
+
+        // Threefold repetition is a draw; perpetual check and chase rules are not modeled
+        int repetitions = 0;
+        for (int i = key_count - 3; i >= 0; i -= 2) {
+            if (keys[i] == board.hash_key) repetitions++;
+        }
+        if (repetitions >= 2) {
+            *reason = "repetition";
+            result = RESULT_DRAW;
+            break;
+        }
+        if (game_plies >= config->max_plies || ply >= MATCH_MAX_PLIES) {
+            *reason = "move limit";
+            result = RESULT_DRAW;
+            break;
+        }
+
+        char go[160];
+        if (config->tc_base > 0) {
+            snprintf(go, sizeof(go), "go wtime %ld btime %ld winc %ld binc %ld",
+                     clocks[0], clocks[1], config->tc_inc, config->tc_inc);
+        } else if (config->movetime > 0) {
+            snprintf(go, sizeof(go), "go movetime %ld", config->movetime);
+        } else if (config->depth > 0) {
+            snprintf(go, sizeof(go), "go depth %d", config->depth);
+        } else {
+            snprintf(go, sizeof(go), "go nodes %llu", config->nodes);
+        }
+
+        Move move;
+        int score = 0;
+        bool has_score;
+        long start = now_ms();
+        if (!engine_think(&engines[mover], position, go, &move, &score, &has_score)) {
+            *crashed = true;
+            *reason = "engine crashed";
+            result = -engine1_sign;
+            break;
+        }
+        if (config->tc_base > 0) {
+            clocks[side] -= now_ms() - start;
+            if (clocks[side] < 0) {
+                *reason = "time forfeit";
+                result = -engine1_sign;
+                break;
+            }
+            clocks[side] += config->tc_inc;
+        }
+        if (!is_legal_move(&board, move)) {
+            *reason = "illegal move";
+            result = -engine1_sign;
+            break;
+        }
+
+        char move_str[5];
+        move_to_string(move, move_str);
+        strncat(position, " ", sizeof(position) - strlen(position) - 1);
+        strncat(position, move_str, sizeof(position) - strlen(position) - 1);
+        play_move(&board, move);
+        keys[key_count++] = board.hash_key;
+        scores[game_plies] = score;
+        has_scores[game_plies] = has_score;
+        game_plies++;
+        ply++;
+
+        // Score adjudication over the last plies, alternating between both engines
+        int resign_count = 0;
+        int draw_count = 0;
+        for (int i = game_plies - 1; i >= 0 && has_scores[i]; --i) {
+            bool mover_winning = ((game_plies - 1 - i) % 2 == 0) ? scores[i] >= config->resign_score
+                                                                  : scores[i] <= -config->resign_score;
+            if (mover_winning && resign_count == game_plies - 1 - i) resign_count++;
+            if (abs(scores[i]) <= config->draw_score && draw_count == game_plies - 1 - i) draw_count++;
+        }
+        if (config->resign_plies > 0 && resign_count >= config->resign_plies) {
+            *reason = "score adjudication";
+            result = engine1_sign;
+            break;
+        }
+        if (config->draw_plies > 0 && game_plies >= config->draw_min_ply && draw_count >= config->draw_plies) {
+            *reason = "draw adjudication";
+            result = RESULT_DRAW;
+            break;
+        }
+    }
+
+    *plies = ply;
+    return result;
+}
+
+// --- Statistics ---
+
+static double score_to_elo(double score) {
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Elo difference with its 95% confidence half-width, and the log-likelihood
+// ratio of the SPRT (normal approximation of the trinomial game outcome)
+static void match_statistics(const MatchConfig* config, int wins, int losses, int draws,
+                             double* elo, double* elo_error, double* llr) {
+    int games = wins + losses + draws;
+    *elo = *elo_error = *llr = 0.0;
+    if (games == 0) {
+        return;
+    }
+
+    double score = (wins + 0.5 * draws) / games;
+    double variance = (wins * pow(1.0 - score, 2) + draws * pow(0.5 - score, 2) + losses * pow(score, 2)) / games;
+
+    double clamped = fmin(fmax(score, 0.001), 0.999);
+    double margin = 1.96 * sqrt(variance / games);
+    *elo = score_to_elo(clamped);
+    double upper = score_to_elo(fmin(clamped + margin, 0.999));
+    double lower = score_to_elo(fmax(clamped - margin, 0.001));
+    *elo_error = (upper - lower) / 2.0;
+
+    if (variance > 0.0) {
+        double s0 = 1.0 / (1.0 + pow(10.0, -config->elo0 / 400.0));
+        double s1 = 1.0 / (1.0 + pow(10.0, -config->elo1 / 400.0));
+        *llr = (s1 - s0) * (2.0 * (wins + 0.5 * draws) - games * (s0 + s1)) / (2.0 * variance);
+    }
+}
+
+static void record_result(const MatchConfig* config, int game, int opening, bool engine1_red,
+                          int result, const char* reason, int plies) {
+    pthread_mutex_lock(&match_state.mutex);
+
+    if (result == RESULT_WIN) match_state.wins++;
+    else if (result == RESULT_LOSS) match_state.losses++;
+    else match_state.draws++;
+    match_state.finished_games++;
+
+    double elo, elo_error, llr;
+    match_statistics(config, match_state.wins, match_state.losses, match_state.draws, &elo, &elo_error, &llr);
+    double lower_bound = log(config->beta / (1.0 - config->alpha));
+    double upper_bound = log((1.0 - config->beta) / config->alpha);
+    long elapsed = now_ms() - match_state.start_time;
+    double games_per_hour = match_state.finished_games * 3600000.0 / (elapsed > 0 ? elapsed : 1);
+
+    const char* result_str = (result == RESULT_DRAW) ? "1/2-1/2"
+                           : ((result == RESULT_WIN) == engine1_red) ? "1-0" : "0-1";
+    printf("Game %d (opening %d, engine 1 %s): %s %s, %d plies | Score +%d -%d =%d, "
+           "Elo %.1f +/- %.1f, LLR %.2f [%.2f, %.2f], %.0f games/h\n",
+           game + 1, opening + 1, engine1_red ? "red" : "black", result_str, reason, plies,
+           match_state.wins, match_state.losses, match_state.draws,
+           elo, elo_error, llr, lower_bound, upper_bound, games_per_hour);
+    fflush(stdout);
+
+    if (match_state.out) {
+        fprintf(match_state.out,
+                "{\"game\":%d,\"opening\":%d,\"engine1_red\":%s,\"result\":\"%s\",\"reason\":\"%s\",\"plies\":%d,"
+                "\"wins\":%d,\"losses\":%d,\"draws\":%d,\"elo\":%.2f,\"elo_error\":%.2f,\"llr\":%.3f,"
+                "\"games_per_hour\":%.1f}\n",
+                game + 1, opening + 1, engine1_red ? "true" : "false", result_str, reason, plies,
+                match_state.wins, match_state.losses, match_state.draws, elo, elo_error, llr, games_per_hour);
+        fflush(match_state.out);
+    }
+
+    if (llr >= upper_bound || llr <= lower_bound) {
+        if (!match_state.stop) {
+            printf("SPRT finished: %s accepted\n", llr >= upper_bound ? "H1" : "H0");
+        }
+        match_state.stop = true;
+    }
+
+    pthread_mutex_unlock(&match_state.mutex);
+}
+
+// --- Match ---
+
+// Each worker owns a pair of engine processes and plays games until the match ends
+static void* match_worker(void* arg) {
+    const MatchConfig* config = (const MatchConfig*)arg;
+    EngineProcess engines[2];
+    bool engines_running = false;
+
+    for (;;) {
+        pthread_mutex_lock(&match_state.mutex);
+        if (match_state.stop || match_state.next_game >= config->games) {
+            pthread_mutex_unlock(&match_state.mutex);
+            break;
+        }
+        int game = match_state.next_game++;
+        pthread_mutex_unlock(&match_state.mutex);
+
+        if (!engines_running) {
+            if (!start_engine(&engines[0], &config->engines[0], config)) {
+                printf("Could not start engine 1: %s\n", config->engines[0].path);
+                break;
+            }
+            if (!start_engine(&engines[1], &config->engines[1], config)) {
+                printf("Could not start engine 2: %s\n", config->engines[1].path);
+                stop_engine(&engines[0]);
+                break;
+            }
+            engines_running = true;
+        }
+
+        // Each opening is played twice, with colors swapped
+        int opening = (game / 2) % match_state.opening_count;
+        bool engine1_red = (game % 2 == 0);
+        const char* reason;
+        int plies;
+        bool crashed;
+        int result = play_game(engines, config, match_state.openings[opening], engine1_red, &reason, &plies, &crashed);
+        record_result(config, game, opening, engine1_red, result, reason, plies);
+
+        if (crashed) {
+            stop_engine(&engines[0]);
+            stop_engine(&engines[1]);
+            engines_running = false;
+        }
+    }
+
+    if (engines_running) {
+        stop_engine(&engines[0]);
+        stop_engine(&engines[1]);
+    }
+    return NULL;
+}
+
+// Reads one opening per line; empty lines and lines starting with '#' are skipped
+static bool load_openings(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Could not open openings file: %s\n", path);
+        return false;
+    }
+    char* line = NULL;
+    size_t capacity = 0;
+    int allocated = 0;
+    while (getline(&line, &capacity, file) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (match_state.opening_count == allocated) {
+            allocated = allocated ? allocated * 2 : 64;
+            match_state.openings = (char**)realloc(match_state.openings, allocated * sizeof(char*));
+        }
+        match_state.openings[match_state.opening_count++] = strdup(line);
+    }
+    free(line);
+    fclose(file);
+    if (match_state.opening_count == 0) {
+        printf("No openings found in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void print_usage() {
+    printf("Usage: xiangqi match [options]\n"
+           "  -engine1 <path>, -engine2 <path>   Engine binaries (default: this program)\n"
+           "  -param1 <name=value>, -param2 ...  UCI option or search parameter, repeatable\n"
+           "  -games <n>                         Maximum number of games (default 1000)\n"
+           "  -concurrency <n>                   Games played in parallel (default: all cores)\n"
+           "  -nodes <n> | -movetime <ms> | -depth <d> | -tc <base_ms>+<inc_ms>\n"
+           "                                     Time control (default: -nodes 20000)\n"
+           "  -hash <mb>                         Hash size of each engine (default 16)\n"
+           "  -openings <file>                   One FEN or move list per line\n"
+           "  -sprt <elo0> <elo1> [alpha beta]   SPRT bounds (default 0 5 0.05 0.05)\n"
+           "  -maxplies <n>                      Draw after n plies (default 300)\n"
+           "  -draw <min_ply> <score> <plies>    Draw adjudication (default 80 10 10)\n"
+           "  -resign <score> <plies>            Win adjudication (default 1000 6)\n"
+           "  -out <file>                        Append one JSON record per game\n");
+}
+
+int run_match(int argc, char* argv[]) {
+    MatchConfig config = {
+        .engines = { { .path = argv[0] }, { .path = argv[0] } },
+        .games = 1000,
+        .concurrency = (int)sysconf(_SC_NPROCESSORS_ONLN),
+        .hash_mb = 16,
+        .nodes = 20000,
+        .max_plies = 300,
+        .draw_min_ply = 80,
+        .draw_score = 10,
+        .draw_plies = 10,
+        .resign_score = 1000,
+        .resign_plies = 6,
+        .elo0 = 0.0,
+        .elo1 = 5.0,
+        .alpha = 0.05,
+        .beta = 0.05,
+    };
+
+    for (int i = 2; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-engine1") == 0 && remaining >= 1) {
+            config.engines[0].path = argv[++i];
+        } else if (strcmp(option, "-engine2") == 0 && remaining >= 1) {
+            config.engines[1].path = argv[++i];
+        } else if ((strcmp(option, "-param1") == 0 || strcmp(option, "-param2") == 0) && remaining >= 1) {
+            EngineConfig* engine = &config.engines[option[6] - '1'];
+            if (engine->param_count < MATCH_MAX_PARAMS) {
+                engine->params[engine->param_count++] = argv[i + 1];
+            }
+            ++i;
+        } else if (strcmp(option, "-games") == 0 && remaining >= 1) {
+            config.games = atoi(argv[++i]);
+        } else if (strcmp(option, "-concurrency") == 0 && remaining >= 1) {
+            config.concurrency = atoi(argv[++i]);
+        } else if (strcmp(option, "-nodes") == 0 && remaining >= 1) {
+            config.nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(option, "-movetime") == 0 && remaining >= 1) {
+            config.movetime = atol(argv[++i]);
+        } else if (strcmp(option, "-depth") == 0 && remaining >= 1) {
+            config.depth = atoi(argv[++i]);
+        } else if (strcmp(option, "-tc") == 0 && remaining >= 1) {
+            if (sscanf(argv[++i], "%ld+%ld", &config.tc_base, &config.tc_inc) < 1) {
+                print_usage();
+                return 1;
+            }
+        } else if (strcmp(option, "-hash") == 0 && remaining >= 1) {
+            config.hash_mb = atoi(argv[++i]);
+        } else if (strcmp(option, "-openings") == 0 && remaining >= 1) {
+            config.openings_path = argv[++i];
+        } else if (strcmp(option, "-out") == 0 && remaining >= 1) {
+            config.out_path = argv[++i];
+        } else if (strcmp(option, "-maxplies") == 0 && remaining >= 1) {
+            config.max_plies = atoi(argv[++i]);
+        } else if (strcmp(option, "-sprt") == 0 && remaining >= 2) {
+            config.elo0 = atof(argv[++i]);
+            config.elo1 = atof(argv[++i]);
+            if (remaining >= 4 && argv[i + 1][0] != '-') {
+                config.alpha = atof(argv[++i]);
+                config.beta = atof(argv[++i]);
+            }
+        } else if (strcmp(option, "-draw") == 0 && remaining >= 3) {
+            config.draw_min_ply = atoi(argv[++i]);
+            config.draw_score = atoi(argv[++i]);
+            config.draw_plies = atoi(argv[++i]);
+        } else if (strcmp(option, "-resign") == 0 && remaining >= 2) {
+            config.resign_score = atoi(argv[++i]);
+            config.resign_plies = atoi(argv[++i]);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (config.concurrency < 1) config.concurrency = 1;
+    if (config.concurrency > MATCH_MAX_THREADS) config.concurrency = MATCH_MAX_THREADS;
+    if (config.alpha <= 0.0 || config.beta <= 0.0 || config.alpha >= 1.0 || config.beta >= 1.0) {
+        print_usage();
+        return 1;
+    }
+
+    Board board;
+    init_board(&board, NULL); // Bitboard masks and Zobrist keys
+    init_move_generator();
+    init_endgames();
+
+    if (config.openings_path) {
+        if (!load_openings(config.openings_path)) {
+            return 1;
+        }
+    } else {
+        match_state.opening_count = sizeof(DEFAULT_OPENINGS) / sizeof(DEFAULT_OPENINGS[0]);
+        match_state.openings = (char**)malloc(match_state.opening_count * sizeof(char*));
+        for (int i = 0; i < match_state.opening_count; ++i) {
+            match_state.openings[i] = strdup(DEFAULT_OPENINGS[i]);
+        }
+    }
+
+    if (config.out_path) {
+        match_state.out = fopen(config.out_path, "a");
+        if (!match_state.out) {
+            printf("Could not open output file: %s\n", config.out_path);
+            return 1;
+        }
+    }
+
+    // A dying engine must not kill the runner while it writes to the pipe
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Match: %s vs %s, %d games, %d concurrent, %d openings\n",
+           config.engines[0].path, config.engines[1].path, config.games, config.concurrency,
+           match_state.opening_count);
+    match_state.start_time = now_ms();
+
+    pthread_t workers[MATCH_MAX_THREADS];
+    for (int i = 0; i < config.concurrency; ++i) {
+        pthread_create(&workers[i], NULL, match_worker, &config);
+    }
+    for (int i = 0; i < config.concurrency; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    double elo, elo_error, llr;
+    match_statistics(&config, match_state.wins, match_state.losses, match_state.draws, &elo, &elo_error, &llr);
+    printf("Finished %d games: +%d -%d =%d, Elo %.1f +/- %.1f, LLR %.2f\n",
+           match_state.finished_games, match_state.wins, match_state.losses, match_state.draws,
+           elo, elo_error, llr);
+
+    if (match_state.out) {
+        fclose(match_state.out);
+    }
+    for (int i = 0; i < match_state.opening_count; ++i) {
+        free(match_state.openings[i]);
+    }
+    free(match_state.openings);
+    return match_state.finished_games > 0 ? 0 : 1;
+}
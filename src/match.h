@@ -0,0 +1,12 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+// Engine-vs-engine match runner: "xiangqi match [options]".
+// Plays games between two UCI engine processes (two builds, or one build with
+// two parameter sets) concurrently, with an opening suite, fixed node/time
+// controls, adjudication and an SPRT stopping rule. Results are reported after
+// every game. argv[0] is the program itself, the default engine for both sides.
+// Returns the process exit code.
+int run_match(int argc, char* argv[]);
+
+#endif // MATCH_H
@@ -248,7 +248,7 @@ U128 get_cannon_moves_bb(int sq, U128 occupied) {
         attacks |= (ray ^ RAYS[3][screen]) ^ SQUARE_MASKS[screen];
         U128 remaining_blockers = blockers_w ^ SQUARE_MASKS[screen];
         if (remaining_blockers) {
-            target = get_lsb_index(remaining_blockers);
+            target = get_msb_index(remaining_blockers);
             attacks |= SQUARE_MASKS[target];
         }
     } else {
@@ -557,3 +557,27 @@ void generate_capture_moves(Board* board, MoveList* move_list) {
         }
     }
 }
+
+// --- Move Notation ---
+
+void move_to_string(Move move, char* str) {
+    // Files a-i from left to right, ranks 0-9 from Red's side
+    str[0] = 'a' + move.from_sq % 9;
+    str[1] = '0' + (9 - move.from_sq / 9);
+    str[2] = 'a' + move.to_sq % 9;
+    str[3] = '0' + (9 - move.to_sq / 9);
+    str[4] = '\0';
+}
+
+Move parse_move_string(const char* str) {
+    for (int i = 0; i < 4; ++i) {
+        char lo = (i % 2 == 0) ? 'a' : '0';
+        char hi = (i % 2 == 0) ? 'i' : '9';
+        if (str[i] < lo || str[i] > hi) return (Move){0, 0};
+    }
+    if (str[4] != '\0') return (Move){0, 0};
+
+    int from_sq = (9 - (str[1] - '0')) * 9 + (str[0] - 'a');
+    int to_sq = (9 - (str[3] - '0')) * 9 + (str[2] - 'a');
+    return (Move){from_sq, to_sq};
+}
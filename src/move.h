@@ -25,6 +25,11 @@ typedef struct {
     // We can add captured_piece, promotion, etc. later if needed
 } Move;
 
+// Returns true if both moves have the same source and destination squares
+static inline bool is_same_move(Move a, Move b) {
+    return a.from_sq == b.from_sq && a.to_sq == b.to_sq;
+}
+
 // A list to store generated moves
 #define MAX_MOVES 256
 typedef struct {
@@ -57,4 +62,12 @@ bool is_king_in_check(const Board* board, int player);
 U128 get_rook_moves_bb(int sq, U128 occupied);
 U128 get_cannon_moves_bb(int sq, U128 occupied);
 
+// --- Move Notation ---
+
+// Writes the move in coordinate notation (e.g. "h2e2"); str must hold 5 chars
+void move_to_string(Move move, char* str);
+
+// Parses a move in coordinate notation. Returns a null move {0,0} if malformed.
+Move parse_move_string(const char* str);
+
 #endif // MOVE_H
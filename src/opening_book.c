@@ -1,58 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "opening_book.h"
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(BookHeader) == 24, "BookHeader must match the file format");
+_Static_assert(sizeof(BookPosition) == 16, "BookPosition must match the file format");
+_Static_assert(sizeof(BookMove) == 4, "BookMove must match the file format");
 
-static BookEntry* opening_book = NULL;
-static int book_size = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The opening book file is read in place and requires a little-endian host"
+#endif
 
-void load_opening_book(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        printf("Could not open opening book file: %s\n", filename);
-        return;
+static void* book_mapping = NULL;
+static size_t book_bytes = 0;
+static const BookPosition* book_positions = NULL;
+static const BookMove* book_moves = NULL;
+static uint32_t book_position_count = 0;
+
+void close_opening_book() {
+    if (book_mapping) {
+        munmap(book_mapping, book_bytes);
     }
+    book_mapping = NULL;
+    book_positions = NULL;
+    book_moves = NULL;
+    book_position_count = 0;
+}
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+// Returns NULL if the mapped file is a valid book, otherwise the reason
+static const char* check_book(const void* data, size_t bytes) {
+    if (bytes < sizeof(BookHeader)) {
+        return "truncated file";
+    }
+    const BookHeader* header = (const BookHeader*)data;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0) {
+        return "not a book file";
+    }
+    if (header->version != BOOK_VERSION) {
+        return "unsupported format version";
+    }
+    if (bytes != sizeof(BookHeader) + (size_t)header->position_count * sizeof(BookPosition)
+                 + (size_t)header->move_count * sizeof(BookMove)) {
+        return "file size does not match its header";
+    }
 
-    if (file_size > 0) {
-        book_size = file_size / sizeof(BookEntry);
-        opening_book = (BookEntry*)malloc(file_size);
-        if (opening_book) {
-            fread(opening_book, sizeof(BookEntry), book_size, file);
-            printf("Opening book loaded with %d entries.\n", book_size);
-        } else {
-            printf("Failed to allocate memory for opening book.\n");
-            book_size = 0;
+    // Checked once here, so that queries need no bounds checks
+    const BookPosition* positions = (const BookPosition*)(header + 1);
+    for (uint32_t i = 0; i < header->position_count; ++i) {
+        if ((uint64_t)positions[i].first_move + positions[i].move_count > header->move_count) {
+            return "move index out of range";
+        }
+        if (i > 0 && positions[i].hash_key <= positions[i - 1].hash_key) {
+            return "positions not sorted";
         }
     }
+    return NULL;
+}
+
+bool load_opening_book(const char* filename) {
+    close_opening_book();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open opening book file: %s\n", filename);
+        return false;
+    }
+    struct stat file_stat;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map opening book file: %s\n", filename);
+        return false;
+    }
+
+    const char* error = check_book(data, (size_t)file_stat.st_size);
+    if (error != NULL) {
+        fprintf(stderr, "Invalid opening book file %s: %s.\n", filename, error);
+        munmap(data, (size_t)file_stat.st_size);
+        return false;
+    }
 
-    fclose(file);
+    const BookHeader* header = (const BookHeader*)data;
+    book_mapping = data;
+    book_bytes = (size_t)file_stat.st_size;
+    book_positions = (const BookPosition*)(header + 1);
+    book_moves = (const BookMove*)(book_positions + header->position_count);
+    book_position_count = header->position_count;
+    fprintf(stderr, "Opening book loaded with %u positions and %u moves.\n", header->position_count, header->move_count);
+    return true;
+}
+
+static const BookPosition* find_position(uint64_t hash_key) {
+    uint32_t low = 0;
+    uint32_t high = book_position_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (book_positions[mid].hash_key < hash_key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < book_position_count && book_positions[low].hash_key == hash_key) {
+        return &book_positions[low];
+    }
+    return NULL;
 }
 
 Move query_opening_book(Board* board) {
-    if (!opening_book || book_size == 0) {
+    if (book_position_count == 0) {
+        return (Move){0, 0};
+    }
+
+    const BookPosition* position = find_position(board->hash_key);
+    if (position == NULL) {
         return (Move){0, 0};
     }
 
-    uint64_t current_hash = board->hash_key;
-    Move possible_moves[MAX_MOVES];
-    int num_possible_moves = 0;
+    // Only legal moves are played: a key collision must not yield an illegal move
+    MoveList legal_moves;
+    generate_legal_moves(board, &legal_moves);
+    Move candidates[MAX_MOVES];
+    uint32_t weights[MAX_MOVES];
+    int count = 0;
+    uint32_t total_weight = 0;
 
-    for (int i = 0; i < book_size; ++i) {
-        if (opening_book[i].hash_key == current_hash) {
-            if (num_possible_moves < MAX_MOVES) {
-                possible_moves[num_possible_moves++] = opening_book[i].move;
+    for (int i = 0; i < position->move_count && count < MAX_MOVES; ++i) {
+        const BookMove* book_move = &book_moves[position->first_move + i];
+        Move move = {book_move->from_sq, book_move->to_sq};
+        for (int j = 0; j < legal_moves.count; ++j) {
+            if (is_same_move(legal_moves.moves[j], move)) {
+                candidates[count] = move;
+                weights[count] = book_move->weight;
+                total_weight += book_move->weight;
+                count++;
+                break;
             }
         }
     }
 
-    if (num_possible_moves > 0) {
-        // Return a random move from the possible moves
-        return possible_moves[rand() % num_possible_moves];
+    if (count == 0 || total_weight == 0) {
+        return (Move){0, 0};
     }
 
-    return (Move){0, 0};
+    // Pick a move with a probability proportional to its weight
+    uint32_t pick = (uint32_t)rand() % total_weight;
+    for (int i = 0; i < count; ++i) {
+        if (pick < weights[i]) {
+            return candidates[i];
+        }
+        pick -= weights[i];
+    }
+    return candidates[count - 1];
 }
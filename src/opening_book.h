@@ -3,19 +3,52 @@
 
 #include "bitboard.h"
 #include "move.h"
+#include <stdbool.h>
 #include <stdint.h>
 
-// Represents a single entry in the opening book
+// Book file used unless another one is configured
+#define DEFAULT_BOOK_PATH "opening_book.bin"
+
+// Book file format (version 1, little-endian), written by
+// scripts/create_binary_book.py:
+//   BookHeader
+//   BookPosition[position_count], sorted by hash_key
+//   BookMove[move_count], the moves of each position stored contiguously
+#define BOOK_MAGIC "XQBOOK\0\0"
+#define BOOK_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t position_count;
+    uint32_t move_count;
+    uint32_t reserved;
+} BookHeader;
+
 typedef struct {
     uint64_t hash_key;
-    Move move;
-} BookEntry;
+    uint32_t first_move;    // Index into the move array
+    uint16_t move_count;
+    uint16_t reserved;
+} BookPosition;
+
+typedef struct {
+    uint8_t from_sq;
+    uint8_t to_sq;
+    uint16_t weight;        // Relative frequency of the move
+} BookMove;
+
+// Maps a book file read-only, replacing the current book. The mapping is
+// shared with every other process using the same file. Returns false if the
+// file is missing or invalid; there is no book then.
+bool load_opening_book(const char* filename);
 
-// Loads the opening book from a binary file
-void load_opening_book(const char* filename);
+// Unmaps the current book, if any
+void close_opening_book();
 
-// Queries the opening book for the current board position
-// Returns a random valid move if the position is found, otherwise a null move {0,0}
+// Queries the opening book for the current board position by binary search.
+// Returns one of its legal book moves, chosen at random in proportion to the
+// weights, or a null move {0,0} if the position is not in the book.
 Move query_opening_book(Board* board);
 
 #endif // OPENING_BOOK_H
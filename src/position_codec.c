@@ -0,0 +1,254 @@
+#include "position_codec.h"
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert(sizeof(PackedPosition) == PACKED_POSITION_SIZE, "PackedPosition must stay 28 bytes");
+
+#define MAX_ENCODED_PIECES 32
+
+// Bits 90..94 of the occupancy are unused, bit 95 is the side to move
+#define BLACK_TO_MOVE_BIT 0x80
+#define OCCUPANCY_SPARE_BITS 0x7C
+
+// --- Piece Codes ---
+// Code of a piece: 1..7 for Red, 9..15 for Black (8 + type)
+
+static inline int piece_code(Piece piece) {
+    return (piece > 0) ? piece : 8 - piece;
+}
+
+static const Piece CODE_PIECES[16] = {
+    EMPTY, R_KING, R_GUARD, R_BISHOP, R_HORSE, R_ROOK, R_CANNON, R_PAWN,
+    EMPTY, B_KING, B_GUARD, B_BISHOP, B_HORSE, B_ROOK, B_CANNON, B_PAWN,
+};
+
+// get_piece_to_bb_index() and get_piece_to_zobrist_idx() by code
+static const int CODE_BB_INDEX[16] = { -1, 0, 1, 2, 3, 4, 5, 6, -1, 7, 8, 9, 10, 11, 12, 13 };
+static const int CODE_ZOBRIST_INDEX[16] = { -1, 7, 8, 9, 10, 11, 12, 13, -1, 0, 1, 2, 3, 4, 5, 6 };
+
+// --- Board Building ---
+// Decoders place the pieces into a BoardBuilder, whose keys and bitboards the
+// compiler keeps out of the board until finish_board() stores them
+
+typedef struct {
+    Board* board;
+    uint64_t hash_key;
+    uint64_t material_key;
+    U128 piece_bitboards[14];
+    int count;
+} BoardBuilder;
+
+// Empties everything but the repetition history, which is only reset
+static void start_board(BoardBuilder* builder, Board* board) {
+    memset(board, 0, offsetof(Board, history));
+    memset(builder, 0, sizeof(*builder));
+    builder->board = board;
+}
+
+// set_piece() for a valid code, with the square's Zobrist key indexed directly
+static inline void place_piece(BoardBuilder* builder, int code, int sq) {
+    int bb_idx = CODE_BB_INDEX[code];
+    builder->board->board[sq] = CODE_PIECES[code];
+    builder->piece_bitboards[bb_idx] |= SQUARE_MASKS[sq];
+    builder->hash_key ^= (&zobrist_keys[CODE_ZOBRIST_INDEX[code]][0][0])[sq];
+    builder->material_key += material_key_unit(bb_idx);
+    builder->count++;
+}
+
+// Stores the pieces, the side to move and the history. The board is a
+// position only with at most 32 pieces and one king per side.
+static bool finish_board(BoardBuilder* builder, bool black_to_move) {
+    Board* board = builder->board;
+    for (int i = 0; i < 7; ++i) {
+        board->piece_bitboards[i] = builder->piece_bitboards[i];
+        board->piece_bitboards[i + 7] = builder->piece_bitboards[i + 7];
+        board->color_bitboards[0] |= builder->piece_bitboards[i];
+        board->color_bitboards[1] |= builder->piece_bitboards[i + 7];
+    }
+    board->player_to_move = black_to_move ? PLAYER_B : PLAYER_R;
+    board->hash_key = builder->hash_key ^ (black_to_move ? zobrist_player : 0);
+    board->material_key = builder->material_key;
+    board->history_ply = 0;
+    board->history[0] = board->hash_key;
+    return builder->count <= MAX_ENCODED_PIECES
+           && material_count(builder->material_key, get_piece_to_bb_index(R_KING)) == 1
+           && material_count(builder->material_key, get_piece_to_bb_index(B_KING)) == 1;
+}
+
+// Squares of the low (0..63) and high (64..89) half of a bitboard
+static inline uint64_t low_squares(U128 bb) {
+    return (uint64_t)bb;
+}
+
+static inline uint64_t high_squares(U128 bb) {
+    return (uint64_t)(bb >> 64);
+}
+
+// Visits the squares of a bitboard in increasing order
+static inline int pop_lowest_square(uint64_t* low, uint64_t* high) {
+    if (*low) {
+        int sq = __builtin_ctzll(*low);
+        *low &= *low - 1;
+        return sq;
+    }
+    int sq = 64 + __builtin_ctzll(*high);
+    *high &= *high - 1;
+    return sq;
+}
+
+// --- Packed Encoding ---
+
+bool encode_position(const Board* board, PackedPosition* packed) {
+    U128 occupied = board->color_bitboards[0] | board->color_bitboards[1];
+    uint64_t low = low_squares(occupied);
+    uint64_t high = high_squares(occupied);
+    uint64_t black_to_move = (board->player_to_move == PLAYER_B) ? BLACK_TO_MOVE_BIT : 0;
+    uint64_t occupancy_high = high | (black_to_move << 24);
+    memset(packed->pieces, 0, sizeof(packed->pieces));
+    for (int i = 0; i < 8; ++i) {
+        packed->occupancy[i] = (uint8_t)(low >> (8 * i));
+    }
+    for (int i = 0; i < 4; ++i) {
+        packed->occupancy[8 + i] = (uint8_t)(occupancy_high >> (8 * i));
+    }
+
+    // Two pieces per byte
+    for (int i = 0; low | high; ++i) {
+        if (i == MAX_ENCODED_PIECES / 2) {
+            return false;
+        }
+        int code = piece_code(board->board[pop_lowest_square(&low, &high)]);
+        if (low | high) {
+            code |= piece_code(board->board[pop_lowest_square(&low, &high)]) << 4;
+        }
+        packed->pieces[i] = (uint8_t)code;
+    }
+    return true;
+}
+
+bool decode_position(const PackedPosition* packed, Board* board) {
+    uint64_t low = 0, high = 0;
+    for (int i = 0; i < 8; ++i) {
+        low |= (uint64_t)packed->occupancy[i] << (8 * i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        high |= (uint64_t)packed->occupancy[8 + i] << (8 * i);
+    }
+    if (packed->occupancy[11] & OCCUPANCY_SPARE_BITS) {
+        return false;
+    }
+    bool black_to_move = (high >> 31) & 1;
+    high &= (1ULL << 26) - 1;
+
+    BoardBuilder builder;
+    start_board(&builder, board);
+    for (int i = 0; (low | high) && i < MAX_ENCODED_PIECES; ++i) {
+        int code = (packed->pieces[i >> 1] >> ((i & 1) * 4)) & 0xF;
+        if ((code & 7) == 0) {
+            return false;
+        }
+        place_piece(&builder, code, pop_lowest_square(&low, &high));
+    }
+    return (low | high) == 0 && finish_board(&builder, black_to_move);
+}
+
+// --- Huffman Encoding ---
+
+// Code of every piece code, written least significant bit first: the
+// occupied bit, the piece type and the color bit
+static const struct {
+    uint8_t bits;
+    uint8_t length;
+} HUFFMAN_CODES[16] = {
+    {0, 1}, {31, 6}, {3, 5}, {11, 5}, {7, 6}, {23, 6}, {15, 6}, {1, 3},
+    {0, 1}, {63, 6}, {19, 5}, {27, 5}, {39, 6}, {55, 6}, {47, 6}, {5, 3},
+};
+
+// Piece code (low nibble, 0 for an empty square) and code length (high
+// nibble) by the next six bits of the stream
+static const uint8_t HUFFMAN_DECODE[64] = {
+    0x10, 0x37, 0x10, 0x52, 0x10, 0x3f, 0x10, 0x64, 0x10, 0x37, 0x10, 0x53, 0x10, 0x3f, 0x10, 0x66,
+    0x10, 0x37, 0x10, 0x5a, 0x10, 0x3f, 0x10, 0x65, 0x10, 0x37, 0x10, 0x5b, 0x10, 0x3f, 0x10, 0x61,
+    0x10, 0x37, 0x10, 0x52, 0x10, 0x3f, 0x10, 0x6c, 0x10, 0x37, 0x10, 0x53, 0x10, 0x3f, 0x10, 0x6e,
+    0x10, 0x37, 0x10, 0x5a, 0x10, 0x3f, 0x10, 0x6d, 0x10, 0x37, 0x10, 0x5b, 0x10, 0x3f, 0x10, 0x69,
+};
+
+int encode_position_huffman(const Board* board, uint8_t* data) {
+    U128 occupied = board->color_bitboards[0] | board->color_bitboards[1];
+    uint64_t low = low_squares(occupied);
+    uint64_t high = high_squares(occupied);
+
+    // Bits are gathered in a 64-bit window and written a byte at a time;
+    // empty squares are zero bits, so runs of them only advance the position
+    uint64_t window = (board->player_to_move == PLAYER_B) ? 1 : 0;
+    int bits = 1;
+    int size = 0;
+    int next_sq = 0;
+    for (int count = 0; low | high; ++count) {
+        if (count == MAX_ENCODED_PIECES) {
+            return -1;
+        }
+        int sq = pop_lowest_square(&low, &high);
+        bits += sq - next_sq;
+        while (bits >= 8) {
+            data[size++] = (uint8_t)window;
+            window >>= 8;
+            bits -= 8;
+        }
+        int code = piece_code(board->board[sq]);
+        window |= (uint64_t)HUFFMAN_CODES[code].bits << bits;
+        bits += HUFFMAN_CODES[code].length;
+        next_sq = sq + 1;
+    }
+    bits += 90 - next_sq;
+    while (bits > 0) {
+        data[size++] = (uint8_t)window;
+        window >>= 8;
+        bits -= 8;
+    }
+    return size;
+}
+
+int decode_position_huffman(const uint8_t* data, size_t size, Board* board) {
+    if (size == 0) {
+        return -1;
+    }
+    bool black_to_move = data[0] & 1;
+    uint64_t window = data[0] >> 1;
+    int available = 7;      // Bits in the window, at most 63
+    size_t next_byte = 1;
+    BoardBuilder builder;
+    start_board(&builder, board);
+
+    int sq = 0;
+    while (sq < 90) {
+        while (available < 56 && next_byte < size) {
+            window |= (uint64_t)data[next_byte++] << available;
+            available += 8;
+        }
+        if (available == 0) {
+            return -1;
+        }
+        // A run of empty squares
+        int empty = (window == 0) ? available : __builtin_ctzll(window);
+        if (empty > 0) {
+            if (empty > available) empty = available;
+            if (empty > 90 - sq) empty = 90 - sq;
+            window >>= empty;
+            available -= empty;
+            sq += empty;
+            continue;
+        }
+        int entry = HUFFMAN_DECODE[window & 63];
+        int length = entry >> 4;
+        if (length > available || builder.count == MAX_ENCODED_PIECES) {
+            return -1;
+        }
+        place_piece(&builder, entry & 0xF, sq++);
+        window >>= length;
+        available -= length;
+    }
+    // Whole bytes read, less those still unused in the window
+    int used = (int)next_byte - available / 8;
+    return finish_board(&builder, black_to_move) ? used : -1;
+}
@@ -0,0 +1,54 @@
+#ifndef POSITION_CODEC_H
+#define POSITION_CODEC_H
+
+#include "bitboard.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary encodings of a position: the pieces and the side to move,
+// without the repetition history. Decoding rebuilds the mailbox, bitboards,
+// hash_key and material_key exactly as parse_fen() would for the same
+// position. Both encodings hold at most 32 pieces.
+
+// --- Packed Encoding (fixed size) ---
+// Bits 0..89 of occupancy mark the occupied squares (bit sq of byte sq / 8),
+// bit 95 is set when Black is to move. pieces holds one nibble per occupied
+// square in square order, low nibble first: 1..7 for the Red king, guard,
+// bishop, horse, rook, cannon and pawn, 9..15 for the same Black pieces.
+// Unused nibbles are zero, so equal positions have equal encodings.
+
+#define PACKED_POSITION_SIZE 28
+
+typedef struct {
+    uint8_t occupancy[12];
+    uint8_t pieces[16];
+} PackedPosition;
+
+// Returns false if the board has more than 32 pieces
+bool encode_position(const Board* board, PackedPosition* packed);
+
+// Returns false for data that is not a position with one king per side
+bool decode_position(const PackedPosition* packed, Board* board);
+
+// --- Huffman Encoding (variable size) ---
+// A bit stream, least significant bit of each byte first: one bit for the
+// side to move (1 for Black), then every square in order, "0" for an empty
+// square or "1", the piece type and a color bit (1 for Black). Piece types
+// are coded by frequency: pawn "0", guard "100", bishop "101", horse "1100",
+// rook "1101", cannon "1110", king "1111". The stream is padded with zero
+// bits to whole bytes and is self-delimiting, so encodings can be stored
+// back to back. The start position takes 27 bytes, a middlegame about 23
+// and an endgame 13 to 18.
+
+#define HUFFMAN_POSITION_MAX_SIZE 32
+
+// Writes at most HUFFMAN_POSITION_MAX_SIZE bytes. Returns the number of
+// bytes, or -1 if the board has more than 32 pieces.
+int encode_position_huffman(const Board* board, uint8_t* data);
+
+// Decodes one position from the start of data. Returns the number of bytes
+// read, or -1 for truncated or invalid data.
+int decode_position_huffman(const uint8_t* data, size_t size, Board* board);
+
+#endif // POSITION_CODEC_H
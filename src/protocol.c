@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "protocol.h"
+#include "bitboard.h"
+#include "move.h"
+#include "endgame.h"
+#include "engine.h"
+#include "tt.h"
+#include "opening_book.h"
+#include "tablebase.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define ENGINE_NAME "Xiangqi"
+#define ENGINE_AUTHOR "hezhaoyun"
+
+#define START_FEN "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1"
+
+// Once a "position ... moves" list fills half of the repetition history, only
+// the most recent positions are kept, leaving the rest for the search
+#define HISTORY_TRIM_PLY (MAX_HISTORY / 2)
+#define HISTORY_TRIM_KEEP (MAX_HISTORY / 4)
+
+#define TOKEN_SEPARATORS " \t\r\n"
+
+static Board board;
+static bool ucci_mode = true;       // UCCI dialect until a "uci" command arrives
+static bool use_millisec = true;    // UCCI "usemillisec" option: clock values in ms rather than seconds
+static bool search_running = false; // A search thread has been started and not yet joined
+static size_t hash_size_mb = TT_DEFAULT_SIZE_MB;
+
+static char* next_token(char** save) {
+    return strtok_r(NULL, TOKEN_SEPARATORS, save);
+}
+
+static long next_number(char** save) {
+    char* token = next_token(save);
+    return token ? atol(token) : 0;
+}
+
+// Returns the rest of the line, without surrounding whitespace (e.g. a file
+// path containing spaces)
+static char* remaining_text(char** save) {
+    char* text = *save;
+    if (text == NULL) {
+        return "";
+    }
+    text += strspn(text, TOKEN_SEPARATORS);
+    size_t length = strlen(text);
+    while (length > 0 && strchr(TOKEN_SEPARATORS, text[length - 1]) != NULL) {
+        text[--length] = '\0';
+    }
+    *save = text + length;
+    return text;
+}
+
+// Called on the search thread when the search has finished
+static void on_search_done(Board* searched_board, Move best_move) {
+    if (best_move.from_sq == 0 && best_move.to_sq == 0) {
+        // A null move is a resignation to the GUI: only report it without legal moves
+        MoveList legal_moves;
+        generate_legal_moves(searched_board, &legal_moves);
+        if (legal_moves.count == 0) {
+            printf(ucci_mode ? "nobestmove\n" : "bestmove (none)\n");
+            fflush(stdout);
+            return;
+        }
+        best_move = legal_moves.moves[0];
+    }
+
+    char move_str[5];
+    move_to_string(best_move, move_str);
+    Move ponder_move = get_ponder_move(searched_board, best_move);
+    if (ponder_move.from_sq != 0 || ponder_move.to_sq != 0) {
+        char ponder_str[5];
+        move_to_string(ponder_move, ponder_str);
+        printf("bestmove %s ponder %s\n", move_str, ponder_str);
+    } else {
+        printf("bestmove %s\n", move_str);
+    }
+    fflush(stdout);
+}
+
+// Stops a running search and waits until it has reported its best move
+static void finish_search() {
+    if (search_running) {
+        stop_search();
+        wait_search();
+        search_running = false;
+    }
+}
+
+static void identify(bool ucci) {
+    ucci_mode = ucci;
+    set_search_output(ucci ? SEARCH_OUTPUT_UCCI : SEARCH_OUTPUT_UCI);
+
+    printf("id name %s\n", ENGINE_NAME);
+    printf("id author %s\n", ENGINE_AUTHOR);
+    if (ucci) {
+        printf("option usemillisec type check default true\n");
+        printf("option hashsize type spin min 1 max %d default %d\n", TT_MAX_SIZE_MB, TT_DEFAULT_SIZE_MB);
+        printf("option threads type spin min 1 max %d default 1\n", MAX_SEARCH_THREADS);
+        printf("option ttfile type string default <empty>\n");
+        printf("option usebook type check default true\n");
+        printf("option bookfiles type string default %s\n", DEFAULT_BOOK_PATH);
+        printf("option egtbpaths type string default <empty>\n");
+        printf("ucciok\n");
+    } else {
+        printf("option name Hash type spin default %d min 1 max %d\n", TT_DEFAULT_SIZE_MB, TT_MAX_SIZE_MB);
+        printf("option name Threads type spin default 1 min 1 max %d\n", MAX_SEARCH_THREADS);
+        printf("option name Ponder type check default true\n");
+        printf("option name TTFile type string default <empty>\n");
+        printf("option name OwnBook type check default true\n");
+        printf("option name BookFile type string default %s\n", DEFAULT_BOOK_PATH);
+        printf("option name TablebasePath type string default <empty>\n");
+        printf("uciok\n");
+    }
+    fflush(stdout);
+}
+
+// A table mapped from a file is kept: it holds analysis meant to outlive games
+static void new_game() {
+    if (!tt_is_mapped()) {
+        init_tt();
+    }
+    clear_history_table();
+}
+
+static void report_tt_file(const char* action, const char* path, bool ok) {
+    printf("info string %s %s %s\n", action, path, ok ? "done" : "failed");
+    fflush(stdout);
+}
+
+// Options are matched case-insensitively. Besides the announced ones, every
+// search parameter can be set by its field name (e.g. "rfp_margin").
+static void set_option(const char* name, const char* value) {
+    if (strcasecmp(name, "hash") == 0 || strcasecmp(name, "hashsize") == 0) {
+        long size_mb = atol(value);
+        if (size_mb > TT_MAX_SIZE_MB) size_mb = TT_MAX_SIZE_MB;
+        if (size_mb > 0) {
+            hash_size_mb = (size_t)size_mb;
+            resize_tt(hash_size_mb);
+            printf("info string hash %ld MB%s\n", size_mb, tt_uses_huge_pages() ? ", huge pages" : "");
+            fflush(stdout);
+        }
+    } else if (strcasecmp(name, "ttfile") == 0) {
+        // The table is mapped from the file until the option is cleared or
+        // the hash size changes
+        if (value[0] == '\0' || strcmp(value, "<empty>") == 0) {
+            if (tt_is_mapped()) {
+                resize_tt(hash_size_mb);
+            }
+        } else {
+            report_tt_file("map", value, map_tt_file(value, hash_size_mb));
+        }
+    } else if (strcasecmp(name, "ownbook") == 0 || strcasecmp(name, "usebook") == 0) {
+        set_use_opening_book(strcasecmp(value, "false") != 0);
+    } else if (strcasecmp(name, "bookfile") == 0 || strcasecmp(name, "bookfiles") == 0) {
+        set_opening_book(value);
+    } else if (strcasecmp(name, "tablebasepath") == 0 || strcasecmp(name, "egtbpaths") == 0) {
+        close_tablebases();
+        if (value[0] != '\0' && strcmp(value, "<empty>") != 0) {
+            load_tablebases(value);
+        }
+    } else if (strcasecmp(name, "threads") == 0) {
+        set_search_threads(atoi(value));
+    } else if (strcasecmp(name, "usemillisec") == 0) {
+        use_millisec = strcasecmp(value, "false") != 0;
+    } else if (strcasecmp(name, "newgame") == 0) {
+        new_game(); // UCCI has no separate new game command
+    } else if (strcasecmp(name, "ponder") == 0) {
+        // Pondering is driven by "go ponder"; nothing to configure
+    } else if (!set_search_param(name, atoi(value))) {
+        printf("info string unknown option %s\n", name);
+        fflush(stdout);
+    }
+}
+
+// UCI: "setoption name <id> [value <x>]", UCCI: "setoption <id> [<x>]"
+static void handle_setoption(char** save) {
+    char name[64] = "";
+    const char* value = "";
+    char* token = next_token(save);
+    if (token == NULL) {
+        return;
+    }
+
+    if (strcmp(token, "name") == 0) {
+        // The name may contain spaces and runs until "value"
+        while ((token = next_token(save)) != NULL && strcmp(token, "value") != 0) {
+            if (name[0] != '\0') {
+                strncat(name, " ", sizeof(name) - strlen(name) - 1);
+            }
+            strncat(name, token, sizeof(name) - strlen(name) - 1);
+        }
+        if (token != NULL) {
+            value = remaining_text(save);
+        }
+    } else {
+        snprintf(name, sizeof(name), "%s", token);
+        token = next_token(save);
+        value = token ? token : "";
+    }
+    set_option(name, value);
+}
+
+static bool is_legal_move(Board* b, Move move) {
+    MoveList legal_moves;
+    generate_legal_moves(b, &legal_moves);
+    for (int i = 0; i < legal_moves.count; ++i) {
+        if (is_same_move(legal_moves.moves[i], move)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// "position {fen <fen> | startpos} [moves <m1> ... <mn>]"
+static void handle_position(char** save) {
+    char fen[256] = "";
+    char* token = next_token(save);
+    if (token == NULL) {
+        return;
+    }
+
+    if (strcmp(token, "startpos") == 0) {
+        snprintf(fen, sizeof(fen), "%s", START_FEN);
+        token = next_token(save);
+    } else if (strcmp(token, "fen") == 0) {
+        while ((token = next_token(save)) != NULL && strcmp(token, "moves") != 0) {
+            strncat(fen, token, sizeof(fen) - strlen(fen) - 1);
+            strncat(fen, " ", sizeof(fen) - strlen(fen) - 1);
+        }
+        if (strchr(fen, ' ') == NULL) {
+            return; // parse_fen needs at least the side to move after the placement
+        }
+    } else {
+        return;
+    }
+
+    init_board(&board, fen);
+
+    if (token != NULL && strcmp(token, "moves") == 0) {
+        while ((token = next_token(save)) != NULL) {
+            Move move = parse_move_string(token);
+            if (!is_legal_move(&board, move)) {
+                printf("info string illegal move %s\n", token);
+                fflush(stdout);
+                break;
+            }
+            move_piece(&board, move.from_sq, move.to_sq);
+            if (board.history_ply >= HISTORY_TRIM_PLY) {
+                trim_history(&board, HISTORY_TRIM_KEEP);
+            }
+        }
+    }
+}
+
+// UCI: go [ponder] [infinite] [depth d] [nodes n] [movetime t] [wtime t] [btime t]
+//         [winc t] [binc t] [movestogo n]
+// UCCI: go [ponder | draw] [depth d | nodes n | time t [movestogo n | increment t]
+//         [opptime t [oppmovestogo n | oppincrement t]]]
+static void handle_go(char** save) {
+    SearchLimits limits = {0};
+    bool red_to_move = (board.player_to_move == PLAYER_R);
+    long clock_scale = use_millisec ? 1 : 1000; // UCCI clock values
+
+    char* token;
+    while ((token = next_token(save)) != NULL) {
+        if (strcmp(token, "ponder") == 0) {
+            limits.ponder = true;
+        } else if (strcmp(token, "infinite") == 0) {
+            limits.infinite = true;
+        } else if (strcmp(token, "depth") == 0) {
+            limits.depth = (int)next_number(save);
+        } else if (strcmp(token, "nodes") == 0) {
+            char* value = next_token(save);
+            limits.nodes = value ? strtoull(value, NULL, 10) : 0;
+        } else if (strcmp(token, "movetime") == 0) {
+            limits.movetime = next_number(save);
+        } else if (strcmp(token, "wtime") == 0 || strcmp(token, "btime") == 0) {
+            long value = next_number(save);
+            if ((token[0] == 'w') == red_to_move) limits.time_left = value;
+        } else if (strcmp(token, "winc") == 0 || strcmp(token, "binc") == 0) {
+            long value = next_number(save);
+            if ((token[0] == 'w') == red_to_move) limits.increment = value;
+        } else if (strcmp(token, "movestogo") == 0) {
+            limits.moves_to_go = (int)next_number(save);
+        } else if (strcmp(token, "time") == 0) {
+            limits.time_left = next_number(save) * clock_scale;
+        } else if (strcmp(token, "increment") == 0 || strcmp(token, "inc") == 0) {
+            limits.increment = next_number(save) * clock_scale;
+        } else if (strcmp(token, "opptime") == 0 || strcmp(token, "oppincrement") == 0
+                   || strcmp(token, "oppmovestogo") == 0) {
+            next_token(save); // The opponent's clock is not used
+        }
+    }
+
+    // A bare "go" searches until stopped
+    if (limits.depth == 0 && limits.nodes == 0 && limits.movetime == 0 && limits.time_left == 0) {
+        limits.infinite = true;
+    }
+
+    finish_search();
+    search_async(&board, &limits, on_search_done);
+    search_running = true;
+}
+
+// Handles one input line; returns false on "quit"
+static bool handle_command(char* line) {
+    char* save = NULL;
+    char* command = strtok_r(line, TOKEN_SEPARATORS, &save);
+    if (command == NULL) {
+        return true;
+    }
+
+    if (strcmp(command, "ucci") == 0 || strcmp(command, "uci") == 0) {
+        identify(strcmp(command, "ucci") == 0);
+    } else if (strcmp(command, "isready") == 0) {
+        printf("readyok\n");
+        fflush(stdout);
+    } else if (strcmp(command, "setoption") == 0) {
+        finish_search();
+        handle_setoption(&save);
+    } else if (strcmp(command, "ucinewgame") == 0) {
+        finish_search();
+        new_game();
+    } else if (strcmp(command, "position") == 0) {
+        finish_search();
+        handle_position(&save);
+    } else if (strcmp(command, "go") == 0) {
+        handle_go(&save);
+    } else if (strcmp(command, "savett") == 0) {
+        // "savett <file>" and "loadtt <file>": not part of either protocol
+        finish_search();
+        const char* path = remaining_text(&save);
+        report_tt_file("save", path, save_tt(path));
+    } else if (strcmp(command, "loadtt") == 0) {
+        finish_search();
+        const char* path = remaining_text(&save);
+        report_tt_file("load", path, load_tt(path));
+    } else if (strcmp(command, "stop") == 0) {
+        stop_search(); // The search thread reports its best move
+    } else if (strcmp(command, "ponderhit") == 0) {
+        time_ponderhit();
+    } else if (strcmp(command, "quit") == 0) {
+        finish_search();
+        if (ucci_mode) {
+            printf("bye\n");
+            fflush(stdout);
+        }
+        return false;
+    }
+    // Unknown commands are ignored, as both protocols require
+    return true;
+}
+
+void run_protocol(const char* first_command) {
+    init_board(&board, NULL);
+    init_move_generator();
+    init_endgames();
+    init_tt();
+    clear_history_table();
+
+    bool running = true;
+    if (first_command != NULL) {
+        char* line = strdup(first_command);
+        running = handle_command(line);
+        free(line);
+    }
+
+    // Lines are read whole: a "position ... moves" command grows with the game
+    char* line = NULL;
+    size_t capacity = 0;
+    while (running && getline(&line, &capacity, stdin) != -1) {
+        running = handle_command(line);
+    }
+    free(line);
+
+    finish_search();
+}
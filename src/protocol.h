@@ -0,0 +1,9 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Runs the UCCI/UCI command loop on stdin/stdout until "quit" or end of input.
+// The dialect follows the "ucci" or "uci" command; first_command, if not NULL,
+// is handled as the first input line (e.g. when the textual UI hands over).
+void run_protocol(const char* first_command);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,531 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tablebase.h"
+#include "move.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TB_FILE_MAGIC "XQTBASE\0"
+#define TB_FILE_VERSION 1
+#define TB_FILE_EXTENSION ".xtb"
+#define TB_FLAG_DTM 1
+
+// Values per compressed block; a probe decodes at most one block
+#define TB_BLOCK_SIZE 4096
+
+#define TB_MAX_TABLES 1024
+#define TB_HASH_SLOTS 2048 // Power of two, above TB_MAX_TABLES
+
+// File layout: header, block_count + 1 block offsets (relative to the first
+// block), then the blocks as (run length - 1, value) byte pairs
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint8_t counts[14];
+    uint8_t max_dtm;
+    uint8_t reserved;
+    uint32_t block_size;
+    uint32_t reserved2;
+    uint64_t positions;     // Per side to move
+    uint64_t block_count;
+} TBFileHeader;
+
+_Static_assert(sizeof(TBFileHeader) == 56, "TBFileHeader must match the file format");
+
+static const char MATERIAL_LETTERS[] = "KABNRCP"; // By piece type, R_KING .. R_PAWN
+
+// Squares each piece type can ever occupy, by bitboard index
+static int domain_sizes[14];
+static uint8_t domain_squares[14][90];
+static int8_t domain_indices[14][90];
+static bool domains_ready = false;
+
+static TBTable tables[TB_MAX_TABLES];
+static int table_count = 0;
+static int table_slots[TB_HASH_SLOTS]; // Index into tables + 1, 0 for an empty slot
+static int max_table_pieces = 0;
+
+// --- Layout ---
+
+// rank counts rows from the owner's back rank
+static bool square_in_domain(Piece piece, int sq) {
+    int r = sq / 9;
+    int c = sq % 9;
+    int rank = (piece > 0) ? 9 - r : r;
+    switch (abs(piece)) {
+    case R_KING:
+        return rank <= 2 && c >= 3 && c <= 5;
+    case R_GUARD:
+        return ((rank == 0 || rank == 2) && (c == 3 || c == 5)) || (rank == 1 && c == 4);
+    case R_BISHOP:
+        return ((rank == 0 || rank == 4) && (c == 2 || c == 6)) || (rank == 2 && c % 4 == 0);
+    case R_PAWN:
+        return rank >= 5 || ((rank == 3 || rank == 4) && c % 2 == 0);
+    default:
+        return true;
+    }
+}
+
+static void init_domains() {
+    if (domains_ready) {
+        return;
+    }
+    for (int p = -7; p <= 7; ++p) {
+        if (p == 0) continue;
+        int idx = get_piece_to_bb_index((Piece)p);
+        domain_sizes[idx] = 0;
+        for (int sq = 0; sq < 90; ++sq) {
+            domain_indices[idx][sq] = -1;
+            if (square_in_domain((Piece)p, sq)) {
+                domain_indices[idx][sq] = (int8_t)domain_sizes[idx];
+                domain_squares[idx][domain_sizes[idx]++] = (uint8_t)sq;
+            }
+        }
+    }
+    domains_ready = true;
+}
+
+bool tb_parse_material(const char* name, TBMaterial* material) {
+    memset(material, 0, sizeof(*material));
+    for (const char* p = name; *p; ++p) {
+        bool red = (*p >= 'A' && *p <= 'Z');
+        const char* letter = strchr(MATERIAL_LETTERS, red ? *p : *p - 'a' + 'A');
+        if (letter == NULL || *letter == '\0') {
+            return false;
+        }
+        Piece piece = (Piece)(letter - MATERIAL_LETTERS + 1);
+        material->counts[get_piece_to_bb_index(red ? piece : -piece)]++;
+    }
+    return material->counts[get_piece_to_bb_index(R_KING)] == 1
+           && material->counts[get_piece_to_bb_index(B_KING)] == 1
+           && tb_material_pieces(material) <= TB_MAX_PIECES;
+}
+
+void tb_material_name(const TBMaterial* material, char* name) {
+    for (int side = 0; side < 2; ++side) {
+        for (int type = R_KING; type <= R_PAWN; ++type) {
+            Piece piece = (Piece)(side == 0 ? type : -type);
+            for (int n = 0; n < material->counts[get_piece_to_bb_index(piece)]; ++n) {
+                char letter = MATERIAL_LETTERS[type - 1];
+                *name++ = (side == 0) ? letter : (char)(letter - 'A' + 'a');
+            }
+        }
+    }
+    *name = '\0';
+}
+
+int tb_material_pieces(const TBMaterial* material) {
+    int pieces = 0;
+    for (int i = 0; i < 14; ++i) {
+        pieces += material->counts[i];
+    }
+    return pieces;
+}
+
+// Compares the pieces of one side, strongest types first
+static uint32_t side_strength(const TBMaterial* material, int side) {
+    static const Piece ORDER[] = {R_GUARD, R_BISHOP, R_PAWN, R_HORSE, R_CANNON, R_ROOK};
+    uint32_t strength = 0;
+    for (int i = 0; i < 6; ++i) {
+        Piece piece = (side == 0) ? ORDER[i] : (Piece)-ORDER[i];
+        strength |= (uint32_t)material->counts[get_piece_to_bb_index(piece)] << (4 * i);
+    }
+    return strength;
+}
+
+TBMaterial tb_canonical_material(const TBMaterial* material, bool* flipped) {
+    *flipped = side_strength(material, 1) > side_strength(material, 0);
+    if (!*flipped) {
+        return *material;
+    }
+    TBMaterial swapped;
+    for (int i = 0; i < 7; ++i) {
+        swapped.counts[i] = material->counts[i + 7];
+        swapped.counts[i + 7] = material->counts[i];
+    }
+    return swapped;
+}
+
+void tb_init_layout(TBLayout* layout, const TBMaterial* material) {
+    init_domains();
+    memset(layout, 0, sizeof(*layout));
+    layout->material = *material;
+    layout->positions = (uint64_t)domain_sizes[get_piece_to_bb_index(R_KING)]
+                        * domain_sizes[get_piece_to_bb_index(B_KING)];
+    for (int side = 0; side < 2; ++side) {
+        for (int type = R_GUARD; type <= R_PAWN; ++type) {
+            Piece piece = (Piece)(side == 0 ? type : -type);
+            int idx = get_piece_to_bb_index(piece);
+            for (int n = 0; n < material->counts[idx] && layout->piece_count < TB_MAX_PIECES - 2; ++n) {
+                layout->pieces[layout->piece_count++] = piece;
+                layout->positions *= domain_sizes[idx];
+            }
+        }
+    }
+}
+
+static inline int mirror_square(int sq) {
+    return (9 - sq / 9) * 9 + sq % 9;
+}
+
+bool tb_index(const TBLayout* layout, const Board* board, bool flipped, uint64_t* index) {
+    int stm = flipped ? -board->player_to_move : board->player_to_move;
+    uint64_t result = (stm == PLAYER_R) ? 0 : 1;
+
+    // Kings first, then each group of pieces of one type
+    for (int i = -2; i < layout->piece_count; ) {
+        Piece piece = (i == -2) ? R_KING : (i == -1) ? B_KING : layout->pieces[i];
+        int group = 1;
+        while (i >= 0 && i + group < layout->piece_count && layout->pieces[i + group] == piece) {
+            group++;
+        }
+
+        int idx = get_piece_to_bb_index(piece);
+        U128 bb = board->piece_bitboards[get_piece_to_bb_index(flipped ? (Piece)-piece : piece)];
+        int found[TB_MAX_PIECES];
+        int count = 0;
+        while (bb && count < group) {
+            int sq = get_lsb_index(bb);
+            bb &= bb - 1;
+            int d = domain_indices[idx][flipped ? mirror_square(sq) : sq];
+            if (d < 0) {
+                return false;
+            }
+            // Insertion sort: mirroring reverses the square order
+            int j = count++;
+            while (j > 0 && found[j - 1] > d) {
+                found[j] = found[j - 1];
+                j--;
+            }
+            found[j] = d;
+        }
+        if (count != group || bb) {
+            return false;
+        }
+        for (int j = 0; j < group; ++j) {
+            result = result * domain_sizes[idx] + found[j];
+        }
+        i += group;
+    }
+    *index = result;
+    return true;
+}
+
+bool tb_set_position(const TBLayout* layout, uint64_t index, Board* board) {
+    int squares[TB_MAX_PIECES];
+    // Decode from the least significant digit: the last piece first
+    for (int i = layout->piece_count - 1; i >= -2; --i) {
+        Piece piece = (i == -2) ? R_KING : (i == -1) ? B_KING : layout->pieces[i];
+        int idx = get_piece_to_bb_index(piece);
+        int d = (int)(index % domain_sizes[idx]);
+        index /= domain_sizes[idx];
+        // Pieces of one type must be in increasing square order
+        if (i >= 0 && i + 1 < layout->piece_count && layout->pieces[i + 1] == piece
+            && domain_squares[idx][d] >= squares[i + 3]) {
+            return false;
+        }
+        squares[i + 2] = domain_squares[idx][d];
+    }
+
+    memset(board, 0, sizeof(*board));
+    for (int i = -2; i < layout->piece_count; ++i) {
+        Piece piece = (i == -2) ? R_KING : (i == -1) ? B_KING : layout->pieces[i];
+        int sq = squares[i + 2];
+        if (board->board[sq] != EMPTY) {
+            return false;
+        }
+        set_piece(board, piece, sq);
+    }
+    board->player_to_move = (index == 0) ? PLAYER_R : PLAYER_B;
+    if (board->player_to_move == PLAYER_B) {
+        board->hash_key ^= zobrist_player;
+    }
+    board->history[0] = board->hash_key;
+    return true;
+}
+
+// --- Registry ---
+
+// Same key as the board's material key (see bitboard.h)
+static uint64_t material_key(const TBMaterial* material) {
+    uint64_t key = 0;
+    for (int i = 0; i < 14; ++i) {
+        key += material->counts[i] * material_key_unit(i);
+    }
+    return key;
+}
+
+static int slot_of(uint64_t key) {
+    return (int)((key * 0x9e3779b97f4a7c15ULL) >> 53) & (TB_HASH_SLOTS - 1);
+}
+
+const TBTable* tb_find_table(const TBMaterial* material) {
+    uint64_t key = material_key(material);
+    for (int slot = slot_of(key); table_slots[slot] != 0; slot = (slot + 1) & (TB_HASH_SLOTS - 1)) {
+        const TBTable* table = &tables[table_slots[slot] - 1];
+        if (material_key(&table->layout.material) == key) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+bool tb_register_table(const TBTable* table) {
+    if (table_count == TB_MAX_TABLES || tb_find_table(&table->layout.material) != NULL) {
+        return false;
+    }
+    int slot = slot_of(material_key(&table->layout.material));
+    while (table_slots[slot] != 0) {
+        slot = (slot + 1) & (TB_HASH_SLOTS - 1);
+    }
+    tables[table_count++] = *table;
+    table_slots[slot] = table_count;
+
+    int pieces = tb_material_pieces(&table->layout.material);
+    if (pieces > max_table_pieces) {
+        max_table_pieces = pieces;
+    }
+    return true;
+}
+
+uint8_t tb_table_value(const TBTable* table, uint64_t index) {
+    if (table->values) {
+        return table->values[index];
+    }
+    uint64_t block = index / TB_BLOCK_SIZE;
+    uint64_t offset = index % TB_BLOCK_SIZE;
+    const uint8_t* run = table->blocks + table->block_offsets[block];
+    const uint8_t* end = table->blocks + table->block_offsets[block + 1];
+    while (run < end) {
+        uint64_t length = (uint64_t)run[0] + 1;
+        if (offset < length) {
+            return run[1];
+        }
+        offset -= length;
+        run += 2;
+    }
+    return TB_VALUE_INVALID; // Corrupt block
+}
+
+// --- Files ---
+
+void tb_table_path(const char* dir, const TBMaterial* material, char* path, size_t size) {
+    char name[TB_MAX_PIECES + 1];
+    tb_material_name(material, name);
+    snprintf(path, size, "%s/%s%s", dir, name, TB_FILE_EXTENSION);
+}
+
+bool tb_write_table(const char* path, const TBLayout* layout, const uint8_t* values, bool has_dtm, int max_dtm) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing.\n", path);
+        return false;
+    }
+
+    uint64_t total = 2 * layout->positions;
+    TBFileHeader header = {0};
+    memcpy(header.magic, TB_FILE_MAGIC, sizeof(header.magic));
+    header.version = TB_FILE_VERSION;
+    header.flags = has_dtm ? TB_FLAG_DTM : 0;
+    memcpy(header.counts, layout->material.counts, sizeof(header.counts));
+    header.max_dtm = (uint8_t)(has_dtm ? max_dtm : 0);
+    header.block_size = TB_BLOCK_SIZE;
+    header.positions = layout->positions;
+    header.block_count = (total + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE;
+
+    uint64_t* offsets = (uint64_t*)calloc(header.block_count + 1, sizeof(uint64_t));
+    uint8_t* buffer = (uint8_t*)malloc(2 * TB_BLOCK_SIZE);
+    bool ok = offsets && buffer && fwrite(&header, sizeof(header), 1, file) == 1
+              && fwrite(offsets, sizeof(uint64_t), header.block_count + 1, file) == header.block_count + 1;
+
+    // Impossible positions are never probed: they continue the current run
+    uint8_t previous = TB_VALUE_DRAW;
+    for (uint64_t block = 0; ok && block < header.block_count; ++block) {
+        uint64_t first = block * TB_BLOCK_SIZE;
+        uint64_t last = (first + TB_BLOCK_SIZE < total) ? first + TB_BLOCK_SIZE : total;
+        size_t length = 0;
+        int run = 0;
+        for (uint64_t i = first; i < last; ++i) {
+            uint8_t value = values[i];
+            if (value == TB_VALUE_INVALID) {
+                value = previous;
+            } else if (!has_dtm) {
+                value = tb_value_is_win(value) ? tb_win_value(1) : tb_value_is_loss(value) ? tb_loss_value(0) : TB_VALUE_DRAW;
+            }
+            if (run > 0 && value == previous && run < 256) {
+                buffer[length - 2] = (uint8_t)run++;
+            } else {
+                buffer[length++] = 0;
+                buffer[length++] = value;
+                run = 1;
+            }
+            previous = value;
+        }
+        offsets[block + 1] = offsets[block] + length;
+        ok = fwrite(buffer, 1, length, file) == length;
+    }
+
+    if (ok) {
+        ok = fseek(file, sizeof(header), SEEK_SET) == 0
+             && fwrite(offsets, sizeof(uint64_t), header.block_count + 1, file) == header.block_count + 1;
+    }
+    ok = (fclose(file) == 0) && ok;
+    free(offsets);
+    free(buffer);
+    if (!ok) {
+        fprintf(stderr, "Failed to write the tablebase %s.\n", path);
+    }
+    return ok;
+}
+
+bool tb_load_table(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open tablebase file: %s\n", path);
+        return false;
+    }
+    struct stat file_stat;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && (size_t)file_stat.st_size >= sizeof(TBFileHeader)) {
+        data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Invalid tablebase file: %s\n", path);
+        return false;
+    }
+
+    size_t bytes = (size_t)file_stat.st_size;
+    const TBFileHeader* header = (const TBFileHeader*)data;
+    TBTable table = {0};
+    table.mapping = data;
+    table.mapping_bytes = bytes;
+    table.has_dtm = (header->flags & TB_FLAG_DTM) != 0;
+    table.max_dtm = header->max_dtm;
+
+    TBMaterial material;
+    memcpy(material.counts, header->counts, sizeof(material.counts));
+    bool flipped;
+    tb_canonical_material(&material, &flipped);
+    bool valid = memcmp(header->magic, TB_FILE_MAGIC, sizeof(header->magic)) == 0
+                 && header->version == TB_FILE_VERSION && header->block_size == TB_BLOCK_SIZE
+                 && !flipped && tb_material_pieces(&material) <= TB_MAX_PIECES;
+    if (valid) {
+        tb_init_layout(&table.layout, &material);
+        uint64_t block_count = (2 * table.layout.positions + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE;
+        size_t blocks_start = sizeof(TBFileHeader) + (block_count + 1) * sizeof(uint64_t);
+        table.block_offsets = (const uint64_t*)(header + 1);
+        table.blocks = (const uint8_t*)data + blocks_start;
+        valid = header->positions == table.layout.positions && header->block_count == block_count
+                && blocks_start <= bytes && table.block_offsets[block_count] == bytes - blocks_start;
+    }
+    if (!valid) {
+        fprintf(stderr, "Invalid tablebase file: %s\n", path);
+        munmap(data, bytes);
+        return false;
+    }
+    if (!tb_register_table(&table)) {
+        munmap(data, bytes);
+        return false;
+    }
+    return true;
+}
+
+// --- Probing ---
+
+int load_tablebases(const char* dir) {
+    DIR* directory = opendir(dir);
+    if (!directory) {
+        fprintf(stderr, "Could not open tablebase directory: %s\n", dir);
+        return 0;
+    }
+    int loaded = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        size_t extension = strlen(TB_FILE_EXTENSION);
+        if (length > extension && strcmp(entry->d_name + length - extension, TB_FILE_EXTENSION) == 0) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            loaded += tb_load_table(path);
+        }
+    }
+    closedir(directory);
+    fprintf(stderr, "Tablebases loaded: %d tables, up to %d pieces.\n", loaded, max_table_pieces);
+    return loaded;
+}
+
+void close_tablebases() {
+    for (int i = 0; i < table_count; ++i) {
+        if (tables[i].mapping) {
+            munmap(tables[i].mapping, tables[i].mapping_bytes);
+        }
+    }
+    table_count = 0;
+    max_table_pieces = 0;
+    memset(table_slots, 0, sizeof(table_slots));
+}
+
+int tablebase_max_pieces() {
+    return max_table_pieces;
+}
+
+// Finds the table covering the board and the board's index in it
+static const TBTable* find_position(const Board* board, uint64_t* index) {
+    TBMaterial material;
+    for (int i = 0; i < 14; ++i) {
+        material.counts[i] = (uint8_t)material_count(board->material_key, i);
+    }
+    if (tb_material_pieces(&material) > max_table_pieces) {
+        return NULL;
+    }
+    bool flipped;
+    TBMaterial canonical = tb_canonical_material(&material, &flipped);
+    const TBTable* table = tb_find_table(&canonical);
+    if (table == NULL || !tb_index(&table->layout, board, flipped, index)) {
+        return NULL;
+    }
+    return table;
+}
+
+// Two bare kings are a draw without a table
+static bool bare_kings(const Board* board) {
+    return max_table_pieces > 0 && popcount(get_occupied_bitboard(board)) == 2;
+}
+
+uint8_t probe_tablebase_value(const Board* board) {
+    if (bare_kings(board)) {
+        return TB_VALUE_DRAW;
+    }
+    uint64_t index;
+    const TBTable* table = find_position(board, &index);
+    return table ? tb_table_value(table, index) : TB_VALUE_INVALID;
+}
+
+bool probe_tablebase(const Board* board, int* result, int* dtm) {
+    uint8_t value = TB_VALUE_DRAW;
+    const TBTable* table = NULL;
+    if (!bare_kings(board)) {
+        uint64_t index;
+        table = find_position(board, &index);
+        value = table ? tb_table_value(table, index) : TB_VALUE_INVALID;
+    }
+    if (value == TB_VALUE_INVALID) {
+        return false;
+    }
+    if (value == TB_VALUE_DRAW) {
+        *result = TB_DRAW;
+        *dtm = 0;
+    } else {
+        *result = tb_value_is_win(value) ? TB_WIN : TB_LOSS;
+        *dtm = table->has_dtm ? tb_value_dtm(value) : -1;
+    }
+    return true;
+}
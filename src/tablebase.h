@@ -0,0 +1,149 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "bitboard.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Endgame tablebases: for every position of a material configuration (e.g.
+// rook vs. two guards, "KRkaa": Red pieces upper case, Black lower case),
+// the game-theoretical result with the distance to mate, computed by
+// retrograde analysis (see tablebase_gen.h). Only the rules of checkmate
+// and stalemate (a side without legal moves loses) are modelled; repetition
+// rules (perpetual check or chase) are not.
+
+// Most pieces in a table, both kings included
+#define TB_MAX_PIECES 6
+
+// Result for the side to move
+#define TB_LOSS -1
+#define TB_DRAW 0
+#define TB_WIN 1
+
+// --- Values ---
+// One byte per position: 0 draw, 1..127 win in 2v-1 plies, 128..254 loss in
+// 2(v-128) plies (128: no legal moves), 255 impossible position. Tables
+// without distances (WDL) store wins as 1 and losses as 128.
+#define TB_VALUE_DRAW 0
+#define TB_VALUE_LOSS_BASE 128
+#define TB_VALUE_INVALID 255
+#define TB_MAX_DTM 252
+
+static inline uint8_t tb_win_value(int dtm) {
+    return (uint8_t)((dtm + 1) / 2);
+}
+
+static inline uint8_t tb_loss_value(int dtm) {
+    return (uint8_t)(TB_VALUE_LOSS_BASE + dtm / 2);
+}
+
+static inline bool tb_value_is_win(uint8_t value) {
+    return value != TB_VALUE_DRAW && value < TB_VALUE_LOSS_BASE;
+}
+
+static inline bool tb_value_is_loss(uint8_t value) {
+    return value >= TB_VALUE_LOSS_BASE && value != TB_VALUE_INVALID;
+}
+
+// Distance to mate in plies of a win or loss value
+static inline int tb_value_dtm(uint8_t value) {
+    return tb_value_is_win(value) ? 2 * value - 1 : 2 * (value - TB_VALUE_LOSS_BASE);
+}
+
+// --- Layout ---
+
+// Material of a table: piece counts by bitboard index (get_piece_to_bb_index)
+typedef struct {
+    uint8_t counts[14];
+} TBMaterial;
+
+// Index layout of a table. A position index is, from most to least
+// significant: side to move, the two king squares (9 palace squares each),
+// then each other piece in order, as an index into the squares its type can
+// ever reach (e.g. 5 for a guard). Pieces of the same type are ordered by
+// square; other orders are impossible indices.
+typedef struct {
+    TBMaterial material;
+    int piece_count;                    // Pieces besides the kings
+    Piece pieces[TB_MAX_PIECES - 2];
+    uint64_t positions;                 // Positions per side to move
+} TBLayout;
+
+// Parses a material name such as "KRkaa"; both kings are required
+bool tb_parse_material(const char* name, TBMaterial* material);
+
+void tb_material_name(const TBMaterial* material, char* name);
+
+int tb_material_pieces(const TBMaterial* material);
+
+// Tables are stored for one orientation of each material: the one where Red
+// has the stronger pieces. Returns the material with colors swapped if the
+// given one is not stored that way; *flipped tells whether it was.
+TBMaterial tb_canonical_material(const TBMaterial* material, bool* flipped);
+
+void tb_init_layout(TBLayout* layout, const TBMaterial* material);
+
+// Index of a board in the layout of its material; with flipped, the board is
+// seen with colors swapped and mirrored top to bottom. Returns false if the
+// position cannot be indexed (a piece outside the squares of its type).
+bool tb_index(const TBLayout* layout, const Board* board, bool flipped, uint64_t* index);
+
+// Sets up the board of an index; returns false for impossible indices
+// (pieces on the same square, or pieces of a type out of order)
+bool tb_set_position(const TBLayout* layout, uint64_t index, Board* board);
+
+// --- Tables ---
+
+typedef struct {
+    TBLayout layout;
+    bool has_dtm;
+    int max_dtm;                        // Longest distance to mate in the table
+    const uint8_t* values;              // Uncompressed values, or NULL for a file
+    // Mapped file: run-length encoded blocks of TB_BLOCK_SIZE values
+    void* mapping;
+    size_t mapping_bytes;
+    const uint64_t* block_offsets;
+    const uint8_t* blocks;
+} TBTable;
+
+// Makes a table available to probes; the table is copied, its values are not
+bool tb_register_table(const TBTable* table);
+
+// Returns the table of a material (in canonical orientation), or NULL
+const TBTable* tb_find_table(const TBMaterial* material);
+
+uint8_t tb_table_value(const TBTable* table, uint64_t index);
+
+// Writes a table file. Values are run-length encoded in blocks; with
+// has_dtm false, only win/draw/loss is kept, which compresses far better.
+bool tb_write_table(const char* path, const TBLayout* layout, const uint8_t* values, bool has_dtm, int max_dtm);
+
+// Maps a table file read-only and registers it. Returns false if the file is
+// invalid or the same material is already registered.
+bool tb_load_table(const char* path);
+
+// File name of a material's table in a directory
+void tb_table_path(const char* dir, const TBMaterial* material, char* path, size_t size);
+
+// --- Probing ---
+
+// Loads every table file (*.xtb) of a directory; returns the number loaded
+int load_tablebases(const char* dir);
+
+// Unmaps all tables
+void close_tablebases();
+
+// Most pieces on the board for which a table may exist; 0 without tables
+int tablebase_max_pieces();
+
+// Returns the value of the position (see Values above) for the side to move,
+// or TB_VALUE_INVALID if no table covers it
+uint8_t probe_tablebase_value(const Board* board);
+
+// Probes the position for the search. Returns false if no table covers it;
+// otherwise sets the result for the side to move and the distance to mate in
+// plies (-1 if the table has no distances, 0 for draws).
+bool probe_tablebase(const Board* board, int* result, int* dtm);
+
+#endif // TABLEBASE_H
@@ -0,0 +1,326 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tablebase_gen.h"
+#include "tablebase.h"
+#include "bitboard.h"
+#include "move.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TBGEN_DEFAULT_DIR "tablebases"
+#define TBGEN_MAX_THREADS 256
+#define TBGEN_MAX_PATH 4096
+
+typedef struct {
+    const char* dir;
+    int threads;
+    bool wdl;           // Write win/draw/loss only
+} GeneratorConfig;
+
+typedef struct {
+    int id;
+    uint64_t changed;   // Positions resolved in the current pass
+} GeneratorWorker;
+
+static GeneratorConfig config;
+static GeneratorWorker workers[TBGEN_MAX_THREADS];
+
+// Table being generated, and the distance to mate resolved by the current pass
+static const TBLayout* layout;
+static uint8_t* values;
+static int pass_dtm;
+
+// --- Passes ---
+
+// Runs one pass on all workers, each over its share of the positions; worker
+// 0 runs on the calling thread
+static void run_workers(void* (*pass)(void*)) {
+    pthread_t threads[TBGEN_MAX_THREADS];
+    bool started[TBGEN_MAX_THREADS] = {false};
+    for (int i = 1; i < config.threads; ++i) {
+        started[i] = (pthread_create(&threads[i], NULL, pass, &workers[i]) == 0);
+    }
+    pass(&workers[0]);
+    for (int i = 1; i < config.threads; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            pass(&workers[i]);
+        }
+    }
+}
+
+static void worker_range(const GeneratorWorker* worker, uint64_t* first, uint64_t* last) {
+    uint64_t total = 2 * layout->positions;
+    *first = total * worker->id / config.threads;
+    *last = total * (worker->id + 1) / config.threads;
+}
+
+// Value of the position after a move: in the table being generated, or for a
+// capture, in the table of the smaller material
+static uint8_t child_value(const Board* child, bool capture) {
+    if (capture) {
+        return probe_tablebase_value(child);
+    }
+    uint64_t index;
+    return tb_index(layout, child, false, &index) ? values[index] : TB_VALUE_INVALID;
+}
+
+// Marks impossible positions (the side not to move in check) and positions
+// without legal moves, which are lost for the side to move
+static void* initialize_positions(void* arg) {
+    GeneratorWorker* worker = (GeneratorWorker*)arg;
+    uint64_t first, last;
+    worker_range(worker, &first, &last);
+    worker->changed = 0;
+
+    for (uint64_t i = first; i < last; ++i) {
+        Board board;
+        if (!tb_set_position(layout, i, &board) || is_king_in_check(&board, -board.player_to_move)) {
+            values[i] = TB_VALUE_INVALID;
+            continue;
+        }
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        if (moves.count == 0) {
+            values[i] = tb_loss_value(0);
+            worker->changed++;
+        } else {
+            values[i] = TB_VALUE_DRAW;
+        }
+    }
+    return NULL;
+}
+
+// Resolves the positions won (odd pass_dtm) or lost (even pass_dtm) in
+// exactly pass_dtm plies: a win needs one move to a position lost in fewer
+// plies, a loss needs every move to lead to a position won in fewer plies.
+// Values written by this pass have distance pass_dtm and are therefore never
+// counted by it, so the result does not depend on the order of the workers.
+static void* resolve_positions(void* arg) {
+    GeneratorWorker* worker = (GeneratorWorker*)arg;
+    uint64_t first, last;
+    worker_range(worker, &first, &last);
+    worker->changed = 0;
+    bool find_wins = (pass_dtm % 2 == 1);
+
+    for (uint64_t i = first; i < last; ++i) {
+        if (values[i] != TB_VALUE_DRAW) {
+            continue;
+        }
+        Board board;
+        tb_set_position(layout, i, &board);
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+
+        bool resolved = !find_wins;
+        for (int m = 0; m < moves.count; ++m) {
+            Move move = moves.moves[m];
+            Piece captured = move_piece(&board, move.from_sq, move.to_sq);
+            uint8_t value = child_value(&board, captured != EMPTY);
+            unmove_piece(&board, move.from_sq, move.to_sq, captured);
+
+            if (find_wins && tb_value_is_loss(value) && tb_value_dtm(value) < pass_dtm) {
+                resolved = true;
+                break;
+            }
+            if (!find_wins && !(tb_value_is_win(value) && tb_value_dtm(value) < pass_dtm)) {
+                resolved = false;
+                break;
+            }
+        }
+        if (resolved) {
+            values[i] = find_wins ? tb_win_value(pass_dtm) : tb_loss_value(pass_dtm);
+            worker->changed++;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t changed_positions() {
+    uint64_t changed = 0;
+    for (int i = 0; i < config.threads; ++i) {
+        changed += workers[i].changed;
+    }
+    return changed;
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// --- Tables ---
+
+// Generates the table of a material, after those of every material one
+// capture away. Tables are kept in memory for the larger materials.
+static bool generate_material(const TBMaterial* requested) {
+    bool flipped;
+    TBMaterial material = tb_canonical_material(requested, &flipped);
+    char name[TB_MAX_PIECES + 1];
+    tb_material_name(&material, name);
+
+    const TBTable* existing = tb_find_table(&material);
+    if (existing != NULL) {
+        return true;
+    }
+    char path[TBGEN_MAX_PATH];
+    tb_table_path(config.dir, &material, path, sizeof(path));
+    if (access(path, R_OK) == 0 && tb_load_table(path)) {
+        existing = tb_find_table(&material);
+        if (!existing->has_dtm && !config.wdl) {
+            printf("%s has no distances to mate; remove it or generate with -wdl.\n", path);
+            return false;
+        }
+        printf("%s: using %s\n", name, path);
+        return true;
+    }
+
+    // Smaller materials first; their longest distance bounds the passes
+    int max_sub_dtm = 0;
+    for (int i = 0; i < 14; ++i) {
+        if (material.counts[i] == 0 || i == get_piece_to_bb_index(R_KING) || i == get_piece_to_bb_index(B_KING)) {
+            continue;
+        }
+        TBMaterial sub = material;
+        sub.counts[i]--;
+        if (!generate_material(&sub)) {
+            return false;
+        }
+        bool sub_flipped;
+        TBMaterial canonical_sub = tb_canonical_material(&sub, &sub_flipped);
+        int sub_dtm = tb_find_table(&canonical_sub)->max_dtm;
+        if (sub_dtm > max_sub_dtm) max_sub_dtm = sub_dtm;
+    }
+
+    TBLayout table_layout;
+    tb_init_layout(&table_layout, &material);
+    uint8_t* table_values = (uint8_t*)malloc(2 * table_layout.positions);
+    if (!table_values) {
+        printf("%s: out of memory for %llu positions\n", name, (unsigned long long)(2 * table_layout.positions));
+        return false;
+    }
+    layout = &table_layout;
+    values = table_values;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_workers(initialize_positions);
+
+    // Stop after a won and a lost pass without changes, once the distances of
+    // the smaller tables cannot resolve anything more
+    uint64_t unchanged_passes = 0;
+    for (pass_dtm = 1; pass_dtm <= TB_MAX_DTM; ++pass_dtm) {
+        run_workers(resolve_positions);
+        unchanged_passes = changed_positions() ? 0 : unchanged_passes + 1;
+        if (unchanged_passes >= 2 && pass_dtm > max_sub_dtm + 1) {
+            break;
+        }
+    }
+    if (pass_dtm > TB_MAX_DTM) {
+        printf("%s: distances beyond %d plies are counted as draws\n", name, TB_MAX_DTM);
+    }
+
+    uint64_t wins = 0, draws = 0, losses = 0;
+    int max_dtm = 0;
+    for (uint64_t i = 0; i < 2 * table_layout.positions; ++i) {
+        uint8_t value = table_values[i];
+        if (value == TB_VALUE_INVALID) continue;
+        if (value == TB_VALUE_DRAW) {
+            draws++;
+            continue;
+        }
+        if (tb_value_is_win(value)) wins++; else losses++;
+        if (tb_value_dtm(value) > max_dtm) max_dtm = tb_value_dtm(value);
+    }
+
+    bool ok = tb_write_table(path, &table_layout, table_values, !config.wdl, max_dtm);
+    TBTable table = {
+        .layout = table_layout,
+        .has_dtm = true,
+        .max_dtm = max_dtm,
+        .values = table_values,
+    };
+    ok = tb_register_table(&table) && ok;
+
+    struct stat file_stat;
+    long file_size = (stat(path, &file_stat) == 0) ? (long)file_stat.st_size : 0;
+    printf("%s: %llu positions, %llu wins, %llu draws, %llu losses, longest mate %d plies, %.2fs, %ld bytes\n",
+           name, (unsigned long long)(wins + draws + losses), (unsigned long long)wins,
+           (unsigned long long)draws, (unsigned long long)losses, max_dtm, elapsed_seconds(&start), file_size);
+    fflush(stdout);
+    return ok;
+}
+
+// --- Command line ---
+
+static void print_usage() {
+    printf("Usage: xiangqi tbgen [options] <material...>\n"
+           "  A material lists Red's pieces in upper case and Black's in lower case,\n"
+           "  kings included (K king, A guard, B bishop, N horse, R rook, C cannon, P pawn),\n"
+           "  e.g. KRkaa. At most %d pieces.\n"
+           "  -dir <directory>   Tablebase directory (default %s)\n"
+           "  -threads <n>       Worker threads (default: all cores)\n"
+           "  -wdl               Store win/draw/loss only, without distances to mate\n",
+           TB_MAX_PIECES, TBGEN_DEFAULT_DIR);
+}
+
+int run_tablebase_generator(int argc, char* argv[]) {
+    config = (GeneratorConfig){
+        .dir = TBGEN_DEFAULT_DIR,
+        .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+    };
+
+    TBMaterial materials[64];
+    int material_count = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char* option = argv[i];
+        int remaining = argc - i - 1;
+        if (strcmp(option, "-dir") == 0 && remaining >= 1) {
+            config.dir = argv[++i];
+        } else if (strcmp(option, "-threads") == 0 && remaining >= 1) {
+            config.threads = atoi(argv[++i]);
+        } else if (strcmp(option, "-wdl") == 0) {
+            config.wdl = true;
+        } else if (option[0] != '-' && material_count < 64 && tb_parse_material(option, &materials[material_count])) {
+            material_count++;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (material_count == 0) {
+        print_usage();
+        return 1;
+    }
+    if (config.threads < 1) config.threads = 1;
+    if (config.threads > TBGEN_MAX_THREADS) config.threads = TBGEN_MAX_THREADS;
+    for (int i = 0; i < config.threads; ++i) {
+        workers[i].id = i;
+    }
+
+    if (mkdir(config.dir, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create tablebase directory: %s\n", config.dir);
+        return 1;
+    }
+
+    // Shared tables are initialized before any worker starts
+    Board board;
+    init_board(&board, NULL);
+    init_move_generator();
+
+    for (int i = 0; i < material_count; ++i) {
+        if (!generate_material(&materials[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef TABLEBASE_GEN_H
+#define TABLEBASE_GEN_H
+
+// Tablebase generator: "xiangqi tbgen [options] <material...>", e.g.
+// "xiangqi tbgen KRkaa KNPk". Generates the tables of the given materials
+// and of every material reachable from them by captures, by retrograde
+// analysis over all positions on all cores, and writes them to the tablebase
+// directory (see tablebase.h). Tables already in the directory are reused.
+// Returns the process exit code.
+int run_tablebase_generator(int argc, char* argv[]);
+
+#endif // TABLEBASE_GEN_H
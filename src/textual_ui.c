@@ -1,54 +1,91 @@
 #include "textual_ui.h"
 #include "bitboard.h"
 #include "move.h"
+#include "endgame.h"
 #include "engine.h"
+#include "tt.h"
+#include "protocol.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-// Helper to parse a move from algebraic notation (e.g., "h2e2")
-static Move parse_move_string(const char* move_str) {
-    if (strlen(move_str) != 4) return (Move){0,0};
+// File receiving one JSON record per search when statistics logging is on
+#define UI_STATS_FILE "search_stats.jsonl"
 
-    int from_c = move_str[0] - 'a';
-    int from_r = 9 - (move_str[1] - '0');
-    int to_c = move_str[2] - 'a';
-    int to_r = 9 - (move_str[3] - '0');
-
-    int from_sq = from_r * 9 + from_c;
-    int to_sq = to_r * 9 + to_c;
-
-    return (Move){from_sq, to_sq};
-}
-
-// Helper to get algebraic notation from square index
-static void get_square_notation(int sq, char* notation) {
-    if (sq < 0 || sq >= 90) {
-        strcpy(notation, "??");
-        return;
-    }
-    int r = sq / 9;
-    int c = sq % 9;
-    notation[0] = 'a' + c;
-    notation[1] = '0' + (9 - r);
-    notation[2] = '\0';
-}
+// Search limits used for the computer's moves
+#define UI_SEARCH_DEPTH 10
+#define UI_SEARCH_TIME_MS 5000
 
 void run_textual_ui() {
     Board board;
     init_board(&board, NULL); // Initialize with default position
     init_move_generator();
+    init_endgames();
+    init_tt();
+    clear_history_table();
+
+    // Pondering: while the user thinks, the engine searches the position after
+    // the reply it expects. A correct guess (ponder-hit) hands the running search
+    // over to the real time budget; a wrong one stops it, with the TT left warm.
+    // Off until the user turns it on with the "ponder" command.
+    bool ponder_enabled = false;
+    bool stats_enabled = false;
+    bool pondering = false;
+    bool ponder_hit = false;
+    Move ponder_move = {0, 0};
+
+    SearchLimits limits = {0};
+    limits.depth = UI_SEARCH_DEPTH;
+    limits.movetime = UI_SEARCH_TIME_MS;
 
     char input[10];
     while (1) {
         print_board(&board);
 
         if (board.player_to_move == PLAYER_R) {
-            printf("Enter your move (e.g. h2e2): ");
-            scanf("%s", input);
+            if (ponder_enabled && !pondering && (ponder_move.from_sq != 0 || ponder_move.to_sq != 0)) {
+                Board ponder_board;
+                copy_board(&board, &ponder_board);
+                move_piece(&ponder_board, ponder_move.from_sq, ponder_move.to_sq);
+
+                SearchLimits ponder_limits = limits;
+                ponder_limits.ponder = true;
+                search_async(&ponder_board, &ponder_limits, NULL);
+                pondering = true;
+
+                char move_str[5];
+                move_to_string(ponder_move, move_str);
+                printf("(Pondering on %s)\n", move_str);
+            }
+
+            printf("Enter your move (e.g. h2e2, 'ponder' or 'stats' to toggle pondering or statistics logging): ");
+            if (scanf("%9s", input) != 1) break;
 
             if (strcmp(input, "exit") == 0) break;
 
+            // A GUI speaking UCCI/UCI takes over the engine
+            if (strcmp(input, "ucci") == 0 || strcmp(input, "uci") == 0) {
+                if (pondering) {
+                    stop_search();
+                    wait_search();
+                }
+                run_protocol(input);
+                return;
+            }
+
+            if (strcmp(input, "ponder") == 0) {
+                ponder_enabled = !ponder_enabled;
+                printf("Pondering %s.\n", ponder_enabled ? "enabled" : "disabled");
+                continue;
+            }
+
+            if (strcmp(input, "stats") == 0) {
+                stats_enabled = !stats_enabled;
+                set_search_stats_file(stats_enabled ? UI_STATS_FILE : NULL);
+                printf("Search statistics logging to %s %s.\n", UI_STATS_FILE, stats_enabled ? "enabled" : "disabled");
+                continue;
+            }
+
             Move user_move = parse_move_string(input);
             
             // Basic validation
@@ -63,6 +100,17 @@ void run_textual_ui() {
             }
 
             if (move_is_legal) {
+                if (pondering) {
+                    if (is_same_move(user_move, ponder_move)) {
+                        printf("Ponder hit.\n");
+                        time_ponderhit();
+                        ponder_hit = true;
+                    } else {
+                        stop_search();
+                        wait_search();
+                    }
+                    pondering = false;
+                }
                 move_piece(&board, user_move.from_sq, user_move.to_sq);
             } else {
                 printf("Illegal move.\n");
@@ -71,13 +119,18 @@ void run_textual_ui() {
 
         } else {
             printf("Computer is thinking...\n");
-            Move best_move = search(&board, 10, 5000); // 5 seconds time limit, depth 6
+            Move best_move;
+            if (ponder_hit) {
+                best_move = wait_search(); // The ponder search continues under the real budget
+                ponder_hit = false;
+            } else {
+                best_move = search_position(&board, &limits);
+            }
             if (best_move.from_sq != 0 || best_move.to_sq != 0) {
-                char from_notation[3];
-                char to_notation[3];
-                get_square_notation(best_move.from_sq, from_notation);
-                get_square_notation(best_move.to_sq, to_notation);
-                printf("Computer moves: %s%s\n", from_notation, to_notation);
+                char move_str[5];
+                move_to_string(best_move, move_str);
+                printf("Computer moves: %s\n", move_str);
+                ponder_move = get_ponder_move(&board, best_move);
                 move_piece(&board, best_move.from_sq, best_move.to_sq);
             } else {
                 printf("Checkmate or stalemate!\n");
@@ -85,4 +138,9 @@ void run_textual_ui() {
             }
         }
     }
-}
\ No newline at end of file
+
+    if (pondering) {
+        stop_search();
+        wait_search();
+    }
+}
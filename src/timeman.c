@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "timeman.h"
+#include <stdatomic.h>
+#include <time.h>
+
+// Safety margin kept on the clock for move transmission and process overhead
+#define MOVE_OVERHEAD_MS 30
+
+// Moves assumed to remain in sudden death time controls
+#define DEFAULT_MOVES_TO_GO 30
+
+// Score drop (in centipawns) between iterations that triggers a time extension
+#define SCORE_DROP_MARGIN 30
+
+// Written by time_ponderhit() from the UI thread while the search thread reads them
+static _Atomic long start_time;
+static atomic_bool pondering;
+
+static long soft_limit;   // Target time; no new iteration is started past it
+static long hard_limit;   // Absolute maximum; the search aborts when it is reached
+static long optimum_time; // Soft limit before stability/score adjustments
+static int best_move_stability;
+
+long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void time_start(bool ponder) {
+    start_time = now_ms();
+    pondering = ponder;
+}
+
+void time_init(const SearchLimits* limits) {
+    soft_limit = hard_limit = optimum_time = 0;
+    best_move_stability = 0;
+
+    if (limits->movetime > 0) {
+        // Fixed time per move: use all of it
+        soft_limit = hard_limit = limits->movetime;
+    } else if (limits->time_left > 0) {
+        long available = limits->time_left - MOVE_OVERHEAD_MS;
+        if (available < 1) available = 1;
+
+        int moves_to_go = (limits->moves_to_go > 0) ? limits->moves_to_go : DEFAULT_MOVES_TO_GO;
+        if (moves_to_go > 50) moves_to_go = 50;
+
+        soft_limit = available / moves_to_go + limits->increment * 3 / 4;
+
+        // Allow an unstable search to overrun the target, but never spend more
+        // than a fraction of the clock on a single move
+        hard_limit = soft_limit * 4;
+        long max_hard = (moves_to_go == 1) ? available : available / 3;
+        if (hard_limit > max_hard) hard_limit = max_hard;
+        if (soft_limit > hard_limit) soft_limit = hard_limit;
+
+        // A limit of 0 means "none": a nearly empty clock still gets one
+        if (soft_limit < 1) soft_limit = 1;
+        if (hard_limit < 1) hard_limit = 1;
+    }
+    optimum_time = soft_limit;
+}
+
+long time_elapsed() {
+    return now_ms() - start_time;
+}
+
+bool time_hard_limit_reached() {
+    return hard_limit > 0 && !pondering && time_elapsed() >= hard_limit;
+}
+
+void time_update_iteration(bool best_move_changed, int score, int previous_score) {
+    if (optimum_time == 0 || soft_limit == hard_limit) {
+        return; // No clock to manage, or a fixed move time
+    }
+
+    best_move_stability = best_move_changed ? 0 : best_move_stability + 1;
+
+    // An unstable best move needs more time, a stable one less
+    double scale;
+    if (best_move_stability == 0) scale = 1.6;
+    else if (best_move_stability == 1) scale = 1.2;
+    else if (best_move_stability <= 3) scale = 0.9;
+    else scale = 0.7;
+
+    // A falling score means the position is worse than we thought: think longer
+    if (score < previous_score - SCORE_DROP_MARGIN) {
+        scale *= 1.4;
+    }
+
+    soft_limit = (long)(optimum_time * scale);
+    if (soft_limit > hard_limit) soft_limit = hard_limit;
+}
+
+bool time_soft_limit_reached() {
+    return soft_limit > 0 && !pondering && time_elapsed() >= soft_limit;
+}
+
+void time_ponderhit() {
+    start_time = now_ms();
+    pondering = false;
+}
+
+bool time_is_pondering() {
+    return pondering;
+}
@@ -0,0 +1,53 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Limits for a single search. Zero means "not set" for every field.
+typedef struct {
+    int depth;          // Maximum iterative deepening depth
+    long movetime;      // Fixed time for this move in ms
+    long time_left;     // Remaining time on our clock in ms
+    long increment;     // Increment per move in ms
+    int moves_to_go;    // Moves until the next time control, 0 for sudden death
+    uint64_t nodes;     // Maximum nodes of the main search thread
+    bool ponder;        // Search on the opponent's time; limits apply only after time_ponderhit()
+    bool infinite;      // Search until stopped; the result is held back until then
+} SearchLimits;
+
+// Nodes searched between two clock polls inside the search
+#define TIME_CHECK_INTERVAL 2048
+
+// Returns milliseconds from a monotonic wall clock (unaffected by CPU load or threads).
+long now_ms();
+
+// Starts the clock of a search, pondering or not. Called before the search
+// thread starts, so that a ponder-hit arriving before time_init() is kept.
+void time_start(bool ponder);
+
+// Computes the soft and hard limits for this search; the clock and the
+// ponder state are those of time_start() and time_ponderhit().
+void time_init(const SearchLimits* limits);
+
+// Milliseconds elapsed since time_start() or the ponder-hit.
+long time_elapsed();
+
+// Returns true if the hard limit has been reached and the search must abort immediately.
+bool time_hard_limit_reached();
+
+// Called after every completed iteration; adjusts the soft limit based on
+// best-move stability and score drops between iterations.
+void time_update_iteration(bool best_move_changed, int score, int previous_score);
+
+// Returns true if no new iteration should be started.
+bool time_soft_limit_reached();
+
+// Switches a ponder search to the real time budget, counted from now.
+// Safe to call from a thread other than the searching one.
+void time_ponderhit();
+
+// Returns true while a ponder search is waiting for its ponder-hit.
+bool time_is_pondering();
+
+#endif // TIMEMAN_H
@@ -1,32 +1,514 @@
+#define _GNU_SOURCE // MAP_ANONYMOUS, MAP_HUGETLB, MADV_HUGEPAGE
+
 #include "tt.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Packed entry, 10 bytes. The upper 16 bits of the key are implied by the
+// bucket index (see bucket_for), the lower 16 bits are stored for verification.
+typedef struct {
+    uint16_t key16;
+    uint16_t move16;    // from_sq | to_sq << 7
+    int16_t score;
+    int16_t eval;
+    int8_t depth;
+    uint8_t gen_bound;  // Generation in the upper 6 bits, bound (TT_*) in the lower 2
+} PackedTTEntry;
+
+// Six entries fill one 64-byte cache line, so a probe touches a single line
+#define TT_BUCKET_SIZE 6
+
+typedef struct {
+    PackedTTEntry entries[TT_BUCKET_SIZE];
+    char padding[64 - TT_BUCKET_SIZE * sizeof(PackedTTEntry)];
+} TTBucket;
+
+_Static_assert(sizeof(PackedTTEntry) == 10, "PackedTTEntry must stay 10 bytes");
+_Static_assert(sizeof(TTBucket) == 64, "TTBucket must fill one cache line");
+
+#define BOUND_MASK 0x03
+#define GENERATION_STEP 4  // One generation in gen_bound
+#define GENERATION_CYCLE 256
+
+// Depth a stored entry loses per generation of age when choosing a victim
+#define AGE_WEIGHT 8
+
+// Depth a stored entry gains by its bound when choosing a victim: exact
+// scores and lower bounds (fail-highs, which carry a refutation move) are
+// kept ahead of upper bounds of the same depth and age
+#define EXACT_BOUND_BONUS 2
+#define LOWER_BOUND_BONUS 1
+
+// On-disk format: a header of one cache line followed by the buckets, so that
+// a mapped file keeps the buckets aligned
+#define TT_FILE_MAGIC "XQTTABLE"
+#define TT_FILE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t bucket_size;   // sizeof(TTBucket): the entry layout
+    uint64_t bucket_count;
+    uint64_t key_scheme;    // Fingerprint of the Zobrist keys, see key_scheme()
+    uint8_t generation;
+    char padding[64 - 33];
+} TTFileHeader;
+
+_Static_assert(sizeof(TTFileHeader) == sizeof(TTBucket), "TTFileHeader must fill one cache line");
+
+// The transposition table itself, allocated at runtime (see resize_tt) or
+// mapped from a file (see map_tt_file)
+static TTBucket* transposition_table = NULL;
+static size_t bucket_count = 0;
+static void* mapping = NULL;              // Start of the mapping holding the table
+static size_t mapping_bytes = 0;
+static TTFileHeader* file_header = NULL;  // Header of the mapped file, NULL for memory tables
+static bool huge_pages = false;
+static uint8_t generation = 0; // Multiple of GENERATION_STEP
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Tables smaller than this are cleared on the calling thread
+#define PARALLEL_CLEAR_MIN_BYTES (64 * 1024 * 1024)
+#define MAX_CLEAR_THREADS 64
+
+static int clear_threads = 1;
+
+// --- Allocation ---
+
+// Maps bytes (a multiple of HUGE_PAGE_SIZE) of zeroed memory. Explicit huge
+// pages (MAP_HUGETLB) are used if the system has reserved enough of them;
+// otherwise the mapping is aligned to HUGE_PAGE_SIZE and marked for
+// transparent huge pages, which the kernel may or may not grant.
+static TTBucket* map_table(size_t bytes, bool* huge) {
+    void* table;
+#ifdef MAP_HUGETLB
+    table = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (table != MAP_FAILED) {
+        *huge = true;
+        return (TTBucket*)table;
+    }
+#endif
+    *huge = false;
+
+    // Over-map by one huge page and trim both ends to align the start
+    size_t mapped = bytes + HUGE_PAGE_SIZE;
+    char* region = (char*)mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    char* start = (char*)(((uintptr_t)region + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (start > region) {
+        munmap(region, start - region);
+    }
+    if (region + mapped > start + bytes) {
+        munmap(start + bytes, region + mapped - (start + bytes));
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(start, bytes, MADV_HUGEPAGE);
+#endif
+    return (TTBucket*)start;
+}
+
+static size_t buckets_for_size(size_t size_mb) {
+    size_t buckets = size_mb * 1024 * 1024 / sizeof(TTBucket);
+    return buckets > 0 ? buckets : 1;
+}
+
+// Unmaps the current table; a mapped file is written back first
+static void release_table() {
+    if (mapping == NULL) {
+        return;
+    }
+    if (file_header != NULL) {
+        file_header->generation = generation;
+        msync(mapping, mapping_bytes, MS_SYNC);
+    }
+    munmap(mapping, mapping_bytes);
+    transposition_table = NULL;
+    mapping = NULL;
+    file_header = NULL;
+}
 
-// Transposition table size (e.g., 2^20 entries)
-#define TT_SIZE (1 << 20)
+// Replaces the table with a zeroed memory table of the given number of
+// buckets. Returns false, keeping the current table, if it cannot be allocated.
+static bool allocate_table(size_t buckets) {
+    size_t bytes = (buckets * sizeof(TTBucket) + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    bool huge;
+    TTBucket* table = map_table(bytes, &huge);
+    if (!table) {
+        fprintf(stderr, "Failed to allocate %zu MB for the transposition table.\n", bytes / (1024 * 1024));
+        return false;
+    }
+    release_table();
+    transposition_table = table;
+    bucket_count = buckets;
+    mapping = table;
+    mapping_bytes = bytes;
+    huge_pages = huge;
+    return true;
+}
+
+void resize_tt(size_t size_mb) {
+    if (allocate_table(buckets_for_size(size_mb))) {
+        init_tt(); // The mapping is zeroed already; clearing it in parallel faults its pages in up front
+    }
+}
+
+bool tt_uses_huge_pages() {
+    return huge_pages;
+}
+
+// --- Clearing ---
+
+typedef struct {
+    char* start;
+    size_t bytes;
+} ClearRange;
+
+static void* clear_range(void* arg) {
+    ClearRange* range = (ClearRange*)arg;
+    memset(range->start, 0, range->bytes);
+    return NULL;
+}
+
+void set_tt_threads(int count) {
+    if (count < 1) count = 1;
+    if (count > MAX_CLEAR_THREADS) count = MAX_CLEAR_THREADS;
+    clear_threads = count;
+}
+
+// Splits the table into one range per thread, on bucket boundaries. Ranges
+// whose thread cannot be started are cleared by the calling thread.
+static void clear_table() {
+    size_t bytes = bucket_count * sizeof(TTBucket);
+    int threads = (bytes < PARALLEL_CLEAR_MIN_BYTES) ? 1 : clear_threads;
 
-// The transposition table itself
-static TTEntry transposition_table[TT_SIZE];
+    ClearRange ranges[MAX_CLEAR_THREADS];
+    pthread_t ids[MAX_CLEAR_THREADS];
+    bool started[MAX_CLEAR_THREADS] = {false};
+    size_t buckets_per_thread = bucket_count / threads;
+
+    for (int i = 0; i < threads; ++i) {
+        size_t first = i * buckets_per_thread;
+        size_t last = (i == threads - 1) ? bucket_count : first + buckets_per_thread;
+        ranges[i].start = (char*)&transposition_table[first];
+        ranges[i].bytes = (last - first) * sizeof(TTBucket);
+        if (i > 0) {
+            started[i] = (pthread_create(&ids[i], NULL, clear_range, &ranges[i]) == 0);
+        }
+    }
+    for (int i = 0; i < threads; ++i) {
+        if (!started[i]) {
+            clear_range(&ranges[i]);
+        }
+    }
+    for (int i = 1; i < threads; ++i) {
+        if (started[i]) {
+            pthread_join(ids[i], NULL);
+        }
+    }
+}
 
 void init_tt() {
-    // Initialize all entries to zero/empty state
-    memset(transposition_table, 0, sizeof(transposition_table));
+    if (!transposition_table) {
+        resize_tt(TT_DEFAULT_SIZE_MB);
+        return;
+    }
+    clear_table();
+    generation = 0;
+    if (file_header != NULL) {
+        file_header->generation = generation;
+    }
+}
+
+void tt_new_search() {
+    generation += GENERATION_STEP; // Wraps around after 64 searches
+    if (file_header != NULL) {
+        file_header->generation = generation;
+    }
+}
+
+// --- Files ---
+
+// FNV-1a over the Zobrist keys: a table is only valid with the keys it was built with
+static uint64_t key_scheme() {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const unsigned char* bytes = (const unsigned char*)zobrist_keys;
+    for (size_t i = 0; i < sizeof(zobrist_keys); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    bytes = (const unsigned char*)&zobrist_player;
+    for (size_t i = 0; i < sizeof(zobrist_player); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void fill_header(TTFileHeader* header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TT_FILE_MAGIC, sizeof(header->magic));
+    header->version = TT_FILE_VERSION;
+    header->bucket_size = sizeof(TTBucket);
+    header->bucket_count = bucket_count;
+    header->key_scheme = key_scheme();
+    header->generation = generation;
 }
 
-TTEntry* probe_tt(uint64_t hash_key) {
-    // Use modulo for simple hashing
-    unsigned int index = hash_key % TT_SIZE;
-    if (transposition_table[index].hash_key == hash_key) {
-        return &transposition_table[index];
+// Returns NULL if the header describes a table this build can use, otherwise the reason
+static const char* check_header(const TTFileHeader* header) {
+    if (memcmp(header->magic, TT_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        return "not a transposition table file";
+    }
+    if (header->version != TT_FILE_VERSION || header->bucket_size != sizeof(TTBucket)) {
+        return "unsupported format version";
+    }
+    if (header->key_scheme != key_scheme()) {
+        return "written with different hash keys";
+    }
+    if (header->bucket_count == 0) {
+        return "empty table";
     }
     return NULL;
 }
 
-void store_tt_entry(uint64_t hash_key, int depth, int score, int flag, Move best_move) {
-    unsigned int index = hash_key % TT_SIZE;
-    // Always replace scheme (simplest, can be improved with depth/age replacement)
-    transposition_table[index].hash_key = hash_key;
-    transposition_table[index].depth = depth;
-    transposition_table[index].score = score;
-    transposition_table[index].flag = flag;
-    transposition_table[index].best_move = best_move;
+// Whether a file of the given size holds exactly the buckets its header
+// counts; compared by division, as the count may be anything
+static bool file_size_matches(const TTFileHeader* header, off_t file_size) {
+    if (file_size < (off_t)sizeof(TTFileHeader)) {
+        return false;
+    }
+    uint64_t table_bytes = (uint64_t)file_size - sizeof(TTFileHeader);
+    return table_bytes % sizeof(TTBucket) == 0 && table_bytes / sizeof(TTBucket) == header->bucket_count;
+}
+
+bool save_tt(const char* path) {
+    if (file_header != NULL) {
+        // A mapped table is its own file; only its header may be behind
+        file_header->generation = generation;
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing.\n", path);
+        return false;
+    }
+    TTFileHeader header;
+    fill_header(&header);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+              && fwrite(transposition_table, sizeof(TTBucket), bucket_count, file) == bucket_count;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write the transposition table to %s.\n", path);
+    }
+    return ok;
+}
+
+bool load_tt(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open transposition table file: %s\n", path);
+        return false;
+    }
+    // The header is checked against the file size before the current table is replaced
+    TTFileHeader header;
+    struct stat file_stat;
+    const char* error = (fread(&header, sizeof(header), 1, file) == 1) ? check_header(&header) : "truncated file";
+    if (error == NULL && fstat(fileno(file), &file_stat) != 0) {
+        error = "cannot read file size";
+    } else if (error == NULL && !file_size_matches(&header, file_stat.st_size)) {
+        error = "file size does not match its header";
+    }
+    if (error != NULL) {
+        fprintf(stderr, "Cannot load %s: %s.\n", path, error);
+        fclose(file);
+        return false;
+    }
+    if (!allocate_table(header.bucket_count)) {
+        fclose(file);
+        return false;
+    }
+    bool ok = fread(transposition_table, sizeof(TTBucket), bucket_count, file) == bucket_count;
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Cannot load %s: truncated file.\n", path);
+        init_tt(); // Keep the new size, but not a partial table
+        return false;
+    }
+    generation = header.generation;
+    return true;
+}
+
+bool map_tt_file(const char* path, size_t size_mb) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open transposition table file: %s\n", path);
+        return false;
+    }
+
+    struct stat file_stat;
+    TTFileHeader header;
+    size_t buckets;
+    const char* error = NULL;
+    bool created = false;
+    if (fstat(fd, &file_stat) != 0) {
+        error = "cannot read file size";
+    } else if (file_stat.st_size == 0) {
+        // New file: the table starts empty (a file is extended with zeros)
+        created = true;
+        buckets = buckets_for_size(size_mb);
+        if (ftruncate(fd, (off_t)(sizeof(TTFileHeader) + buckets * sizeof(TTBucket))) != 0) {
+            error = "cannot extend file";
+        }
+    } else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        error = "truncated file";
+    } else if ((error = check_header(&header)) == NULL) {
+        buckets = header.bucket_count;
+        if (!file_size_matches(&header, file_stat.st_size)) {
+            error = "file size does not match its header";
+        }
+    }
+
+    void* base = MAP_FAILED;
+    size_t bytes = 0;
+    if (error == NULL) {
+        bytes = sizeof(TTFileHeader) + buckets * sizeof(TTBucket);
+        base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            error = "cannot map file";
+        }
+    }
+    close(fd);
+    if (error != NULL) {
+        fprintf(stderr, "Cannot map %s: %s.\n", path, error);
+        return false;
+    }
+
+    release_table();
+    mapping = base;
+    mapping_bytes = bytes;
+    file_header = (TTFileHeader*)base;
+    transposition_table = (TTBucket*)base + 1;
+    bucket_count = buckets;
+    huge_pages = false;
+    if (created) {
+        generation = 0;
+        fill_header(file_header);
+    } else {
+        generation = file_header->generation;
+    }
+    return true;
+}
+
+bool tt_is_mapped() {
+    return file_header != NULL;
+}
+
+// Multiply-shift: maps the upper bits of the key uniformly onto any table size
+static inline TTBucket* bucket_for(uint64_t hash_key) {
+    return &transposition_table[(size_t)(((unsigned __int128)hash_key * bucket_count) >> 64)];
+}
+
+// Generations since the entry was last written or found
+static inline int entry_age(const PackedTTEntry* entry) {
+    int entry_generation = entry->gen_bound & ~BOUND_MASK;
+    return ((GENERATION_CYCLE + generation - entry_generation) & (GENERATION_CYCLE - 1)) / GENERATION_STEP;
+}
+
+// Worth of keeping an entry; the bucket's least valuable entry is replaced
+static inline int replacement_value(const PackedTTEntry* entry) {
+    int bound = entry->gen_bound & BOUND_MASK;
+    int bonus = (bound == TT_EXACT) ? EXACT_BOUND_BONUS : (bound == TT_LOWER) ? LOWER_BOUND_BONUS : 0;
+    return entry->depth - AGE_WEIGHT * entry_age(entry) + bonus;
+}
+
+static inline uint16_t pack_move(Move move) {
+    return (uint16_t)(move.from_sq | move.to_sq << 7);
+}
+
+static inline Move unpack_move(uint16_t move16) {
+    return (Move){move16 & 0x7f, move16 >> 7};
+}
+
+bool probe_tt(uint64_t hash_key, TTEntry* entry) {
+    TTBucket* bucket = bucket_for(hash_key);
+    uint16_t key16 = (uint16_t)hash_key;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        PackedTTEntry* slot = &bucket->entries[i];
+        if (slot->key16 == key16 && (slot->gen_bound & BOUND_MASK)) {
+            // Refresh the generation so that entries still in use are kept
+            slot->gen_bound = generation | (slot->gen_bound & BOUND_MASK);
+
+            entry->best_move = unpack_move(slot->move16);
+            entry->score = slot->score;
+            entry->eval = slot->eval;
+            entry->depth = slot->depth;
+            entry->flag = slot->gen_bound & BOUND_MASK;
+            return true;
+        }
+    }
+    return false;
+}
+
+void store_tt_entry(uint64_t hash_key, int depth, int score, int eval, int flag, Move best_move) {
+    TTBucket* bucket = bucket_for(hash_key);
+    uint16_t key16 = (uint16_t)hash_key;
+
+    // Use the slot of the same position or an empty one; otherwise replace
+    // the least valuable entry, counting depth, age and bound
+    PackedTTEntry* replace = NULL;
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        PackedTTEntry* slot = &bucket->entries[i];
+        if (slot->key16 == key16 || !(slot->gen_bound & BOUND_MASK)) {
+            replace = slot;
+            break;
+        }
+        if (replace == NULL || replacement_value(slot) < replacement_value(replace)) {
+            replace = slot;
+        }
+    }
+
+    bool same_position = (replace->key16 == key16 && (replace->gen_bound & BOUND_MASK));
+    if (same_position) {
+        // Keep the known move if this result has none
+        if (best_move.from_sq == 0 && best_move.to_sq == 0) {
+            best_move = unpack_move(replace->move16);
+        }
+        // A much deeper bound of the current search is worth more than a shallow one
+        if (flag != TT_EXACT && entry_age(replace) == 0 && depth + 4 <= replace->depth) {
+            replace->move16 = pack_move(best_move);
+            return;
+        }
+    }
+
+    replace->key16 = key16;
+    replace->move16 = pack_move(best_move);
+    replace->score = (int16_t)score;
+    replace->eval = (int16_t)eval;
+    replace->depth = (int8_t)depth;
+    replace->gen_bound = generation | (uint8_t)flag;
+}
+
+void prefetch_tt(uint64_t hash_key) {
+    __builtin_prefetch(bucket_for(hash_key));
+}
+
+int tt_hashfull() {
+    size_t samples = bucket_count < 1000 ? bucket_count : 1000;
+    int used = 0;
+    for (size_t i = 0; i < samples; ++i) {
+        for (int j = 0; j < TT_BUCKET_SIZE; ++j) {
+            const PackedTTEntry* slot = &transposition_table[i].entries[j];
+            if ((slot->gen_bound & BOUND_MASK) && entry_age(slot) == 0) {
+                used++;
+            }
+        }
+    }
+    return (int)(used * 1000 / (samples * TT_BUCKET_SIZE));
 }
@@ -3,30 +3,92 @@
 
 #include "bitboard.h"
 #include "move.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-// Transposition Table Entry Flags
-#define TT_EXACT 0
+// Transposition Table Entry Flags (bounds); 0 marks an empty slot
 #define TT_LOWER 1 // alpha
 #define TT_UPPER 2 // beta
+#define TT_EXACT 3
 
-// A single entry in the transposition table
+// Depth stored by the quiescence search. It is below every main search depth
+// (including the depth-0 frontier, which may still be extended when in check),
+// so quiescence entries never cut off a main search node.
+#define TT_DEPTH_QS -1
+
+// Static evaluation stored with entries whose node did not compute one
+#define TT_EVAL_NONE INT16_MIN
+
+// A transposition table entry as returned by probe_tt(). The table stores it
+// packed; the table is shared by all search threads without locking, so a
+// torn entry can at worst yield a wrong score or an illegal move, and moves
+// are always checked against the move list.
 typedef struct {
-    uint64_t hash_key; // Zobrist key
-    int depth;
+    Move best_move;
     int score;
+    int eval;   // Static evaluation, or TT_EVAL_NONE
+    int depth;
     int flag;
-    Move best_move;
 } TTEntry;
 
-// Initializes the transposition table
+// Default table size, used until resize_tt() is called
+#define TT_DEFAULT_SIZE_MB 32
+#define TT_MAX_SIZE_MB (1024 * 1024)
+
+// Initializes the transposition table: allocates it with the default size on
+// first use, clears it afterwards. Must be called before the first search.
 void init_tt();
 
+// Reallocates the table with the given size in MB; its contents are lost.
+// The table is backed by 2 MB huge pages when the system provides them, and
+// by normal pages otherwise. Must not be called while a search is running.
+void resize_tt(size_t size_mb);
+
+// Returns whether the table is backed by explicitly reserved huge pages
+// (MAP_HUGETLB). Otherwise transparent huge pages have only been requested.
+bool tt_uses_huge_pages();
+
+// Sets the number of threads that clear the table in init_tt() and
+// resize_tt(). Small tables are always cleared by the calling thread.
+void set_tt_threads(int count);
+
+// Writes the table to a file: a versioned header (table size, entry layout,
+// fingerprint of the Zobrist keys, generation) followed by the buckets.
+// Returns false on I/O errors.
+bool save_tt(const char* path);
+
+// Replaces the table with one written by save_tt(), resizing it to the saved
+// size. Files of another format version or from other hash keys are
+// rejected. Returns false on failure; the current table is then kept unless
+// the file was truncated. Must not be called while a search is running.
+bool load_tt(const char* path);
+
+// Maps a table file (same format as save_tt) as the table itself, so that
+// everything the search stores persists in the file. A missing or empty file
+// is created with the given size in MB; an existing one keeps its saved size.
+// resize_tt() and load_tt() go back to a memory table. Returns false on
+// failure, keeping the current table. Must not be called while a search is running.
+bool map_tt_file(const char* path, size_t size_mb);
+
+// Returns whether the table is mapped from a file (map_tt_file)
+bool tt_is_mapped();
+
+// Starts a new search generation. Entries of older searches are kept, but
+// are replaced first. Called once per search instead of clearing the table.
+void tt_new_search();
+
 // Probes the transposition table for a given hash key.
-// Returns a pointer to the entry if found, otherwise NULL.
-TTEntry* probe_tt(uint64_t hash_key);
+// Returns true and copies the entry if found.
+bool probe_tt(uint64_t hash_key, TTEntry* entry);
 
 // Stores an entry in the transposition table.
-void store_tt_entry(uint64_t hash_key, int depth, int score, int flag, Move best_move);
+void store_tt_entry(uint64_t hash_key, int depth, int score, int eval, int flag, Move best_move);
+
+// Starts loading the bucket of the given key into the cache ahead of a probe.
+void prefetch_tt(uint64_t hash_key);
+
+// Returns the permille of sampled entries used by the current search.
+int tt_hashfull();
 
 #endif // TT_H
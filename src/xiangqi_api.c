@@ -0,0 +1,305 @@
+#include "xiangqi_api.h"
+#include "bitboard.h"
+#include "move.h"
+#include "endgame.h"
+#include "engine.h"
+#include "evaluate.h"
+#include "tt.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct xq_board {
+    Board board;
+};
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t search_mutex = PTHREAD_MUTEX_INITIALIZER; // Guards the engine
+
+static const char FEN_PIECES[] = "kabnrcpKABNRCP";
+
+static void init_tables() {
+    Board board;
+    init_board(&board, NULL); // Bitboard masks and Zobrist keys
+    init_move_generator();
+    init_endgames();
+    init_tt();
+    clear_history_table();
+    set_search_output(SEARCH_OUTPUT_NONE);
+    set_use_opening_book(false);
+}
+
+int xq_api_version(void) {
+    return XQ_API_VERSION;
+}
+
+void xq_init(void) {
+    pthread_once(&init_once, init_tables);
+}
+
+// --- Boards ---
+
+// parse_fen() trusts its input: the FEN must have ten rows of nine squares,
+// known pieces, one king per side and a side to move
+static bool fen_is_valid(const char* fen) {
+    if (fen == NULL) {
+        return false;
+    }
+    int rows = 1, squares = 0, red_kings = 0, black_kings = 0;
+    const char* p = fen;
+    for (; *p != ' ' && *p != '\0'; ++p) {
+        if (*p == '/') {
+            if (squares != 9) return false;
+            rows++;
+            squares = 0;
+        } else if (*p >= '1' && *p <= '9') {
+            squares += *p - '0';
+        } else if (strchr(FEN_PIECES, *p) != NULL) {
+            squares++;
+            red_kings += (*p == 'K');
+            black_kings += (*p == 'k');
+        } else {
+            return false;
+        }
+        if (squares > 9) return false;
+    }
+    return rows == 10 && squares == 9 && red_kings == 1 && black_kings == 1 && *p == ' '
+           && (p[1] == 'w' || p[1] == 'r' || p[1] == 'b');
+}
+
+static bool load_fen(Board* board, const char* fen) {
+    if (!fen_is_valid(fen)) {
+        return false;
+    }
+    parse_fen(board, fen);
+    return true;
+}
+
+xq_board* xq_board_new(const char* fen) {
+    xq_init();
+    xq_board* board = (xq_board*)malloc(sizeof(xq_board));
+    if (!board) {
+        return NULL;
+    }
+    if (fen == NULL) {
+        fen = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1";
+    }
+    if (!load_fen(&board->board, fen)) {
+        free(board);
+        return NULL;
+    }
+    return board;
+}
+
+xq_board* xq_board_clone(const xq_board* board) {
+    xq_board* clone = (xq_board*)malloc(sizeof(xq_board));
+    if (clone) {
+        copy_board(&board->board, &clone->board);
+    }
+    return clone;
+}
+
+void xq_board_free(xq_board* board) {
+    free(board);
+}
+
+int xq_board_set_fen(xq_board* board, const char* fen) {
+    xq_init();
+    Board parsed;
+    if (!load_fen(&parsed, fen)) {
+        return -1;
+    }
+    copy_board(&parsed, &board->board);
+    return 0;
+}
+
+int xq_board_get_fen(const xq_board* board, char* buffer, size_t size) {
+    char fen[128];
+    to_fen(&board->board, fen);
+    size_t length = strlen(fen);
+    if (length + 1 > size) {
+        return -1;
+    }
+    memcpy(buffer, fen, length + 1);
+    return (int)length;
+}
+
+int xq_board_side_to_move(const xq_board* board) {
+    return board->board.player_to_move;
+}
+
+uint64_t xq_board_hash(const xq_board* board) {
+    return board->board.hash_key;
+}
+
+int xq_board_piece_at(const xq_board* board, int sq) {
+    return (sq >= 0 && sq < XQ_SQUARES) ? board->board.board[sq] : 0;
+}
+
+int xq_board_in_check(const xq_board* board) {
+    return is_king_in_check(&board->board, board->board.player_to_move);
+}
+
+static int move_code(Move move) {
+    return move.from_sq * XQ_SQUARES + move.to_sq;
+}
+
+int xq_legal_moves(const xq_board* board, int* moves, int capacity) {
+    Board copy;
+    copy_board(&board->board, &copy);
+    MoveList legal;
+    generate_legal_moves(&copy, &legal);
+    for (int i = 0; i < legal.count && i < capacity; ++i) {
+        moves[i] = move_code(legal.moves[i]);
+    }
+    return legal.count;
+}
+
+int xq_make_move(xq_board* board, int move) {
+    if (move < 0 || move >= XQ_MOVE_SPACE) {
+        return -1;
+    }
+    MoveList legal;
+    generate_legal_moves(&board->board, &legal);
+    for (int i = 0; i < legal.count; ++i) {
+        if (move_code(legal.moves[i]) == move) {
+            // Long games keep the recent half of the history for repetitions
+            if (board->board.history_ply >= MAX_HISTORY - 1) {
+                trim_history(&board->board, MAX_HISTORY / 2);
+            }
+            move_piece(&board->board, legal.moves[i].from_sq, legal.moves[i].to_sq);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int xq_parse_move(const char* text) {
+    Move move = parse_move_string(text);
+    return (move.from_sq == 0 && move.to_sq == 0) ? XQ_NO_MOVE : move_code(move);
+}
+
+void xq_move_to_string(int move, char* text) {
+    move_to_string((Move){move / XQ_SQUARES, move % XQ_SQUARES}, text);
+}
+
+// --- Evaluation and search ---
+
+int xq_evaluate(const xq_board* board) {
+    Board copy;
+    copy_board(&board->board, &copy);
+    return evaluate(&copy);
+}
+
+int xq_search(const xq_board* board, int depth, long movetime_ms, uint64_t nodes, int* score) {
+    xq_init();
+    Board copy;
+    copy_board(&board->board, &copy);
+    SearchLimits limits = {
+        .depth = depth,
+        .movetime = movetime_ms,
+        .nodes = nodes,
+    };
+    // Without any limit the search would hold the engine forever
+    if (depth <= 0 && movetime_ms <= 0 && nodes == 0) {
+        limits.depth = XQ_DEFAULT_SEARCH_DEPTH;
+    }
+
+    pthread_mutex_lock(&search_mutex);
+    Move best_move = search_position(&copy, &limits);
+    int best_score, completed_depth;
+    get_search_result(&best_score, &completed_depth);
+    pthread_mutex_unlock(&search_mutex);
+
+    // A search stopped early still yields a root move, so a null move means
+    // there are no legal moves; check anyway, as callers rely on it
+    if (best_move.from_sq == 0 && best_move.to_sq == 0) {
+        MoveList legal;
+        generate_legal_moves(&copy, &legal);
+        if (legal.count == 0) {
+            if (score) {
+                *score = best_score;
+            }
+            return XQ_NO_MOVE;
+        }
+        best_move = legal.moves[0];
+    }
+    if (score) {
+        *score = best_score;
+    }
+    return move_code(best_move);
+}
+
+void xq_new_game(void) {
+    xq_init();
+    pthread_mutex_lock(&search_mutex);
+    init_tt();
+    clear_history_table();
+    pthread_mutex_unlock(&search_mutex);
+}
+
+// --- Batches ---
+
+size_t xq_batch_legal_masks(const char* const* fens, size_t count, uint8_t* masks) {
+    xq_init();
+    memset(masks, 0, count * XQ_MOVE_SPACE);
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Board board;
+        if (!load_fen(&board, fens[i])) {
+            continue;
+        }
+        MoveList legal;
+        generate_legal_moves(&board, &legal);
+        uint8_t* mask = masks + i * XQ_MOVE_SPACE;
+        for (int m = 0; m < legal.count; ++m) {
+            mask[move_code(legal.moves[m])] = 1;
+        }
+        valid++;
+    }
+    return valid;
+}
+
+size_t xq_batch_evaluate(const char* const* fens, size_t count, int32_t* scores) {
+    xq_init();
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Board board;
+        scores[i] = 0;
+        if (load_fen(&board, fens[i])) {
+            scores[i] = evaluate(&board);
+            valid++;
+        }
+    }
+    return valid;
+}
+
+size_t xq_batch_planes(const char* const* fens, size_t count, uint8_t* planes, int8_t* sides) {
+    xq_init();
+    memset(planes, 0, count * XQ_PLANES * XQ_SQUARES);
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Board board;
+        if (sides) {
+            sides[i] = 0;
+        }
+        if (!load_fen(&board, fens[i])) {
+            continue;
+        }
+        uint8_t* position_planes = planes + i * XQ_PLANES * XQ_SQUARES;
+        for (int p = 0; p < XQ_PLANES; ++p) {
+            U128 bb = board.piece_bitboards[p];
+            while (bb) {
+                int sq = get_lsb_index(bb);
+                position_planes[p * XQ_SQUARES + sq] = 1;
+                bb &= CLEAR_MASKS[sq];
+            }
+        }
+        if (sides) {
+            sides[i] = (int8_t)board.player_to_move;
+        }
+        valid++;
+    }
+    return valid;
+}
@@ -0,0 +1,118 @@
+#ifndef XIANGQI_API_H
+#define XIANGQI_API_H
+
+// Stable C API of libxiangqi.so ("make lib"), for tools in other languages
+// (see scripts/xiangqi_lib.py). Only the xq_* functions below are exported.
+// Functions on distinct boards, and the batch functions, may run on any
+// number of threads at once; xq_search and xq_new_game share one engine and
+// are serialized.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XQ_API __attribute__((visibility("default")))
+
+// Incremented on incompatible changes
+#define XQ_API_VERSION 1
+
+// Squares are numbered row * 9 + column, row 0 being Black's back rank
+#define XQ_SQUARES 90
+
+// A move is encoded as from_sq * 90 + to_sq, a legal move mask has one byte
+// per code
+#define XQ_MOVE_SPACE (XQ_SQUARES * XQ_SQUARES)
+#define XQ_NO_MOVE -1
+
+// Bitboard planes: one per piece type and color, Red king, guard, bishop,
+// horse, rook, cannon, pawn, then Black's, each with one byte per square
+#define XQ_PLANES 14
+
+#define XQ_RED 1
+#define XQ_BLACK -1
+
+typedef struct xq_board xq_board;
+
+XQ_API int xq_api_version(void);
+
+// Initializes the shared tables; called by every other function as needed,
+// and safe to call from several threads
+XQ_API void xq_init(void);
+
+// --- Boards ---
+
+// Creates a board from a FEN, or the start position for NULL. Returns NULL
+// for an invalid FEN.
+XQ_API xq_board* xq_board_new(const char* fen);
+XQ_API xq_board* xq_board_clone(const xq_board* board);
+XQ_API void xq_board_free(xq_board* board);
+
+// Returns 0, or -1 for an invalid FEN (the board is left unchanged)
+XQ_API int xq_board_set_fen(xq_board* board, const char* fen);
+
+// Writes the FEN with its terminating zero; returns its length, or -1 if it
+// does not fit
+XQ_API int xq_board_get_fen(const xq_board* board, char* buffer, size_t size);
+
+XQ_API int xq_board_side_to_move(const xq_board* board);
+XQ_API uint64_t xq_board_hash(const xq_board* board);
+
+// Piece on a square: 1..7 for Red king, guard, bishop, horse, rook, cannon,
+// pawn, negative for Black, 0 for empty
+XQ_API int xq_board_piece_at(const xq_board* board, int sq);
+
+XQ_API int xq_board_in_check(const xq_board* board);
+
+// Writes up to capacity legal move codes; returns the number of legal moves
+XQ_API int xq_legal_moves(const xq_board* board, int* moves, int capacity);
+
+// Plays a legal move; returns 0, or -1 if the move is illegal
+XQ_API int xq_make_move(xq_board* board, int move);
+
+// Move code of a coordinate move such as "h2e2", or XQ_NO_MOVE
+XQ_API int xq_parse_move(const char* text);
+
+// Writes a move code as a coordinate move (5 bytes with the zero)
+XQ_API void xq_move_to_string(int move, char* text);
+
+// --- Evaluation and search ---
+
+// Static evaluation in centipawns for the side to move
+XQ_API int xq_evaluate(const xq_board* board);
+
+// Depth searched when xq_search gets no limit at all
+#define XQ_DEFAULT_SEARCH_DEPTH 8
+
+// Searches the position within the limits (0 for no limit; without any
+// limit, to XQ_DEFAULT_SEARCH_DEPTH) and returns the best move code. A legal
+// move is returned whenever one exists, even if the limits stop the search
+// early; XQ_NO_MOVE means there are no legal moves. *score gets the score
+// for the side to move, and may be NULL.
+XQ_API int xq_search(const xq_board* board, int depth, long movetime_ms, uint64_t nodes, int* score);
+
+// Clears the transposition and history tables of the search
+XQ_API void xq_new_game(void);
+
+// --- Batches ---
+// Each function takes count positions as FENs and fills one row per
+// position of a caller-provided, C-contiguous buffer. Rows of invalid FENs
+// are zeroed. Returns the number of valid positions.
+
+// masks: count x XQ_MOVE_SPACE bytes, 1 for legal moves
+XQ_API size_t xq_batch_legal_masks(const char* const* fens, size_t count, uint8_t* masks);
+
+// scores: count values, static evaluations for the side to move
+XQ_API size_t xq_batch_evaluate(const char* const* fens, size_t count, int32_t* scores);
+
+// planes: count x XQ_PLANES x XQ_SQUARES bytes, 1 where the plane's piece
+// stands; sides: count values, XQ_RED or XQ_BLACK to move (may be NULL)
+XQ_API size_t xq_batch_planes(const char* const* fens, size_t count, uint8_t* planes, int8_t* sides);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XIANGQI_API_H
@@ -0,0 +1,317 @@
+// Micro-benchmarks of the engine primitives: board updates, move generation,
+// check detection, evaluation, transposition table access and position
+// encoding.
+// Each primitive runs over a fixed corpus of positions; after a warm-up pass,
+// every repetition times a batch of passes. Results are printed as JSON
+// (ns/op and cycles/op percentiles over the repetitions) so that runs can be
+// compared across commits. Build and run with "make bench-micro".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bitboard.h"
+#include "move.h"
+#include "endgame.h"
+#include "evaluate.h"
+#include "position_codec.h"
+#include "tt.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+
+#define CORPUS_SIZE 512
+#define CORPUS_MAX_PLIES 120
+#define DEFAULT_REPETITIONS 31
+#define PASSES_PER_REPETITION 8
+
+static Board corpus[CORPUS_SIZE];
+static uint64_t miss_keys[CORPUS_SIZE];
+static PackedPosition packed_corpus[CORPUS_SIZE];
+static uint8_t huffman_corpus[CORPUS_SIZE][HUFFMAN_POSITION_MAX_SIZE];
+static int huffman_sizes[CORPUS_SIZE];
+static Board decoded_board;
+
+// Consumes results so that the compiler cannot drop the measured calls
+static volatile uint64_t sink;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random() {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t read_cycles() {
+#if HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Builds the corpus from seeded random games, so that it covers openings,
+// middlegames and endgames and is identical on every run
+static void build_corpus() {
+    Board board;
+    int count = 0;
+    while (count < CORPUS_SIZE) {
+        init_board(&board, NULL);
+        int length = 10 + (int)(next_random() % CORPUS_MAX_PLIES);
+        for (int ply = 0; ply < length; ++ply) {
+            MoveList moves;
+            generate_legal_moves(&board, &moves);
+            if (moves.count == 0) {
+                break;
+            }
+            Move move = moves.moves[next_random() % moves.count];
+            move_piece(&board, move.from_sq, move.to_sq);
+            if (board.history_ply >= MAX_HISTORY / 2) {
+                trim_history(&board, MAX_HISTORY / 4);
+            }
+        }
+        copy_board(&board, &corpus[count]);
+        miss_keys[count] = next_random();
+        encode_position(&board, &packed_corpus[count]);
+        huffman_sizes[count] = encode_position_huffman(&board, huffman_corpus[count]);
+        count++;
+    }
+}
+
+// --- Primitives ---
+// Each function runs one pass over the corpus and returns the number of operations
+
+static uint64_t bench_make_unmake() {
+    uint64_t ops = 0;
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        Board* board = &corpus[i];
+        MoveList moves;
+        generate_pseudo_legal_moves(board, &moves);
+        for (int j = 0; j < moves.count; ++j) {
+            Piece captured = move_piece(board, moves.moves[j].from_sq, moves.moves[j].to_sq);
+            sink += board->hash_key;
+            unmove_piece(board, moves.moves[j].from_sq, moves.moves[j].to_sq, captured);
+        }
+        ops += moves.count;
+    }
+    return ops;
+}
+
+static uint64_t bench_legal_moves() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        MoveList moves;
+        generate_legal_moves(&corpus[i], &moves);
+        sink += moves.count;
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_pseudo_legal_moves() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        MoveList moves;
+        generate_pseudo_legal_moves(&corpus[i], &moves);
+        sink += moves.count;
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_capture_moves() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        MoveList moves;
+        generate_capture_moves(&corpus[i], &moves);
+        sink += moves.count;
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_in_check() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        sink += is_king_in_check(&corpus[i], corpus[i].player_to_move);
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_evaluate() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        sink += evaluate(&corpus[i]);
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_tt_store() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        store_tt_entry(corpus[i].hash_key, 4, i, i, TT_EXACT, (Move){i % 90, (i + 1) % 90});
+    }
+    return CORPUS_SIZE;
+}
+
+// Half of the probes hit (keys stored by bench_tt_store), half miss
+static uint64_t bench_tt_probe() {
+    TTEntry entry;
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        sink += probe_tt(corpus[i].hash_key, &entry);
+        sink += probe_tt(miss_keys[i], &entry);
+    }
+    return 2 * CORPUS_SIZE;
+}
+
+// Probes at fresh random keys, spread over the whole table: measures the
+// memory latency of a probe rather than its cached cost
+static uint64_t bench_tt_probe_random() {
+    TTEntry entry;
+    for (int i = 0; i < 4 * CORPUS_SIZE; ++i) {
+        sink += probe_tt(next_random(), &entry);
+    }
+    return 4 * CORPUS_SIZE;
+}
+
+static uint64_t bench_encode_position() {
+    PackedPosition packed;
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        encode_position(&corpus[i], &packed);
+        sink += packed.pieces[i & 15];
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_decode_position() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        decode_position(&packed_corpus[i], &decoded_board);
+        sink += decoded_board.hash_key;
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_encode_position_huffman() {
+    uint8_t data[HUFFMAN_POSITION_MAX_SIZE];
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        sink += encode_position_huffman(&corpus[i], data);
+    }
+    return CORPUS_SIZE;
+}
+
+static uint64_t bench_decode_position_huffman() {
+    for (int i = 0; i < CORPUS_SIZE; ++i) {
+        decode_position_huffman(huffman_corpus[i], huffman_sizes[i], &decoded_board);
+        sink += decoded_board.hash_key;
+    }
+    return CORPUS_SIZE;
+}
+
+typedef struct {
+    const char* name;
+    uint64_t (*run)();
+} Primitive;
+
+static const Primitive PRIMITIVES[] = {
+    {"move_piece+unmove_piece", bench_make_unmake},
+    {"generate_legal_moves", bench_legal_moves},
+    {"generate_pseudo_legal_moves", bench_pseudo_legal_moves},
+    {"generate_capture_moves", bench_capture_moves},
+    {"is_king_in_check", bench_in_check},
+    {"evaluate", bench_evaluate},
+    {"store_tt_entry", bench_tt_store},
+    {"probe_tt", bench_tt_probe},
+    {"probe_tt_random", bench_tt_probe_random},
+    {"encode_position", bench_encode_position},
+    {"decode_position", bench_decode_position},
+    {"encode_position_huffman", bench_encode_position_huffman},
+    {"decode_position_huffman", bench_decode_position_huffman},
+};
+
+#define PRIMITIVE_COUNT (int)(sizeof(PRIMITIVES) / sizeof(PRIMITIVES[0]))
+
+// --- Statistics ---
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static void print_distribution(const char* name, double* values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+    printf("\"%s\":{\"min\":%.3f,\"p10\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"mean\":%.3f}",
+           name, values[0], percentile(values, count, 10), percentile(values, count, 50),
+           percentile(values, count, 90), percentile(values, count, 99), values[count - 1], sum / count);
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = DEFAULT_REPETITIONS;
+    if (argc > 1) {
+        repetitions = atoi(argv[1]);
+        if (repetitions < 1) {
+            fprintf(stderr, "Usage: %s [repetitions]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Board board;
+    init_board(&board, NULL);
+    init_move_generator();
+    init_endgames();
+    init_tt();
+    build_corpus();
+
+    double* ns_per_op = (double*)malloc(repetitions * sizeof(double));
+    double* cycles_per_op = (double*)malloc(repetitions * sizeof(double));
+
+    printf("{\"corpus_positions\":%d,\"repetitions\":%d,\"passes_per_repetition\":%d,\"rdtsc\":%s,\"results\":[\n",
+           CORPUS_SIZE, repetitions, PASSES_PER_REPETITION, HAVE_RDTSC ? "true" : "false");
+    for (int p = 0; p < PRIMITIVE_COUNT; ++p) {
+        const Primitive* primitive = &PRIMITIVES[p];
+        uint64_t ops = primitive->run(); // Warm-up: caches, branch predictors, TT contents
+
+        for (int r = 0; r < repetitions; ++r) {
+            uint64_t start_ns = now_ns();
+            uint64_t start_cycles = read_cycles();
+            ops = 0;
+            for (int pass = 0; pass < PASSES_PER_REPETITION; ++pass) {
+                ops += primitive->run();
+            }
+            uint64_t cycles = read_cycles() - start_cycles;
+            uint64_t elapsed_ns = now_ns() - start_ns;
+            ns_per_op[r] = (double)elapsed_ns / ops;
+            cycles_per_op[r] = (double)cycles / ops;
+        }
+
+        printf("  {\"name\":\"%s\",\"ops_per_repetition\":%llu,", primitive->name, (unsigned long long)ops);
+        print_distribution("ns_per_op", ns_per_op, repetitions);
+        printf(",");
+        print_distribution("cycles_per_op", cycles_per_op, repetitions);
+        printf("}%s\n", (p + 1 < PRIMITIVE_COUNT) ? "," : "");
+    }
+    printf("]}\n");
+
+    free(ns_per_op);
+    free(cycles_per_op);
+    return 0;
+}